@@ -1,4 +1,9 @@
 #include <iostream>
+#include <memory>
+#include <vector>
+#include "indiceValores.h"
+#include "poolCelulas.h"
+#include "../common/benchmark.h"
 using namespace std;
 
 class Celula {
@@ -7,7 +12,7 @@ public:
   Celula *prox;
 
   // construtores (vazio e com valor definido)
-  Celula() { Celula(-1); }
+  Celula() : Celula(-1) {}
 
   Celula(int valor) {
     elemento = valor;
@@ -19,20 +24,33 @@ class Fila {
 public:
   Celula *primeiro;
   Celula *ultimo;
+  // indice opcional de valores: com ele a busca e O(1) esperado
+  unique_ptr<IndiceValores> indice;
+  // celulas vem de um pool, o que permite inserir/remover cadeias inteiras
+  PoolCelulas<Celula> pool;
+  // escreve uma linha por insercao/remocao
+  bool log;
 
   // construtor da Lista encadeada
-  Fila() {
+  Fila(bool indexar = false) {
     primeiro = new Celula();
     ultimo = primeiro;
+    log = true;
+    if (indexar)
+      indice.reset(new IndiceValores());
   }
 
   // metodo para inserir (no final)
   void inserirFila(int valor) {
-    Celula *temp = new Celula(valor);
+    Celula *temp = pool.alocar(valor);
     ultimo->prox = temp;
     ultimo = temp;
 
-    cout << "Inseriu: " << valor << endl;
+    if (indice)
+      indice->inserir(valor);
+
+    if (log)
+      cout << "Inseriu: " << valor << endl;
   }
 
   // OBS: TEM CELULA CABECA (primeiro)
@@ -47,12 +65,76 @@ public:
     if (removida == ultimo)
       ultimo = primeiro;
 
-    cout << "Removeu: " << removida->elemento << endl;
-    delete removida; // deletando a celula efetivamente
+    if (indice)
+      indice->remover(removida->elemento);
+
+    if (log)
+      cout << "Removeu: " << removida->elemento << endl;
+    pool.liberar(removida); // devolvendo a celula ao pool
+  }
+
+  // insere n elementos de uma vez (no final, na ordem dada): a cadeia vem pronta do pool e e
+  // ligada com uma unica troca de ponteiro
+  void inserirLote(const int *valores, size_t n) {
+    if (n == 0)
+      return;
+
+    Celula *fim;
+    Celula *inicio = pool.alocarCadeia(valores, n, fim);
+    ultimo->prox = inicio;
+    ultimo = fim;
+
+    if (indice) {
+      for (size_t i = 0; i < n; i++)
+        indice->inserir(valores[i]);
+    }
+
+    if (log)
+      cout << "Inseriu " << n << " elementos" << endl;
+  }
+
+  void inserirLote(const vector<int> &valores) {
+    inserirLote(valores.data(), valores.size());
+  }
+
+  // remove k elementos do inicio e devolve a cadeia inteira ao pool
+  void removerK(size_t k) {
+    if (k == 0)
+      return;
+
+    Celula *fim = primeiro;
+    for (size_t i = 0; i < k; i++) {
+      if (fim->prox == nullptr)
+        throw std::logic_error("Nao ha elementos suficientes na fila!");
+      fim = fim->prox;
+    }
+
+    Celula *inicio = primeiro->prox;
+    primeiro->prox = fim->prox;
+
+    if (fim == ultimo)
+      ultimo = primeiro;
+
+    if (indice) {
+      for (Celula *aux = inicio; aux != fim->prox; aux = aux->prox)
+        indice->remover(aux->elemento);
+    }
+
+    pool.liberarCadeia(inicio, fim);
+
+    if (log)
+      cout << "Removeu " << k << " elementos" << endl;
   }
 
   // metodo para buscar um elemento na Lista
   bool buscarFila(int valor) {
+    if (indice) {
+      bool encontrado = indice->contem(valor);
+      cout << "Elemento " << valor
+           << (encontrado ? " encontrado!\n" : " não encontrado!\n");
+      return encontrado;
+    }
+
     Celula *aux = primeiro;
 
     while (aux != ultimo) {
@@ -78,7 +160,59 @@ public:
   }
 };
 
-int main() {
+// ---------------------------------------------------------------------------
+// benchmark: ./filaEncadeada --bench [n...]
+// para cada n: insercao, busca e remocao elemento a elemento e em lote, com e
+// sem o indice de valores (CSV no formato de common/benchmark.h)
+// ---------------------------------------------------------------------------
+static void benchmark(const vector<long> &tamanhos) {
+  const long buscas = 100;
+  bench::csvHeader();
+
+  for (long n : tamanhos) {
+    vector<int> valores(n);
+    for (long i = 0; i < n; i++)
+      valores[i] = static_cast<int>(i);
+
+    for (int indexada = 0; indexada < 2; indexada++) {
+      Fila fila(indexada == 1);
+      fila.log = false;
+      string sufixo = indexada ? "(indice)" : "";
+
+      double tempo = bench::measure([&]() {
+        for (long i = 0; i < n; i++)
+          fila.inserirFila(valores[i]);
+      });
+      bench::csvRow("filaEncadeada", "inserirFila" + sufixo, n, tempo, n);
+
+      tempo = bench::measure([&]() {
+        bench::SilenceCout silencio;
+        for (long i = 0; i < buscas; i++)
+          fila.buscarFila(static_cast<int>((i * 7919) % (2 * n)));
+      });
+      bench::csvRow("filaEncadeada", "buscarFila" + sufixo, n, tempo, buscas);
+
+      tempo = bench::measure([&]() {
+        for (long i = 0; i < n; i++)
+          fila.removerFila();
+      });
+      bench::csvRow("filaEncadeada", "removerFila" + sufixo, n, tempo, n);
+
+      tempo = bench::measure([&]() { fila.inserirLote(valores); });
+      bench::csvRow("filaEncadeada", "inserirLote" + sufixo, n, tempo, n);
+
+      tempo = bench::measure([&]() { fila.removerK(n); });
+      bench::csvRow("filaEncadeada", "removerK" + sufixo, n, tempo, n);
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1 && string(argv[1]) == "--bench") {
+    benchmark(bench::sweepFromArgs(argc, argv, {1000, 10000, 100000, 1000000}));
+    return 0;
+  }
+
   Fila *fila = new Fila();
 
   for (int n = 1; n < 16; n++) {
@@ -0,0 +1,118 @@
+#ifndef INDICE_VALORES_H
+#define INDICE_VALORES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// multiconjunto de inteiros em tabela hash de enderecamento aberto (sondagem
+// linear). Usado como indice secundario opcional das estruturas: guarda
+// quantas vezes cada valor aparece, de modo que a busca custa O(1) esperado.
+// Cada valor guarda tambem uma posicao de referencia (dica) fornecida por
+// quem insere; a estrutura dona do indice e quem valida essa dica.
+class IndiceValores {
+private:
+  struct Entrada {
+    int valor;
+    uint32_t contagem; // 0 = posicao livre
+    long long posicao;
+  };
+
+  std::vector<Entrada> tabela;
+  size_t ocupadas;
+  int deslocamento;
+
+  size_t hash(int valor) const {
+    return static_cast<size_t>(
+        (static_cast<uint64_t>(static_cast<uint32_t>(valor)) *
+         0x9E3779B97F4A7C15ull) >>
+        deslocamento);
+  }
+
+  // retorna a posicao do valor na tabela ou a posicao livre onde ele entraria
+  size_t procurar(int valor) const {
+    size_t mascara = tabela.size() - 1;
+    size_t i = hash(valor);
+    while (tabela[i].contagem != 0 && tabela[i].valor != valor)
+      i = (i + 1) & mascara;
+    return i;
+  }
+
+  void redimensionar(size_t capacidade) {
+    std::vector<Entrada> antiga;
+    antiga.swap(tabela);
+    tabela.assign(capacidade, Entrada{0, 0, -1});
+    deslocamento = 64;
+    for (size_t c = capacidade; c > 1; c >>= 1)
+      deslocamento--;
+
+    for (const Entrada &entrada : antiga) {
+      if (entrada.contagem != 0)
+        tabela[procurar(entrada.valor)] = entrada;
+    }
+  }
+
+public:
+  IndiceValores(size_t capacidadeInicial = 16) : ocupadas(0) {
+    size_t capacidade = 16;
+    while (capacidade < capacidadeInicial * 2)
+      capacidade <<= 1;
+    redimensionar(capacidade);
+  }
+
+  // registra mais uma ocorrencia do valor
+  void inserir(int valor, long long posicao = -1) {
+    if ((ocupadas + 1) * 2 > tabela.size())
+      redimensionar(tabela.size() * 2);
+
+    Entrada &entrada = tabela[procurar(valor)];
+    if (entrada.contagem == 0) {
+      entrada.valor = valor;
+      ocupadas++;
+    }
+    entrada.contagem++;
+    entrada.posicao = posicao;
+  }
+
+  // retira uma ocorrencia do valor; retorna false se ele nao estava no indice
+  bool remover(int valor) {
+    size_t mascara = tabela.size() - 1;
+    size_t i = procurar(valor);
+    if (tabela[i].contagem == 0)
+      return false;
+    if (--tabela[i].contagem != 0)
+      return true;
+
+    // remocao com deslocamento para tras: puxa as entradas seguintes do
+    // mesmo agrupamento para que nenhuma busca pare antes da hora
+    ocupadas--;
+    size_t livre = i;
+    for (size_t j = (i + 1) & mascara; tabela[j].contagem != 0;
+         j = (j + 1) & mascara) {
+      size_t ideal = hash(tabela[j].valor);
+      if (((j - ideal) & mascara) >= ((j - livre) & mascara)) {
+        tabela[livre] = tabela[j];
+        livre = j;
+      }
+    }
+    tabela[livre].contagem = 0;
+    return true;
+  }
+
+  bool contem(int valor) const { return tabela[procurar(valor)].contagem != 0; }
+
+  uint32_t contar(int valor) const { return tabela[procurar(valor)].contagem; }
+
+  // ultima posicao informada para o valor, ou -1 se ausente/desconhecida
+  long long posicao(int valor) const {
+    const Entrada &entrada = tabela[procurar(valor)];
+    return entrada.contagem == 0 ? -1 : entrada.posicao;
+  }
+
+  void limpar() {
+    tabela.assign(tabela.size(), Entrada{0, 0, -1});
+    ocupadas = 0;
+  }
+};
+
+#endif
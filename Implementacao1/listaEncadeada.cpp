@@ -1,4 +1,9 @@
 #include <iostream>
+#include <memory>
+#include <vector>
+#include "indiceValores.h"
+#include "poolCelulas.h"
+#include "../common/benchmark.h"
 using namespace std;
 
 class Celula {
@@ -7,7 +12,7 @@ public:
   Celula *prox;
 
   // construtores (vazio e com valor definido)
-  Celula() { Celula(-1); }
+  Celula() : Celula(-1) {}
 
   Celula(int valor) {
     elemento = valor;
@@ -19,23 +24,36 @@ class Lista {
 public:
   Celula *primeiro;
   Celula *ultimo;
+  // indice opcional de valores: com ele a busca e O(1) esperado
+  unique_ptr<IndiceValores> indice;
+  // celulas vem de um pool, o que permite inserir/remover cadeias inteiras
+  PoolCelulas<Celula> pool;
+  // escreve uma linha por insercao/remocao
+  bool log;
 
   // construtor da Lista encadeada
-  Lista() {
+  Lista(bool indexar = false) {
     primeiro = new Celula();
     ultimo = primeiro;
+    log = true;
+    if (indexar)
+      indice.reset(new IndiceValores());
   }
 
   // metodo para inserir (no inicio)
   void inserirLista(int valor) {
-    Celula *temp = new Celula(valor);
+    Celula *temp = pool.alocar(valor);
     temp->prox = primeiro->prox;
     primeiro->prox = temp;
 
     if (primeiro == ultimo)
       ultimo = temp;
 
-    cout << "Inseriu: " << valor << endl;
+    if (indice)
+      indice->inserir(valor);
+
+    if (log)
+      cout << "Inseriu: " << valor << endl;
   }
 
   // metodo para remover (do inicio)
@@ -49,12 +67,80 @@ public:
     if (removida == ultimo)
       ultimo = primeiro;
 
-    cout << "Removeu: " << removida->elemento << endl;
-    delete removida; // deletando a celula efetivamente
+    if (indice)
+      indice->remover(removida->elemento);
+
+    if (log)
+      cout << "Removeu: " << removida->elemento << endl;
+    pool.liberar(removida); // devolvendo a celula ao pool
+  }
+
+  // insere n elementos de uma vez (equivale a chamar inserirLista para
+  // cada valor, na ordem): a cadeia vem pronta do pool e e
+  // ligada com uma unica troca de ponteiro
+  void inserirLote(const int *valores, size_t n) {
+    if (n == 0)
+      return;
+
+    Celula *fim;
+    Celula *inicio = pool.alocarCadeia(valores, n, fim, true);
+    fim->prox = primeiro->prox;
+    primeiro->prox = inicio;
+
+    if (primeiro == ultimo)
+      ultimo = fim;
+
+    if (indice) {
+      for (size_t i = 0; i < n; i++)
+        indice->inserir(valores[i]);
+    }
+
+    if (log)
+      cout << "Inseriu " << n << " elementos" << endl;
+  }
+
+  void inserirLote(const vector<int> &valores) {
+    inserirLote(valores.data(), valores.size());
+  }
+
+  // remove k elementos do inicio e devolve a cadeia inteira ao pool
+  void removerK(size_t k) {
+    if (k == 0)
+      return;
+
+    Celula *fim = primeiro;
+    for (size_t i = 0; i < k; i++) {
+      if (fim->prox == nullptr)
+        throw std::logic_error("Nao ha elementos suficientes na lista!");
+      fim = fim->prox;
+    }
+
+    Celula *inicio = primeiro->prox;
+    primeiro->prox = fim->prox;
+
+    if (fim == ultimo)
+      ultimo = primeiro;
+
+    if (indice) {
+      for (Celula *aux = inicio; aux != fim->prox; aux = aux->prox)
+        indice->remover(aux->elemento);
+    }
+
+    pool.liberarCadeia(inicio, fim);
+
+    if (log)
+      cout << "Removeu " << k << " elementos" << endl;
   }
 
   // metodo para buscar um elemento na Lista
   bool buscarLista(int valor) {
+    if (indice) {
+      bool encontrado = indice->contem(valor);
+      cout << "Elemento " << valor
+           << (encontrado ? " encontrado!\n" : " não encontrado!\n");
+      return encontrado;
+    }
+
     Celula *aux = primeiro;
 
     while (aux != ultimo) {
@@ -80,7 +166,59 @@ public:
   }
 };
 
-int main() {
+// ---------------------------------------------------------------------------
+// benchmark: ./listaEncadeada --bench [n...]
+// para cada n: insercao, busca e remocao elemento a elemento e em lote, com e
+// sem o indice de valores (CSV no formato de common/benchmark.h)
+// ---------------------------------------------------------------------------
+static void benchmark(const vector<long> &tamanhos) {
+  const long buscas = 100;
+  bench::csvHeader();
+
+  for (long n : tamanhos) {
+    vector<int> valores(n);
+    for (long i = 0; i < n; i++)
+      valores[i] = static_cast<int>(i);
+
+    for (int indexada = 0; indexada < 2; indexada++) {
+      Lista lista(indexada == 1);
+      lista.log = false;
+      string sufixo = indexada ? "(indice)" : "";
+
+      double tempo = bench::measure([&]() {
+        for (long i = 0; i < n; i++)
+          lista.inserirLista(valores[i]);
+      });
+      bench::csvRow("listaEncadeada", "inserirLista" + sufixo, n, tempo, n);
+
+      tempo = bench::measure([&]() {
+        bench::SilenceCout silencio;
+        for (long i = 0; i < buscas; i++)
+          lista.buscarLista(static_cast<int>((i * 7919) % (2 * n)));
+      });
+      bench::csvRow("listaEncadeada", "buscarLista" + sufixo, n, tempo, buscas);
+
+      tempo = bench::measure([&]() {
+        for (long i = 0; i < n; i++)
+          lista.removerLista();
+      });
+      bench::csvRow("listaEncadeada", "removerLista" + sufixo, n, tempo, n);
+
+      tempo = bench::measure([&]() { lista.inserirLote(valores); });
+      bench::csvRow("listaEncadeada", "inserirLote" + sufixo, n, tempo, n);
+
+      tempo = bench::measure([&]() { lista.removerK(n); });
+      bench::csvRow("listaEncadeada", "removerK" + sufixo, n, tempo, n);
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1 && string(argv[1]) == "--bench") {
+    benchmark(bench::sweepFromArgs(argc, argv, {1000, 10000, 100000, 1000000}));
+    return 0;
+  }
+
   Lista *listaEncadeada = new Lista();
   
   for (int n = 15; n > 0; n--) {
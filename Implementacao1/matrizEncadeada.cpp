@@ -1,4 +1,10 @@
 #include <iostream>
+#include <vector>
+#include <unordered_map>
+#include <stdexcept>
+#include <memory>
+#include "indiceValores.h"
+#include "../common/benchmark.h"
 using namespace std;
 
 class Celula {
@@ -6,7 +12,7 @@ public:
   int elemento;
   Celula *sup, *inf, *dir, *esq;
 
-  Celula() { Celula(-1); };
+  Celula() : Celula(-1) {}
 
   Celula(int valor) {
     elemento = valor;
@@ -17,12 +23,52 @@ public:
   }
 };
 
-class Matriz {
+// interface comum das representacoes de matriz; a representacao e escolhida
+// na construcao (ver criarMatriz)
+class MatrizInteiros {
+protected:
+  // indice opcional de valores (valor -> posicao l * coluna + c): com ele a
+  // busca e O(1) esperado e a remocao vai direto a celula
+  unique_ptr<IndiceValores> indice;
+
+  // mantem o indice em dia quando uma celula troca de valor
+  void trocarValor(int antigo, int novo, long long posicao) {
+    if (!indice)
+      return;
+    if (antigo != -1)
+      indice->remover(antigo);
+    if (novo != -1)
+      indice->inserir(novo, posicao);
+  }
+
+  // resposta de buscarMatriz quando o indice esta ativo
+  bool buscarNoIndice(int valor) {
+    bool encontrado = indice->contem(valor);
+    cout << "Elemento " << valor
+         << (encontrado ? " encontrado na matriz!\n"
+                        : " nao encontrado na matriz!\n");
+    return encontrado;
+  }
+
+public:
+  MatrizInteiros(bool indexar) {
+    if (indexar)
+      indice.reset(new IndiceValores());
+  }
+
+  virtual ~MatrizInteiros() {}
+  virtual void inserirMatriz(int l, int c, int valor) = 0;
+  virtual bool removerMatriz(int valor) = 0;
+  virtual bool buscarMatriz(int valor) = 0;
+  virtual void mostrar() = 0;
+};
+
+class Matriz : public MatrizInteiros {
 public:
   Celula *inicio;
   int linha, coluna;
 
-  Matriz(int lin, int col) {
+  Matriz(int lin, int col, bool indexar = false) : MatrizInteiros(indexar) {
     linha = lin;
     coluna = col;
     alocaCelulas();
@@ -56,8 +102,8 @@ public:
     }
   }
 
-  // insere na celula o elemento
-  void inserirMatriz(int l, int c, int valor) {
+  // caminha ate a celula (l, c)
+  Celula *celulaEm(int l, int c) {
     Celula *atual = inicio;
     int i, j;
 
@@ -67,18 +113,43 @@ public:
     for (j = 0; j < l; j++) {
       atual = atual->inf;
     }
+    return atual;
+  }
+
+  // insere na celula o elemento
+  void inserirMatriz(int l, int c, int valor) override {
+    Celula *atual = celulaEm(l, c);
+    trocarValor(atual->elemento, valor, static_cast<long long>(l) * coluna + c);
     atual->elemento = valor;
   }
 
   // remove um elemento da matriz
-  bool removerMatriz(int valor) {
+  bool removerMatriz(int valor) override {
+    if (indice) {
+      long long posicao = indice->posicao(valor);
+      if (posicao == -1) {
+        cout << "Elemento " << valor << " nao encontrado na matriz!";
+        return false;
+      }
+
+      Celula *celula = celulaEm(posicao / coluna, posicao % coluna);
+      if (celula->elemento == valor) {
+        cout << "Elemento " << valor << " removido da matriz!";
+        trocarValor(valor, -1, posicao);
+        celula->elemento = -1;
+        return true;
+      }
+      // dica desatualizada (o valor tem copias em outras celulas): percorre
+    }
+
     Celula *linhaAtual = inicio;
-    for (int i = 0; i < 5; i++) {
+    for (int i = 0; i < linha; i++) {
       Celula *celula = linhaAtual;
 
       for (int j = 0; j < coluna; j++) {
         if (celula->elemento == valor) {
           cout << "Elemento " << valor << " removido da matriz!";
+          trocarValor(valor, -1, -1);
           celula->elemento = -1;
           return true;
         }
@@ -92,9 +163,12 @@ public:
   }
 
   // procura um elemento na matriz
-  bool buscarMatriz(int valor) {
+  bool buscarMatriz(int valor) override {
+    if (indice)
+      return buscarNoIndice(valor);
+
     Celula *linhaAtual = inicio;
-    for (int i = 0; i < 5; i++) {
+    for (int i = 0; i < linha; i++) {
       Celula *celula = linhaAtual;
 
       for (int j = 0; j < coluna; j++) {
@@ -112,9 +186,9 @@ public:
   }
 
   // imprime a matriz
-  void mostrar() {
+  void mostrar() override {
     Celula *linhaAtual = inicio;
-    for (int i = 0; i < 5; i++) {
+    for (int i = 0; i < linha; i++) {
       Celula *celula = linhaAtual;
 
       for (int j = 0; j < coluna; j++) {
@@ -127,8 +201,241 @@ public:
   }
 };
 
-int main() {
-  Matriz *matriz = new Matriz(5, 5);
+// matriz contigua em ordem de linha: a celula (l, c) fica em l * coluna + c,
+// entao o acesso e O(1)
+class MatrizDensa : public MatrizInteiros {
+public:
+  vector<int> elementos;
+  int linha, coluna;
+
+  MatrizDensa(int lin, int col, bool indexar = false)
+      : MatrizInteiros(indexar),
+        elementos(static_cast<size_t>(lin) * col, -1), linha(lin),
+        coluna(col) {}
+
+  // insere na celula o elemento
+  void inserirMatriz(int l, int c, int valor) override {
+    if (l < 0 || l >= linha || c < 0 || c >= coluna)
+      throw std::out_of_range("Posicao fora da matriz!");
+
+    size_t posicao = static_cast<size_t>(l) * coluna + c;
+    trocarValor(elementos[posicao], valor, posicao);
+    elementos[posicao] = valor;
+  }
+
+  // remove um elemento da matriz (a celula volta a valer -1)
+  bool removerMatriz(int valor) override {
+    if (indice) {
+      long long posicao = indice->posicao(valor);
+      if (posicao != -1 && elementos[posicao] == valor) {
+        cout << "Elemento " << valor << " removido da matriz!\n";
+        trocarValor(valor, -1, posicao);
+        elementos[posicao] = -1;
+        return true;
+      }
+      if (posicao == -1) {
+        cout << "Elemento " << valor << " nao encontrado na matriz!\n";
+        return false;
+      }
+      // dica desatualizada (o valor tem copias em outras celulas): percorre
+    }
+
+    for (int &elemento : elementos) {
+      if (elemento == valor) {
+        cout << "Elemento " << valor << " removido da matriz!\n";
+        trocarValor(valor, -1, -1);
+        elemento = -1;
+        return true;
+      }
+    }
+    cout << "Elemento " << valor << " nao encontrado na matriz!\n";
+    return false;
+  }
+
+  // procura um elemento na matriz
+  bool buscarMatriz(int valor) override {
+    if (indice)
+      return buscarNoIndice(valor);
+
+    for (int elemento : elementos) {
+      if (elemento == valor) {
+        cout << "Elemento " << valor << " encontrado na matriz!\n";
+        return true;
+      }
+    }
+    cout << "Elemento " << valor << " nao encontrado na matriz!\n";
+    return false;
+  }
+
+  // imprime a matriz
+  void mostrar() override {
+    for (int i = 0; i < linha; i++) {
+      for (int j = 0; j < coluna; j++)
+        cout << elementos[static_cast<size_t>(i) * coluna + j] << " ";
+      cout << endl;
+    }
+  }
+};
+
+// matriz esparsa (COO em tabela hash): guarda apenas as celulas preenchidas,
+// indexadas por l * coluna + c. Celulas ausentes valem -1
+class MatrizEsparsa : public MatrizInteiros {
+public:
+  unordered_map<long long, int> elementos;
+  int linha, coluna;
+
+  MatrizEsparsa(int lin, int col, bool indexar = false)
+      : MatrizInteiros(indexar), linha(lin), coluna(col) {}
+
+  // insere na celula o elemento (inserir -1 esvazia a celula)
+  void inserirMatriz(int l, int c, int valor) override {
+    if (l < 0 || l >= linha || c < 0 || c >= coluna)
+      throw std::out_of_range("Posicao fora da matriz!");
+
+    long long posicao = static_cast<long long>(l) * coluna + c;
+    auto it = elementos.find(posicao);
+    trocarValor(it == elementos.end() ? -1 : it->second, valor, posicao);
+    if (valor == -1)
+      elementos.erase(posicao);
+    else
+      elementos[posicao] = valor;
+  }
+
+  // remove um elemento da matriz; percorre apenas as celulas preenchidas
+  bool removerMatriz(int valor) override {
+    if (indice) {
+      long long posicao = indice->posicao(valor);
+      auto it = elementos.find(posicao);
+      if (it != elementos.end() && it->second == valor) {
+        cout << "Elemento " << valor << " removido da matriz!\n";
+        trocarValor(valor, -1, posicao);
+        elementos.erase(it);
+        return true;
+      }
+      if (posicao == -1) {
+        cout << "Elemento " << valor << " nao encontrado na matriz!\n";
+        return false;
+      }
+      // dica desatualizada (o valor tem copias em outras celulas): percorre
+    }
+
+    for (auto it = elementos.begin(); it != elementos.end(); ++it) {
+      if (it->second == valor) {
+        cout << "Elemento " << valor << " removido da matriz!\n";
+        trocarValor(valor, -1, -1);
+        elementos.erase(it);
+        return true;
+      }
+    }
+    cout << "Elemento " << valor << " nao encontrado na matriz!\n";
+    return false;
+  }
+
+  // procura um elemento na matriz
+  bool buscarMatriz(int valor) override {
+    if (indice)
+      return buscarNoIndice(valor);
+
+    for (const auto &celula : elementos) {
+      if (celula.second == valor) {
+        cout << "Elemento " << valor << " encontrado na matriz!\n";
+        return true;
+      }
+    }
+    cout << "Elemento " << valor << " nao encontrado na matriz!\n";
+    return false;
+  }
+
+  // imprime a matriz
+  void mostrar() override {
+    for (int i = 0; i < linha; i++) {
+      for (int j = 0; j < coluna; j++) {
+        auto it = elementos.find(static_cast<long long>(i) * coluna + j);
+        cout << (it == elementos.end() ? -1 : it->second) << " ";
+      }
+      cout << endl;
+    }
+  }
+};
+
+enum class Representacao { ENCADEADA, DENSA, ESPARSA };
+
+// cria a matriz com a representacao escolhida (e, opcionalmente, o indice)
+MatrizInteiros *criarMatriz(int lin, int col, Representacao tipo,
+                            bool indexar = false) {
+  switch (tipo) {
+  case Representacao::DENSA:
+    return new MatrizDensa(lin, col, indexar);
+  case Representacao::ESPARSA:
+    return new MatrizEsparsa(lin, col, indexar);
+  default:
+    return new Matriz(lin, col, indexar);
+  }
+}
+
+// ---------------------------------------------------------------------------
+// benchmark: ./matrizEncadeada --bench [lado...]
+// para cada matriz lado x lado e cada representacao (com e sem indice):
+// preenchimento completo, buscas e remocoes (CSV de common/benchmark.h)
+// ---------------------------------------------------------------------------
+static void benchmark(const vector<long> &lados) {
+  const char *nomes[] = {"Matriz", "MatrizDensa", "MatrizEsparsa"};
+  const Representacao tipos[] = {Representacao::ENCADEADA,
+                                 Representacao::DENSA, Representacao::ESPARSA};
+  const long operacoes = 100;
+  bench::csvHeader();
+
+  for (long lado : lados) {
+    long celulas = lado * lado;
+    for (int t = 0; t < 3; t++) {
+      for (int indexada = 0; indexada < 2; indexada++) {
+        string caso = string(nomes[t]) + (indexada ? "(indice)" : "");
+        MatrizInteiros *matriz = nullptr;
+
+        double tempo = bench::measure([&]() {
+          matriz = criarMatriz(lado, lado, tipos[t], indexada == 1);
+        });
+        bench::csvRow("matrizEncadeada", caso + "/criar", lado, tempo,
+                      celulas);
+
+        tempo = bench::measure([&]() {
+          for (long i = 0; i < lado; i++)
+            for (long j = 0; j < lado; j++)
+              matriz->inserirMatriz(i, j, static_cast<int>(i * lado + j));
+        });
+        bench::csvRow("matrizEncadeada", caso + "/inserir", lado, tempo,
+                      celulas);
+
+        double tempoRemocao;
+        {
+          bench::SilenceCout silencio;
+          tempo = bench::measure([&]() {
+            for (long k = 0; k < operacoes; k++)
+              matriz->buscarMatriz(
+                  static_cast<int>((k * 7919) % (2 * celulas)));
+          });
+          tempoRemocao = bench::measure([&]() {
+            for (long k = 0; k < operacoes; k++)
+              matriz->removerMatriz(static_cast<int>((k * 7919) % celulas));
+          });
+        }
+        bench::csvRow("matrizEncadeada", caso + "/buscar", lado, tempo,
+                      operacoes);
+        bench::csvRow("matrizEncadeada", caso + "/remover", lado,
+                      tempoRemocao, operacoes);
+        delete matriz;
+      }
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1 && string(argv[1]) == "--bench") {
+    benchmark(bench::sweepFromArgs(argc, argv, {50, 100, 200}));
+    return 0;
+  }
+
+  MatrizInteiros *matriz = criarMatriz(5, 5, Representacao::ENCADEADA);
   int valorAdd = 1;
 
   for (int i = 0; i < 5; i++) {
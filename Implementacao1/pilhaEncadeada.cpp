@@ -1,4 +1,14 @@
 #include <iostream>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <cstdint>
+#include <stdexcept>
+#include "indiceValores.h"
+#include "poolCelulas.h"
+#include "../common/benchmark.h"
 using namespace std;
 
 class Celula {
@@ -7,7 +17,7 @@ public:
   Celula *prox;
 
   // construtores (vazio e com valor definido)
-  Celula() { Celula(-1); }
+  Celula() : Celula(-1) {}
 
   Celula(int valor) {
     elemento = valor;
@@ -18,18 +28,33 @@ public:
 class Pilha {
 public:
   Celula *topo;
+  // indice opcional de valores: com ele a busca e O(1) esperado
+  unique_ptr<IndiceValores> indice;
+  // celulas vem de um pool, o que permite inserir/remover cadeias inteiras
+  PoolCelulas<Celula> pool;
+  // escreve uma linha por insercao/remocao
+  bool log;
 
   // OBS: POSSUI CELULA CABECA (topo)
   //  construtor da Pilha
-  Pilha() { topo = new Celula(); }
+  Pilha(bool indexar = false) {
+    topo = new Celula();
+    log = true;
+    if (indexar)
+      indice.reset(new IndiceValores());
+  }
 
   // metodo para inserir (topo->prox)
   void inserirPilha(int valor) {
-    Celula *temp = new Celula(valor);
+    Celula *temp = pool.alocar(valor);
     temp->prox = topo->prox;
     topo->prox = temp;
 
-    cout << "Inseriu: " << valor << endl;
+    if (indice)
+      indice->inserir(valor);
+
+    if (log)
+      cout << "Inseriu: " << valor << endl;
   }
 
   // metodo para remover (topo->prox)
@@ -40,12 +65,74 @@ public:
     Celula *removida = topo->prox;
     topo->prox = removida->prox;
 
-    cout << "Removeu: " << removida->elemento << endl;
-    delete removida; // deletando a celula efetivamente
+    if (indice)
+      indice->remover(removida->elemento);
+
+    if (log)
+      cout << "Removeu: " << removida->elemento << endl;
+    pool.liberar(removida); // devolvendo a celula ao pool
+  }
+
+  // insere n elementos de uma vez (equivale a chamar inserirPilha para
+  // cada valor, na ordem; valores[n - 1] fica no topo): a cadeia vem pronta do pool e e
+  // ligada com uma unica troca de ponteiro
+  void inserirLote(const int *valores, size_t n) {
+    if (n == 0)
+      return;
+
+    Celula *fim;
+    Celula *inicio = pool.alocarCadeia(valores, n, fim, true);
+    fim->prox = topo->prox;
+    topo->prox = inicio;
+
+    if (indice) {
+      for (size_t i = 0; i < n; i++)
+        indice->inserir(valores[i]);
+    }
+
+    if (log)
+      cout << "Inseriu " << n << " elementos" << endl;
+  }
+
+  void inserirLote(const vector<int> &valores) {
+    inserirLote(valores.data(), valores.size());
+  }
+
+  // remove k elementos do topo e devolve a cadeia inteira ao pool
+  void removerK(size_t k) {
+    if (k == 0)
+      return;
+
+    Celula *fim = topo;
+    for (size_t i = 0; i < k; i++) {
+      if (fim->prox == nullptr)
+        throw std::logic_error("Nao ha elementos suficientes na pilha!");
+      fim = fim->prox;
+    }
+
+    Celula *inicio = topo->prox;
+    topo->prox = fim->prox;
+
+    if (indice) {
+      for (Celula *aux = inicio; aux != fim->prox; aux = aux->prox)
+        indice->remover(aux->elemento);
+    }
+
+    pool.liberarCadeia(inicio, fim);
+
+    if (log)
+      cout << "Removeu " << k << " elementos" << endl;
   }
 
   // metodo para buscar um elemento na Pilha
   bool buscarPilha(int valor) {
+    if (indice) {
+      bool encontrado = indice->contem(valor);
+      cout << "Elemento " << valor
+           << (encontrado ? " encontrado!\n" : " não encontrado!\n");
+      return encontrado;
+    }
+
     Celula *aux = topo->prox;
 
     while (aux != nullptr) {
@@ -71,7 +158,289 @@ public:
   }
 };
 
-int main() {
+// pilha contigua: os elementos ficam em um vector, o topo e o ultimo elemento
+class PilhaVetor {
+public:
+  vector<int> elementos;
+  // indice opcional de valores: com ele a busca e O(1) esperado
+  unique_ptr<IndiceValores> indice;
+
+  // reserva espaco para n elementos, evitando realocacoes durante a insercao
+  PilhaVetor(size_t capacidade = 0, bool indexar = false) {
+    elementos.reserve(capacidade);
+    if (indexar)
+      indice.reset(new IndiceValores(capacidade));
+  }
+
+  // metodo para inserir (no topo)
+  void inserirPilha(int valor) {
+    elementos.push_back(valor);
+    if (indice)
+      indice->inserir(valor);
+  }
+
+  // metodo para remover (do topo)
+  int removerPilha() {
+    if (elementos.empty())
+      throw std::logic_error("Não ha elementos na pilha!");
+
+    int removido = elementos.back();
+    elementos.pop_back();
+    if (indice)
+      indice->remover(removido);
+    return removido;
+  }
+
+  // insere n elementos de uma vez; valores[n - 1] fica no topo
+  void pushN(const int *valores, size_t n) {
+    elementos.insert(elementos.end(), valores, valores + n);
+    if (indice) {
+      for (size_t i = 0; i < n; i++)
+        indice->inserir(valores[i]);
+    }
+  }
+
+  // remove n elementos de uma vez, copiando-os para destino na ordem de
+  // remocao (destino[0] era o topo)
+  void popN(int *destino, size_t n) {
+    if (n > elementos.size())
+      throw std::logic_error("Não ha elementos suficientes na pilha!");
+
+    size_t inicio = elementos.size() - n;
+    for (size_t i = 0; i < n; i++)
+      destino[i] = elementos[elementos.size() - 1 - i];
+    elementos.resize(inicio);
+    if (indice) {
+      for (size_t i = 0; i < n; i++)
+        indice->remover(destino[i]);
+    }
+  }
+
+  // metodo para buscar um elemento na Pilha (do topo para a base)
+  bool buscarPilha(int valor) {
+    if (indice)
+      return indice->contem(valor);
+
+    for (size_t i = elementos.size(); i > 0; i--) {
+      if (elementos[i - 1] == valor)
+        return true;
+    }
+    return false;
+  }
+
+  // metodo para mostrar os elementos da Pilha
+  void mostrar() {
+    for (size_t i = elementos.size(); i > 0; i--)
+      cout << elementos[i - 1] << ", ";
+  }
+};
+
+// pilha de Treiber sem trava para varios produtores/consumidores.
+// OBS: as celulas vem de um vetor de capacidade fixa e sao referenciadas por
+// indice; topo e livres guardam (contador << 32 | indice) e o contador e
+// incrementado a cada troca, o que impede o problema ABA no compare_exchange
+class PilhaLockFree {
+private:
+  struct No {
+    int elemento;
+    atomic<uint32_t> prox;
+  };
+
+  static const uint32_t NULO = 0xFFFFFFFFu;
+
+  unique_ptr<No[]> nos;
+  atomic<uint64_t> topo;
+  atomic<uint64_t> livres;
+
+  static uint64_t empacotar(uint32_t indice, uint32_t contador) {
+    return (static_cast<uint64_t>(contador) << 32) | indice;
+  }
+
+  // retira o primeiro no de uma das listas (topo ou livres)
+  uint32_t retirar(atomic<uint64_t> &cabeca) {
+    uint64_t atual = cabeca.load(memory_order_acquire);
+    while (true) {
+      uint32_t indice = static_cast<uint32_t>(atual);
+      if (indice == NULO)
+        return NULO;
+
+      uint32_t prox = nos[indice].prox.load(memory_order_relaxed);
+      uint32_t contador = static_cast<uint32_t>(atual >> 32) + 1;
+      if (cabeca.compare_exchange_weak(atual, empacotar(prox, contador),
+                                       memory_order_acq_rel,
+                                       memory_order_acquire))
+        return indice;
+    }
+  }
+
+  // coloca um no no inicio de uma das listas (topo ou livres)
+  void colocar(atomic<uint64_t> &cabeca, uint32_t indice) {
+    uint64_t atual = cabeca.load(memory_order_relaxed);
+    do {
+      nos[indice].prox.store(static_cast<uint32_t>(atual),
+                             memory_order_relaxed);
+    } while (!cabeca.compare_exchange_weak(
+        atual, empacotar(indice, static_cast<uint32_t>(atual >> 32) + 1),
+        memory_order_release, memory_order_relaxed));
+  }
+
+public:
+  PilhaLockFree(uint32_t capacidade)
+      : nos(new No[capacidade]), topo(empacotar(NULO, 0)),
+        livres(empacotar(capacidade == 0 ? NULO : 0, 0)) {
+    for (uint32_t i = 0; i < capacidade; i++) {
+      nos[i].elemento = -1;
+      nos[i].prox.store(i + 1 < capacidade ? i + 1 : NULO,
+                        memory_order_relaxed);
+    }
+  }
+
+  // metodo para inserir (no topo); pode ser chamado por varias threads
+  void inserirPilha(int valor) {
+    uint32_t indice = retirar(livres);
+    if (indice == NULO)
+      throw std::overflow_error("Pilha cheia!");
+
+    nos[indice].elemento = valor;
+    colocar(topo, indice);
+  }
+
+  // metodo para remover (do topo); retorna false se a pilha estiver vazia
+  bool removerPilha(int &valor) {
+    uint32_t indice = retirar(topo);
+    if (indice == NULO)
+      return false;
+
+    valor = nos[indice].elemento;
+    colocar(livres, indice);
+    return true;
+  }
+
+  bool vazia() const {
+    return static_cast<uint32_t>(topo.load(memory_order_acquire)) == NULO;
+  }
+};
+
+// ---------------------------------------------------------------------------
+// benchmark de vazao: ./pilhaEncadeada --bench [operacoes...]
+// CSV no formato de common/benchmark.h; o caso traz a estrutura e o numero
+// de threads
+// ---------------------------------------------------------------------------
+
+static void imprimirResultado(const string &estrutura, int threads,
+                              long operacoes, double segundos) {
+  bench::csvRow("pilhaEncadeada",
+                estrutura + "/" + to_string(threads) + "threads", operacoes,
+                segundos, operacoes);
+}
+
+// executa operacoes/threads pares inserir+remover em cada thread
+template <typename Funcao>
+static double medirConcorrente(int threads, long operacoes, Funcao funcao) {
+  return bench::measure([&]() {
+    vector<thread> trabalhadores;
+    for (int t = 0; t < threads; t++)
+      trabalhadores.emplace_back(funcao, t, operacoes / threads);
+    for (thread &trabalhador : trabalhadores)
+      trabalhador.join();
+  });
+}
+
+static void benchmark(long n) {
+  const size_t bloco = 1024;
+  const int threads = 8;
+  vector<int> valores(bloco);
+  for (size_t i = 0; i < bloco; i++)
+    valores[i] = static_cast<int>(i);
+
+  // a Pilha escreve uma linha por operacao; o log e desligado para que a
+  // medida reflita a estrutura e nao o terminal
+  Pilha pilha;
+  pilha.log = false;
+  double tempo = bench::measure([&]() {
+    for (long i = 0; i < n; i++)
+      pilha.inserirPilha(static_cast<int>(i));
+    for (long i = 0; i < n; i++)
+      pilha.removerPilha();
+  });
+  imprimirResultado("Pilha", 1, 2 * n, tempo);
+
+  long blocos = n / static_cast<long>(bloco);
+  tempo = bench::measure([&]() {
+    for (long i = 0; i < blocos; i++)
+      pilha.inserirLote(valores);
+    for (long i = 0; i < blocos; i++)
+      pilha.removerK(bloco);
+  });
+  imprimirResultado("Pilha(inserirLote/removerK)", 1, 2 * blocos * bloco,
+                    tempo);
+
+  PilhaVetor vetor;
+  tempo = bench::measure([&]() {
+    for (long i = 0; i < n; i++)
+      vetor.inserirPilha(static_cast<int>(i));
+    for (long i = 0; i < n; i++)
+      vetor.removerPilha();
+  });
+  imprimirResultado("PilhaVetor", 1, 2 * n, tempo);
+
+  vector<int> destino(bloco);
+  tempo = bench::measure([&]() {
+    for (long i = 0; i < blocos; i++)
+      vetor.pushN(valores.data(), bloco);
+    for (long i = 0; i < blocos; i++)
+      vetor.popN(destino.data(), bloco);
+  });
+  imprimirResultado("PilhaVetor(pushN/popN)", 1, 2 * blocos * bloco, tempo);
+
+  PilhaLockFree lockFree(static_cast<uint32_t>(n));
+  tempo = bench::measure([&]() {
+    int valor;
+    for (long i = 0; i < n; i++)
+      lockFree.inserirPilha(static_cast<int>(i));
+    for (long i = 0; i < n; i++)
+      lockFree.removerPilha(valor);
+  });
+  imprimirResultado("PilhaLockFree", 1, 2 * n, tempo);
+
+  // contencao: todas as threads inserem e removem na mesma pilha
+  mutex trava;
+  tempo = medirConcorrente(threads, n, [&](int, long ops) {
+    for (long i = 0; i < ops; i++) {
+      lock_guard<mutex> guarda(trava);
+      pilha.inserirPilha(static_cast<int>(i));
+      pilha.removerPilha();
+    }
+  });
+  imprimirResultado("Pilha+mutex", threads, 2 * n, tempo);
+
+  tempo = medirConcorrente(threads, n, [&](int, long ops) {
+    for (long i = 0; i < ops; i++) {
+      lock_guard<mutex> guarda(trava);
+      vetor.inserirPilha(static_cast<int>(i));
+      vetor.removerPilha();
+    }
+  });
+  imprimirResultado("PilhaVetor+mutex", threads, 2 * n, tempo);
+
+  tempo = medirConcorrente(threads, n, [&](int, long ops) {
+    int valor;
+    for (long i = 0; i < ops; i++) {
+      lockFree.inserirPilha(static_cast<int>(i));
+      lockFree.removerPilha(valor);
+    }
+  });
+  imprimirResultado("PilhaLockFree", threads, 2 * n, tempo);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1 && string(argv[1]) == "--bench") {
+    bench::csvHeader();
+    for (long n : bench::sweepFromArgs(argc, argv, {100000, 1000000}))
+      benchmark(n);
+    return 0;
+  }
+
   Pilha *pilha = new Pilha();
 
   for (int n = 1; n < 16; n++) {
@@ -0,0 +1,82 @@
+#ifndef POOL_CELULAS_H
+#define POOL_CELULAS_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// pool de celulas encadeadas (T precisa ter os campos elemento e prox).
+// As celulas sao alocadas em blocos e as livres ficam numa lista ligada pelo
+// proprio prox, de modo que uma cadeia inteira pode ser obtida ou devolvida
+// sem passar pelo new/delete de cada celula.
+template <typename T> class PoolCelulas {
+private:
+  std::vector<std::unique_ptr<T[]>> blocos;
+  T *livres;
+  size_t tamanhoBloco;
+
+  // aloca um novo bloco de n celulas e o coloca na lista de livres
+  void crescer(size_t n) {
+    T *bloco = new T[n];
+    blocos.emplace_back(bloco);
+    for (size_t i = 0; i + 1 < n; i++)
+      bloco[i].prox = &bloco[i + 1];
+    bloco[n - 1].prox = livres;
+    livres = bloco;
+  }
+
+public:
+  PoolCelulas(size_t tamanhoBloco = 1024)
+      : livres(nullptr), tamanhoBloco(tamanhoBloco) {}
+
+  // retira uma celula do pool
+  T *alocar(int valor) {
+    if (livres == nullptr)
+      crescer(tamanhoBloco);
+
+    T *celula = livres;
+    livres = celula->prox;
+    celula->elemento = valor;
+    celula->prox = nullptr;
+    return celula;
+  }
+
+  // retira n celulas ja encadeadas com os valores dados (ou com eles em ordem
+  // inversa); retorna a primeira e devolve a ultima em 'ultima'
+  T *alocarCadeia(const int *valores, size_t n, T *&ultima,
+                  bool invertida = false) {
+    T *primeira = nullptr;
+    ultima = nullptr;
+    for (size_t i = 0; i < n; i++) {
+      if (livres == nullptr)
+        crescer(n - i > tamanhoBloco ? n - i : tamanhoBloco);
+
+      T *celula = livres;
+      livres = celula->prox;
+      celula->elemento = invertida ? valores[n - 1 - i] : valores[i];
+
+      if (ultima == nullptr)
+        primeira = celula;
+      else
+        ultima->prox = celula;
+      ultima = celula;
+    }
+    if (ultima != nullptr)
+      ultima->prox = nullptr;
+    return primeira;
+  }
+
+  // devolve uma celula ao pool
+  void liberar(T *celula) {
+    celula->prox = livres;
+    livres = celula;
+  }
+
+  // devolve de uma vez a cadeia primeira..ultima (ligada por prox)
+  void liberarCadeia(T *primeira, T *ultima) {
+    ultima->prox = livres;
+    livres = primeira;
+  }
+};
+
+#endif
@@ -5,21 +5,29 @@
 #include <list>
 #include <vector>
 #include <set>
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <memory_resource>
+#include "../common/benchmark.h"
+#include "../common/arena.h"
 
 using namespace std;
 
 class Graph {
     private:
         //data
-        list<int> *relations;
         int vertex;
+        pmr::vector<pmr::list<int>> relations;
 
     public:
         /**
          * @brief Constructs a Graph with a specified number of vertices.
          * @param vertex Number of vertices in the graph.
+         * @param resource Where the adjacency lists are allocated (an arena for short-lived graphs).
          */
-        Graph(int vertex) : vertex(vertex), relations(new list<int>[vertex]){}
+        Graph(int vertex, pmr::memory_resource* resource = pmr::get_default_resource())
+            : vertex(vertex), relations(vertex, resource) {}
 
         /**
          * @brief Adds an edge between two vertices in the graph.
@@ -49,7 +57,7 @@ class Graph {
          * @param element The value to search for.
          * @return true if the value is found, false otherwise.
          */
-        bool contains(vector<int> subset, int element) {
+        bool contains(const vector<int>& subset, int element) {
             return find(subset.begin(), subset.end(), element) != subset.end();
         }
 
@@ -57,7 +65,7 @@ class Graph {
          * @brief Displays the subgraph formed by a subset of vertices.
          * @param subset A vector containing the vertices of the subgraph.
          */
-        void show(vector<int> subset) {
+        void show(const vector<int>& subset) {
             for (int i : subset) {
                 cout << i << " -> ";
                 for (int element : relations[i]) {
@@ -85,12 +93,15 @@ class Graph {
         }
 
         /**
-         * @brief Generates and displays all possible subgraphs of the complete graph.
+         * @brief Generates and displays all possible subgraphs of the complete graph. Each subgraph is built in an
+         * arena that is reset for the next one, so the enumeration does not call malloc per edge.
+         * @return The number of subgraphs generated.
          */
-        void showSubgraphs() {
+        long showSubgraphs() {
             //data
             int noEdgesSubgraphs = pow(2, vertex);
-            int countSubgraphs = 0; 
+            long countSubgraphs = 0; 
+            arena::Arena scratch;
 
             for (int i = 1; i < noEdgesSubgraphs; i++) { 
                 vector<int> subset;
@@ -109,7 +120,8 @@ class Graph {
 
                 for (int i = 0; i < totalCombinations; ++i) {
                     cout << "Resulting Subgraph " << countSubgraphs + 1 << ":\n";
-                    Graph subgraph(vertex);
+                    scratch.reset();
+                    Graph subgraph(vertex, scratch.resource());
 
                     int edgeIndex = 0;
                     for (int j = 0; j < subVertex; ++j) {
@@ -126,10 +138,35 @@ class Graph {
                 }
             }
             cout << "Total subgraphs for a " << vertex << "-vertex complete graph: " << countSubgraphs;
+            return countSubgraphs;
         }
 };
 
-int main(void) {
+/**
+ * @brief Benchmark mode ("--bench [n...]"): enumerates the subgraphs of K_n for
+ * each n of the sweep with the output discarded, and prints CSV rows.
+ * @param sweep Vertex counts to measure.
+ */
+void benchmark(const vector<long>& sweep) {
+    bench::csvHeader();
+    for (long n : sweep) {
+        long subgraphs = 0;
+        double seconds = bench::measure([&]() {
+            bench::SilenceCout silence;
+            Graph g(static_cast<int>(n));
+            g.build();
+            subgraphs = g.showSubgraphs();
+        });
+        bench::csvRow("Graphs", "showSubgraphs", n, seconds, subgraphs);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && string(argv[1]) == "--bench") {
+        benchmark(bench::sweepFromArgs(argc, argv, {3, 4, 5, 6}));
+        return 0;
+    }
+
     //data
     int v = 0;
     do {
@@ -5,6 +5,9 @@
 #include <algorithm>
 #include <fstream>
 #include <sstream>
+#include <cmath>
+#include <string>
+#include "../common/benchmark.h"
 using namespace std;
 
 class Graph
@@ -120,7 +123,39 @@ class Graph
 };
 
 
-int main(void){
+//modo benchmark ("--bench [n...]"): mede o algoritmo em grafos aleatorios (grau 8)
+//e em grades 4-conexas geradas com n vertices, imprimindo linhas CSV (ver common/benchmark.h)
+void benchmark(const vector<long>& tamanhos){
+    bench::csvHeader();
+    for(long n : tamanhos){
+        int lado = static_cast<int>(sqrt(static_cast<double>(n)));
+        vector<vector<vector<float>>> matrizes = {
+            bench::randomWeightMatrix(n, 8, n),
+            bench::gridWeightMatrix(lado, n)
+        };
+        const char* casos[] = {"aleatorio", "grade"};
+
+        for(int c = 0; c < 2; c++){
+            list<int> vertices;
+            for(size_t v = 0; v < matrizes[c].size(); v++)
+                vertices.push_back(v);
+
+            Graph g(vertices, matrizes[c]);
+            double tempo = bench::measure([&](){
+                g.preencheArestasPercorridas();
+                g.maxMinValue(0);
+            });
+            bench::csvRow("maxmin", casos[c], vertices.size(), tempo, vertices.size());
+        }
+    }
+}
+
+int main(int argc, char* argv[]){
+    if(argc > 1 && string(argv[1]) == "--bench"){
+        benchmark(bench::sweepFromArgs(argc, argv, {100, 200, 400}));
+        return 0;
+    }
+
     list<int> vertices;
     
     ifstream arq("graph1.graph");
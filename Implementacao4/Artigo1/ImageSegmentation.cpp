@@ -9,6 +9,25 @@
 #include <unordered_map>
 #include <cstdlib>
 #include <ctime>
+#include <cstdio>
+#include <cstdint>
+#include <atomic>
+#include "../../common/benchmark.h"
+#include "../../common/pipeline.h"
+#include "../../common/threadpool.h"
+#include "../../common/arena.h"
+#include "../../common/stats.h"
+#include "../../common/imageio.h"
+#include "../../common/cache.h"
+#include <memory_resource>
+#include <optional>
+#include <filesystem>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 
 class Grafo; 
@@ -17,23 +36,34 @@ class Grafo;
 using Pixel = std::tuple<int, int, int>;
 
 /**
- * @brief Represents a Union-Find (Disjoint-Set) data structure with support for rank and component weight tracking.
+ * @brief Represents a Union-Find (Disjoint-Set) data structure with support for rank, component size and
+ * internal difference tracking.
  * @tparam T The type of elements in the Union-Find structure.
- * @param elements A vector containing the initial elements to be added to the Union-Find structure.
+ * @param elements The initial elements to be added to the Union-Find structure.
+ * @param resource Where the maps are allocated (an arena for per-run use).
  */
 template <typename T>
 class UnionFind {
 private:
-    std::unordered_map<T, T> parent;
-    std::unordered_map<T, int> rank;
-    std::unordered_map<T, double> componentWeight;
+    std::pmr::unordered_map<T, T> parent;
+    std::pmr::unordered_map<T, int> rank;
+    std::pmr::unordered_map<T, double> componentWeight;
+    std::pmr::unordered_map<T, int> componentSize;
+    long long hops = 0;
 
 public:
-    UnionFind(const std::vector<T>& elements) {
+    template <typename Elements>
+    UnionFind(const Elements& elements, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : parent(resource), rank(resource), componentWeight(resource), componentSize(resource) {
+        parent.reserve(elements.size());
+        rank.reserve(elements.size());
+        componentWeight.reserve(elements.size());
+        componentSize.reserve(elements.size());
         for (const T& elem : elements) {
             parent[elem] = elem;
             rank[elem] = 0;
             componentWeight[elem] = 0.0;
+            componentSize[elem] = 1;
         }
     }
 
@@ -44,16 +74,19 @@ public:
      */
     T find(T x) {
         if (parent[x] != x) {
+            TGC_STATS_ONLY(hops++);
             parent[x] = find(parent[x]);
         }
         return parent[x];
     }
 
     /**
-     * @brief Unites two sets, merging them into a single set, and updates the component weight.
+     * @brief Unites two sets, merging them into a single set, and updates the component weight and size.
+     * The component weight is the internal difference Int(C): the largest edge weight of the component's
+     * minimum spanning tree, which is the weight of the last merge when edges arrive in sorted order.
      * @param x The first element.
      * @param y The second element.
-     * @param weight The weight to add to the component during the merge.
+     * @param weight The weight of the edge joining the two sets.
      */
     void unionSets(T x, T y, double weight) {
         T rootX = find(x);
@@ -67,35 +100,511 @@ public:
         }
 
         parent[rootY] = rootX;
-        componentWeight[rootX] += componentWeight[rootY] + weight;
+        componentWeight[rootX] = std::max({componentWeight[rootX], componentWeight[rootY], weight});
+        componentSize[rootX] += componentSize[rootY];
 
         if (rank[rootX] == rank[rootY]) {
             rank[rootX]++;
         }
     }
+
+    /**
+     * @brief Gets the internal difference Int(C) of the set containing the element.
+     * @param x An element of the set.
+     * @return The largest edge weight merged into the set (0 for a single element).
+     */
+    double getInternalDifference(T x) {
+        return componentWeight[find(x)];
+    }
+
+    /**
+     * @brief Gets the number of elements in the set containing the element.
+     * @param x An element of the set.
+     * @return The size of the set.
+     */
+    int getSize(T x) {
+        return componentSize[find(x)];
+    }
+
+    /**
+     * @brief Parent links followed by find() so far (counted only in builds with the stats instrumentation).
+     */
+    long long getFindHops() const {
+        return hops;
+    }
+};
+
+/**
+ * @brief Selects the predicate used to decide whether two components are merged.
+ * Fixed merges whenever the edge weight is below a global threshold. Adaptive is the Felzenszwalb-Huttenlocher
+ * predicate: merge when w <= min(Int(C1) + k/|C1|, Int(C2) + k/|C2|).
+ */
+enum class MergeCriterion { Fixed, Adaptive };
+
+/**
+ * @brief Evaluates the merge predicate for an edge joining two distinct components.
+ * @param criterion The merge predicate to use.
+ * @param threshold The global threshold (Fixed) or the scale constant k (Adaptive).
+ * @param weight The weight of the edge joining the components.
+ * @param internalA Internal difference Int(C1) of the first component.
+ * @param sizeA Size of the first component.
+ * @param internalB Internal difference Int(C2) of the second component.
+ * @param sizeB Size of the second component.
+ * @return true if the components should be merged.
+ */
+inline bool shouldMerge(MergeCriterion criterion, double threshold, double weight,
+                        double internalA, double sizeA, double internalB, double sizeB) {
+    if (criterion == MergeCriterion::Fixed) {
+        return weight < threshold;
+    }
+    return weight <= std::min(internalA + threshold / sizeA, internalB + threshold / sizeB);
+}
+
+/**
+ * @brief Union-Find over the dense ids 0..n-1, stored in flat arrays, with the same size and internal difference
+ * tracking as UnionFind. Used where the number of elements makes hashing too expensive.
+ */
+class ArrayUnionFind {
+private:
+    std::vector<uint32_t> parent;
+    std::vector<uint32_t> componentSize;
+    std::vector<float> componentWeight;
+    long long hops = 0;
+
+public:
+    explicit ArrayUnionFind(size_t n = 0) { reset(n); }
+
+    /**
+     * @brief Reinitialises the structure with n singleton sets.
+     * @param n The number of elements.
+     */
+    void reset(size_t n) {
+        parent.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            parent[i] = static_cast<uint32_t>(i);
+        }
+        componentSize.assign(n, 1);
+        componentWeight.assign(n, 0.0f);
+    }
+
+    /**
+     * @brief Appends a new singleton set that stands for an already built component.
+     * @param size The number of pixels of the component.
+     * @param internalDifference The internal difference Int(C) of the component.
+     * @return The id of the new set.
+     */
+    uint32_t add(uint32_t size, float internalDifference) {
+        parent.push_back(static_cast<uint32_t>(parent.size()));
+        componentSize.push_back(size);
+        componentWeight.push_back(internalDifference);
+        return parent.back();
+    }
+
+    /**
+     * @brief Finds the representative of the set containing x, halving the path on the way.
+     */
+    uint32_t find(uint32_t x) {
+        while (parent[x] != x) {
+            TGC_STATS_ONLY(hops++);
+            parent[x] = parent[parent[x]];
+            x = parent[x];
+        }
+        return x;
+    }
+
+    /**
+     * @brief Unites the sets of two roots (union by size).
+     * @param rootX The root of the first set.
+     * @param rootY The root of the second set.
+     * @param weight The weight of the edge joining the two sets.
+     * @return The root of the merged set.
+     */
+    uint32_t unite(uint32_t rootX, uint32_t rootY, float weight) {
+        if (componentSize[rootX] < componentSize[rootY]) {
+            std::swap(rootX, rootY);
+        }
+        parent[rootY] = rootX;
+        componentSize[rootX] += componentSize[rootY];
+        componentWeight[rootX] = std::max({componentWeight[rootX], componentWeight[rootY], weight});
+        return rootX;
+    }
+
+    uint32_t getSize(uint32_t root) const { return componentSize[root]; }
+
+    float getInternalDifference(uint32_t root) const { return componentWeight[root]; }
+
+    size_t size() const { return parent.size(); }
+
+    /**
+     * @brief Parent links followed by find() since the last takeFindHops() (counted only with the stats
+     * instrumentation).
+     */
+    long long takeFindHops() {
+        long long taken = hops;
+        hops = 0;
+        return taken;
+    }
+};
+
+/**
+ * @brief Union-Find over the dense ids 0..n-1 that many threads can unite and find on at once. The parent array is
+ * atomic and no operation waits on another thread, so the structure is lock-free:
+ * - unite links the root with the larger id under the one with the smaller id by a compare-and-swap on its
+ *   parent. If another thread linked that root first, the CAS fails and unite retries from the new roots.
+ * - find compresses by splitting: each node on the path is swung to its grandparent by a CAS. A failed CAS only
+ *   means another thread already moved the node higher.
+ *
+ * Parents only ever move towards the root, and the root of a set is always its smallest id. Nothing but parent
+ * ids is shared, so relaxed atomics suffice; the parallel loops around each phase order the phases.
+ */
+class ConcurrentUnionFind {
+private:
+    std::vector<std::atomic<uint32_t>> parent;
+
+public:
+    /**
+     * @brief Allocates n ids; they are not sets until makeSets covers them.
+     */
+    explicit ConcurrentUnionFind(size_t n) : parent(n) {}
+
+    /**
+     * @brief Makes every id in [from, to) a singleton set. Threads may initialise disjoint ranges at once.
+     */
+    void makeSets(size_t from, size_t to) {
+        for (size_t i = from; i < to; ++i) {
+            parent[i].store(static_cast<uint32_t>(i), std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief Finds the representative (smallest id) of the set containing x, splitting the path on the way.
+     */
+    uint32_t find(uint32_t x) {
+        while (true) {
+            uint32_t up = parent[x].load(std::memory_order_relaxed);
+            if (up == x) return x;
+            uint32_t grandparent = parent[up].load(std::memory_order_relaxed);
+            if (grandparent != up) {
+                uint32_t expected = up;
+                parent[x].compare_exchange_weak(expected, grandparent, std::memory_order_relaxed);
+            }
+            x = up;
+        }
+    }
+
+    /**
+     * @brief Links the singleton x under root, which must be a smaller id. A plain store, for an x that no other
+     * thread can reach yet (such as the pixel a band is scanning).
+     */
+    void attach(uint32_t x, uint32_t root) {
+        parent[x].store(root, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Unites the sets containing a and b.
+     * @return false if they were already the same set.
+     */
+    bool unite(uint32_t a, uint32_t b) {
+        while (true) {
+            a = find(a);
+            b = find(b);
+            if (a == b) return false;
+            if (a < b) std::swap(a, b);
+            uint32_t expected = a;
+            if (parent[a].compare_exchange_strong(expected, b, std::memory_order_relaxed)) return true;
+        }
+    }
+
+    bool isRoot(uint32_t x) const { return parent[x].load(std::memory_order_relaxed) == x; }
+
+    size_t size() const { return parent.size(); }
 };
 
 /**
- * @brief Calculates the Euclidean distance between two pixels in RGB color space.
- * @param p1 The first pixel represented as a tuple (R, G, B).
- * @param p2 The second pixel represented as a tuple (R, G, B).
- * @return The Euclidean distance between the two pixels.
+ * @brief Foreground mask of an image: 1 where the luma (BT.601 weights, as in GrayDistance) is at least level.
+ */
+std::vector<unsigned char> thresholdLuma(const std::vector<Pixel>& pixels, double level) {
+    std::vector<unsigned char> mask(pixels.size());
+    for (size_t i = 0; i < pixels.size(); ++i) {
+        double luma = 0.299 * std::get<0>(pixels[i]) + 0.587 * std::get<1>(pixels[i]) + 0.114 * std::get<2>(pixels[i]);
+        mask[i] = luma >= level ? 1 : 0;
+    }
+    return mask;
+}
+
+/**
+ * @brief Connected-components labelling of a mask: 4-connected foreground pixels, united with ArrayUnionFind.
+ * Components are numbered from 1 in the scan order of their first pixel; background pixels get 0.
+ * @return The number of components.
+ */
+uint32_t labelComponents(const std::vector<unsigned char>& mask, int width, int height,
+                         std::vector<uint32_t>& labels) {
+    TGC_STATS_PHASE("components");
+    size_t n = static_cast<size_t>(width) * height;
+    ArrayUnionFind sets(n);
+    for (size_t i = 0; i < n; ++i) {
+        if (!mask[i]) continue;
+        bool left = i % width > 0 && mask[i - 1];
+        bool up = i >= static_cast<size_t>(width) && mask[i - width];
+        if (left) {
+            sets.unite(sets.find(static_cast<uint32_t>(i)), sets.find(static_cast<uint32_t>(i - 1)), 0);
+        }
+        // with the up-left pixel set, left and up are already one component
+        if (up && !(left && mask[i - width - 1])) {
+            uint32_t a = sets.find(static_cast<uint32_t>(i)), b = sets.find(static_cast<uint32_t>(i - width));
+            if (a != b) sets.unite(a, b, 0);
+        }
+    }
+
+    std::vector<uint32_t> rootLabel(n, 0);
+    uint32_t count = 0;
+    labels.assign(n, 0);
+    for (size_t i = 0; i < n; ++i) {
+        if (!mask[i]) continue;
+        uint32_t& label = rootLabel[sets.find(static_cast<uint32_t>(i))];
+        if (label == 0) label = ++count;
+        labels[i] = label;
+    }
+    return count;
+}
+
+/**
+ * @brief Parallel labelComponents over ConcurrentUnionFind, with the same labels. The rows are cut into bands of
+ * BAND_ROWS. Each band first unites its own pixels; then the first row of every band is united with the row above, the
+ * only unions that touch two bands. Within a band the scanned pixel is still a singleton, so its first union is a plain
+ * attach, and the up union is skipped when the up-left pixel already joins up and left. Since a root is the smallest id
+ * of its set, it is also the component's first pixel in scan order, so counting roots per band and taking a prefix sum
+ * numbers the components as the sequential scan does.
+ * @param pool Pool that runs the bands; the calling thread works too.
+ * @param maxWorkers Upper bound on the threads labelling, the caller included (0 = the whole pool).
+ * @return The number of components.
  */
-double calculatePixelDifference(const Pixel& p1, const Pixel& p2) {
-    return std::sqrt(
-        std::pow(std::get<0>(p1) - std::get<0>(p2), 2) +
-        std::pow(std::get<1>(p1) - std::get<1>(p2), 2) +
-        std::pow(std::get<2>(p1) - std::get<2>(p2), 2)
-    );
+uint32_t labelComponentsParallel(const std::vector<unsigned char>& mask, int width, int height,
+                                 std::vector<uint32_t>& labels, parallel::ThreadPool& pool = parallel::sharedPool(),
+                                 size_t maxWorkers = 0) {
+    TGC_STATS_PHASE("components");
+    const size_t BAND_ROWS = 32;
+    size_t n = static_cast<size_t>(width) * height;
+    size_t bands = (height + BAND_ROWS - 1) / BAND_ROWS;
+    auto bandBegin = [&](size_t band) { return std::min(n, band * BAND_ROWS * width); };
+    ConcurrentUnionFind sets(n);
+    labels.assign(n, 0);
+
+    pool.parallelFor(0, bands, 1, [&](size_t from, size_t to) {
+        for (size_t band = from; band < to; ++band) {
+            size_t begin = bandBegin(band), end = bandBegin(band + 1);
+            sets.makeSets(begin, end);
+            for (size_t i = begin; i < end; ++i) {
+                if (!mask[i]) continue;
+                uint32_t pixel = static_cast<uint32_t>(i);
+                bool left = i % width > 0 && mask[i - 1];
+                bool up = i >= begin + width && mask[i - width];
+                if (left) {
+                    sets.attach(pixel, sets.find(pixel - 1));
+                    if (up && !mask[i - width - 1]) sets.unite(pixel, static_cast<uint32_t>(i - width));
+                } else if (up) {
+                    sets.attach(pixel, sets.find(static_cast<uint32_t>(i - width)));
+                }
+            }
+        }
+    }, maxWorkers);
+
+    pool.parallelFor(1, bands, 1, [&](size_t from, size_t to) {
+        for (size_t band = from; band < to; ++band) {
+            size_t begin = bandBegin(band);
+            for (size_t i = begin; i < begin + width; ++i) {
+                if (mask[i] && mask[i - width]) sets.unite(static_cast<uint32_t>(i), static_cast<uint32_t>(i - width));
+            }
+        }
+    }, maxWorkers);
+
+    // labels[i] holds the root of every non-root pixel until the last pass
+    std::vector<uint32_t> roots(bands + 1, 0);
+    pool.parallelFor(0, bands, 1, [&](size_t from, size_t to) {
+        for (size_t band = from; band < to; ++band) {
+            for (size_t i = bandBegin(band); i < bandBegin(band + 1); ++i) {
+                if (!mask[i]) continue;
+                uint32_t root = sets.find(static_cast<uint32_t>(i));
+                if (root == i) {
+                    roots[band + 1]++;
+                } else {
+                    labels[i] = root;
+                }
+            }
+        }
+    }, maxWorkers);
+    for (size_t band = 0; band < bands; ++band) {
+        roots[band + 1] += roots[band];
+    }
+
+    pool.parallelFor(0, bands, 1, [&](size_t from, size_t to) {
+        for (size_t band = from; band < to; ++band) {
+            uint32_t next = roots[band];
+            for (size_t i = bandBegin(band); i < bandBegin(band + 1); ++i) {
+                if (mask[i] && sets.isRoot(static_cast<uint32_t>(i))) labels[i] = ++next;
+            }
+        }
+    }, maxWorkers);
+    pool.parallelFor(0, bands, 1, [&](size_t from, size_t to) {
+        for (size_t i = bandBegin(from); i < bandBegin(to); ++i) {
+            if (mask[i] && !sets.isRoot(static_cast<uint32_t>(i))) labels[i] = labels[labels[i]];
+        }
+    }, maxWorkers);
+    return roots[bands];
 }
 
+/**
+ * Distance policies: the edge weight between two pixels, chosen at compile time. Thresholds are in the units of
+ * the policy (SquaredL2Distance expects squared thresholds). fromL2 converts a threshold given on the L2 scale: it
+ * returns the policy's distance for a step that an L2 distance of t would measure as t, taken along the grey axis
+ * (the same change d on all three channels, so that t = d * sqrt(3)). The conversion is exact for grey images.
+ */
+
+/**
+ * @brief Euclidean RGB distance (the original weight).
+ */
+struct L2Distance {
+    static constexpr const char* name = "l2";
+
+    static double between(const Pixel& p1, const Pixel& p2) {
+        int dr = std::get<0>(p1) - std::get<0>(p2);
+        int dg = std::get<1>(p1) - std::get<1>(p2);
+        int db = std::get<2>(p1) - std::get<2>(p2);
+        return std::sqrt(static_cast<double>(dr * dr + dg * dg + db * db));
+    }
+
+    static double fromL2(double t) { return t; }
+};
+
+/**
+ * @brief Squared Euclidean RGB distance: orders edges like L2Distance without the square root.
+ */
+struct SquaredL2Distance {
+    static constexpr const char* name = "l2sq";
+
+    static double between(const Pixel& p1, const Pixel& p2) {
+        int dr = std::get<0>(p1) - std::get<0>(p2);
+        int dg = std::get<1>(p1) - std::get<1>(p2);
+        int db = std::get<2>(p1) - std::get<2>(p2);
+        return dr * dr + dg * dg + db * db;
+    }
+
+    static double fromL2(double t) { return t * t; }
+};
+
+/**
+ * @brief Manhattan RGB distance.
+ */
+struct L1Distance {
+    static constexpr const char* name = "l1";
+
+    static double between(const Pixel& p1, const Pixel& p2) {
+        return std::abs(std::get<0>(p1) - std::get<0>(p2)) + std::abs(std::get<1>(p1) - std::get<1>(p2))
+               + std::abs(std::get<2>(p1) - std::get<2>(p2));
+    }
+
+    static double fromL2(double t) { return t * std::sqrt(3.0); }
+};
+
+/**
+ * @brief Absolute difference of the luma (ITU-R BT.601 weights), for grayscale segmentation.
+ */
+struct GrayDistance {
+    static constexpr const char* name = "gray";
+
+    static double between(const Pixel& p1, const Pixel& p2) {
+        return std::abs(0.299 * (std::get<0>(p1) - std::get<0>(p2)) + 0.587 * (std::get<1>(p1) - std::get<1>(p2))
+                        + 0.114 * (std::get<2>(p1) - std::get<2>(p2)));
+    }
+
+    static double fromL2(double t) { return t / std::sqrt(3.0); }
+};
+
+/**
+ * Neighbourhood policies: forEachEdge(width, height, depth, visit) calls visit(a, b) once for every pair of
+ * neighbouring pixels. Pixels are indexed (z * height + y) * width + x, so a volume is stored as depth slices of
+ * width x height stacked vertically; the 2-D neighbourhoods treat every slice as a separate image.
+ */
+
+/**
+ * @brief 4-connected: right and bottom neighbours.
+ */
+struct FourNeighbourhood {
+    static constexpr const char* name = "4";
+
+    template <typename Visit>
+    static void forEachEdge(int width, int height, int depth, Visit visit) {
+        for (int z = 0; z < depth; ++z) {
+            for (int y = 0; y < height; ++y) {
+                int row = (z * height + y) * width;
+                for (int x = 0; x < width; ++x) {
+                    if (x + 1 < width) visit(row + x, row + x + 1);
+                    if (y + 1 < height) visit(row + x, row + width + x);
+                }
+            }
+        }
+    }
+};
+
+/**
+ * @brief 8-connected: the 4-connected edges plus both diagonals.
+ */
+struct EightNeighbourhood {
+    static constexpr const char* name = "8";
+
+    template <typename Visit>
+    static void forEachEdge(int width, int height, int depth, Visit visit) {
+        for (int z = 0; z < depth; ++z) {
+            for (int y = 0; y < height; ++y) {
+                int row = (z * height + y) * width;
+                for (int x = 0; x < width; ++x) {
+                    if (x + 1 < width) visit(row + x, row + x + 1);
+                    if (y + 1 < height) {
+                        visit(row + x, row + width + x);
+                        if (x + 1 < width) visit(row + x, row + width + x + 1);
+                        if (x > 0) visit(row + x, row + width + x - 1);
+                    }
+                }
+            }
+        }
+    }
+};
+
+/**
+ * @brief 6-connected volume: the 4-connected edges of every slice plus the voxel at the same position in the next
+ * slice.
+ */
+struct SixNeighbourhood {
+    static constexpr const char* name = "6";
+
+    template <typename Visit>
+    static void forEachEdge(int width, int height, int depth, Visit visit) {
+        int slice = width * height;
+        for (int z = 0; z < depth; ++z) {
+            for (int y = 0; y < height; ++y) {
+                int row = (z * height + y) * width;
+                for (int x = 0; x < width; ++x) {
+                    if (x + 1 < width) visit(row + x, row + x + 1);
+                    if (y + 1 < height) visit(row + x, row + width + x);
+                    if (z + 1 < depth) visit(row + x, row + slice + x);
+                }
+            }
+        }
+    }
+};
+
 
 class Grafo {
 private:
-    std::unordered_map<int, Pixel> vertices;
-    std::unordered_map<int, std::unordered_map<int, double>> edges;
+    std::pmr::unordered_map<int, Pixel> vertices;
+    std::pmr::unordered_map<int, std::pmr::unordered_map<int, double>> edges;
 
 public:
+    /**
+     * @brief Creates an empty graph whose maps allocate from the given resource (an arena for per-run graphs).
+     */
+    explicit Grafo(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : vertices(resource), edges(resource) {}
 
     /**
      * @brief Adds a vertex to the graph with a specified ID and associated pixel data.
@@ -120,7 +629,7 @@ public:
      * @brief Gets the map of all vertices in the graph.
      * @return A constant reference to the map of vertices.
      */
-    const std::unordered_map<int, Pixel>& getVertices() const { 
+    const std::pmr::unordered_map<int, Pixel>& getVertices() const { 
         return vertices; 
     }
 
@@ -128,7 +637,7 @@ public:
      * @brief Gets the adjacency list of all edges in the graph.
      * @return A constant reference to the adjacency list of edges.
      */
-    const std::unordered_map<int, std::unordered_map<int, double>>& getEdges() const { 
+    const std::pmr::unordered_map<int, std::pmr::unordered_map<int, double>>& getEdges() const { 
         return edges; 
     }
 };
@@ -139,6 +648,7 @@ public:
  * @return A tuple containing the width, height, maximum color value, and pixel data of the image.
  */
 std::tuple<int, int, int, std::vector<Pixel>> readPPM(const std::string& filename) {
+    TGC_STATS_PHASE("read");
     std::ifstream file(filename, std::ios::binary);
     if (!file.is_open()) {
         throw std::runtime_error("Cannot open file: " + filename);
@@ -148,6 +658,9 @@ std::tuple<int, int, int, std::vector<Pixel>> readPPM(const std::string& filenam
     int width, height, maxVal;
     file >> magic >> width >> height >> maxVal;
     file.ignore(1); 
+    if (magic != "P6" || !file) {
+        throw std::runtime_error("Unsupported PPM file: " + filename);
+    }
 
     std::vector<Pixel> pixels;
     pixels.reserve(width * height);
@@ -164,210 +677,1942 @@ std::tuple<int, int, int, std::vector<Pixel>> readPPM(const std::string& filenam
 }
 
 /**
- * @brief Creates a graph representation from a PPM image, connecting neighboring pixels.
- * @param width The width of the image.
- * @param height The height of the image.
- * @param pixels A vector of pixels representing the image.
- * @return A graph representation of the image.
+ * @brief Reads a PNG, JPEG or PPM image, recognised by its content, into the same tuple as readPPM (the maximum
+ * color value is always 255).
+ * @param filename The path to the image file to read.
+ * @return A tuple containing the width, height, maximum color value, and pixel data of the image.
  */
-Grafo createGraphFromPPM(int width, int height, const std::vector<Pixel>& pixels) {
-    Grafo graph;
-    
-    
-    for (int i = 0; i < width * height; ++i) {
-        graph.addVertex(i, pixels[i]);
+std::tuple<int, int, int, std::vector<Pixel>> readImage(const std::string& filename) {
+    TGC_STATS_PHASE("read");
+    imageio::Image image = imageio::read(filename);
+
+    std::vector<Pixel> pixels;
+    pixels.reserve(static_cast<size_t>(image.width) * image.height);
+    for (size_t i = 0; i < image.rgb.size(); i += 3) {
+        pixels.push_back(std::make_tuple(image.rgb[i], image.rgb[i + 1], image.rgb[i + 2]));
+    }
+    return {image.width, image.height, 255, pixels};
+}
+
+/**
+ * @brief An image stored as three planes of floats (every red value, then every green, then every blue), so that
+ * per-channel filters run over contiguous rows.
+ */
+struct PlanarImage {
+    int width = 0;
+    int height = 0;
+    std::vector<float> data;
+
+    float* plane(int channel) {
+        return data.data() + static_cast<size_t>(channel) * width * height;
     }
 
-    
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            int current = y * width + x;
-            
-            
-            if (x + 1 < width) {
-                int right = y * width + (x + 1);
-                double weight = calculatePixelDifference(pixels[current], pixels[right]);
-                graph.addEdge(current, right, weight);
-            }
-            
-            
-            if (y + 1 < height) {
-                int bottom = (y + 1) * width + x;
-                double weight = calculatePixelDifference(pixels[current], pixels[bottom]);
-                graph.addEdge(current, bottom, weight);
-            }
+    static PlanarImage fromPixels(const std::vector<Pixel>& pixels, int width, int height) {
+        PlanarImage image;
+        image.width = width;
+        image.height = height;
+        image.data.resize(static_cast<size_t>(3) * width * height);
+        float* r = image.plane(0);
+        float* g = image.plane(1);
+        float* b = image.plane(2);
+        for (size_t i = 0; i < pixels.size(); ++i) {
+            r[i] = static_cast<float>(std::get<0>(pixels[i]));
+            g[i] = static_cast<float>(std::get<1>(pixels[i]));
+            b[i] = static_cast<float>(std::get<2>(pixels[i]));
         }
+        return image;
     }
 
-    return graph;
-}
+    /**
+     * @brief Writes the planes back into pixels, rounded to the nearest integer.
+     */
+    void toPixels(std::vector<Pixel>& pixels) {
+        const float* r = plane(0);
+        const float* g = plane(1);
+        const float* b = plane(2);
+        for (size_t i = 0; i < pixels.size(); ++i) {
+            pixels[i] = std::make_tuple(static_cast<int>(r[i] + 0.5f), static_cast<int>(g[i] + 0.5f),
+                                        static_cast<int>(b[i] + 0.5f));
+        }
+    }
+};
 
-class ImageSegmentation {
+/**
+ * @brief Separable Gaussian blur, as the pre-smoothing of Felzenszwalb and Huttenlocher (sigma around 0.8). The
+ * kernel reaches ceil(4 * sigma) pixels to each side and borders are clamped.
+ *
+ * Both passes work in place on a plane. The horizontal pass copies a row into a padded buffer and accumulates one
+ * kernel tap at a time over the whole row. The vertical pass works on blocks of columns: it keeps the original
+ * values of the 2 * radius + 1 rows in use in a ring and accumulates whole rows of the block per tap. Every inner
+ * loop is a contiguous multiply-add over floats, which the compiler vectorises. Rows (horizontal pass) and column
+ * blocks (vertical pass) are spread over the shared thread pool.
+ */
+class GaussianBlur {
 private:
-    Grafo& graph;
-    int width;
-    int height;
-
-    struct Edge {
-        int source;
-        int dest;
-        double weight;
-        
-        Edge(int s, int d, double w) : source(s), dest(d), weight(w) {}
-        
-        bool operator<(const Edge& other) const {
-            return weight < other.weight;
-        }
-    };
+    static constexpr int LANES = 8;
+    static constexpr int COLUMN_BLOCK = 256;
+    static constexpr size_t ROW_GRAIN = 16;
 
-public:
-    ImageSegmentation(Grafo& g, int w, int h) : graph(g), width(w), height(h) {}
+    std::vector<float> kernel;
+    int radius;
 
     /**
-     * @brief Segments an image into connected components based on pixel similarity using a threshold.
-     * @param threshold The maximum allowable weight for edges to be included in a component.
-     * @return A vector of components, where each component is a vector of pixel indices.
+     * @brief out[x] = kernel[0] * centre[x] + sum over k of kernel[k] * (before[k][x] + after[k][x]), for x in
+     * [0, count). The main loop handles LANES values at a time, with every tap accumulated in a fixed-size local
+     * array, a shape the compiler turns into vector instructions; out must not overlap the inputs.
      */
-    std::vector<std::vector<int>> segment(double threshold = 1.0) {
-        std::vector<Edge> sortedEdges;
-        for (const auto& vertexPair : graph.getVertices()) {
-            int vertex = vertexPair.first;
-            
-            for (const auto& neighborPair : graph.getEdges().at(vertex)) {
-                int neighbor = neighborPair.first;
-                
-                if (vertex < neighbor) {
-                    double weight = neighborPair.second;
-                    sortedEdges.emplace_back(vertex, neighbor, weight);
+    void convolve(float* out, const float* centre, const float* const* before, const float* const* after,
+                  int count) const {
+        int x = 0;
+        for (; x + LANES <= count; x += LANES) {
+            float sum[LANES];
+            for (int l = 0; l < LANES; ++l) {
+                sum[l] = kernel[0] * centre[x + l];
+            }
+            for (int k = 1; k <= radius; ++k) {
+                const float weight = kernel[k];
+                const float* lower = before[k] + x;
+                const float* upper = after[k] + x;
+                for (int l = 0; l < LANES; ++l) {
+                    sum[l] += weight * (lower[l] + upper[l]);
                 }
             }
+            for (int l = 0; l < LANES; ++l) {
+                out[x + l] = sum[l];
+            }
         }
-        
-        std::sort(sortedEdges.begin(), sortedEdges.end());
-
-        std::vector<int> vertices;
-        for (const auto& vertexPair : graph.getVertices()) {
-            vertices.push_back(vertexPair.first);
+        for (; x < count; ++x) {
+            float sum = kernel[0] * centre[x];
+            for (int k = 1; k <= radius; ++k) {
+                sum += kernel[k] * (before[k][x] + after[k][x]);
+            }
+            out[x] = sum;
         }
-        UnionFind<int> unionFind(vertices);
-
-        for (const Edge& edge : sortedEdges) {
-            int u = edge.source;
-            int v = edge.dest;
-            double weight = edge.weight;
+    }
 
-            int rootU = unionFind.find(u);
-            int rootV = unionFind.find(v);
+    void blurRows(float* plane, int width, int height) const {
+        parallel::sharedPool().parallelFor(0, height, ROW_GRAIN, [&](size_t from, size_t to) {
+            std::vector<float> padded(width + 2 * radius);
+            std::vector<const float*> before(radius + 1), after(radius + 1);
+            const float* centre = padded.data() + radius;
+            for (int k = 1; k <= radius; ++k) {
+                before[k] = centre - k;
+                after[k] = centre + k;
+            }
 
-            if (rootU != rootV) {
-                if (weight < threshold) {
-                    unionFind.unionSets(u, v, weight);
-                }
+            for (size_t y = from; y < to; ++y) {
+                float* row = plane + y * width;
+                std::fill(padded.begin(), padded.begin() + radius, row[0]);
+                std::copy(row, row + width, padded.begin() + radius);
+                std::fill(padded.begin() + radius + width, padded.end(), row[width - 1]);
+                convolve(row, centre, before.data(), after.data(), width);
             }
-        }
+        });
+    }
 
-        std::unordered_map<int, std::vector<int>> components;
-        for (const auto& vertexPair : graph.getVertices()) {
-            int vertex = vertexPair.first;
-            int root = unionFind.find(vertex);
-            components[root].push_back(vertex);
-        }
+    void blurColumns(float* plane, int width, int height) const {
+        size_t blocks = (width + COLUMN_BLOCK - 1) / COLUMN_BLOCK;
+        int taps = 2 * radius + 1;
+        parallel::sharedPool().parallelFor(0, blocks, 1, [&](size_t from, size_t to) {
+            std::vector<float> window(static_cast<size_t>(taps) * COLUMN_BLOCK);
+            std::vector<const float*> before(radius + 1), after(radius + 1);
 
-        std::vector<std::vector<int>> finalSegmentation;
-        for (const auto& componentPair : components) {
-            finalSegmentation.push_back(componentPair.second);
-        }
+            for (size_t block = from; block < to; ++block) {
+                int x0 = static_cast<int>(block) * COLUMN_BLOCK;
+                int columns = std::min(COLUMN_BLOCK, width - x0);
 
-        return finalSegmentation;
-    }
+                // window slot (j mod taps) holds the original values of row j (clamped to the image)
+                auto slot = [&](int j) { return window.data() + ((j % taps + taps) % taps) * COLUMN_BLOCK; };
+                auto load = [&](int j) {
+                    size_t clamped = static_cast<size_t>(std::min(std::max(j, 0), height - 1));
+                    const float* source = plane + clamped * width + x0;
+                    std::copy(source, source + columns, slot(j));
+                };
+                for (int j = -radius; j <= radius; ++j) {
+                    load(j);
+                }
 
-    /**
-     * @brief Saves the segmented image as a PPM file, coloring each component with a unique random color.
-     * @param segmentation The segmentation result containing components of pixel indices.
-     * @param outputPath The path to save the output PPM file.
+                for (int y = 0; y < height; ++y) {
+                    for (int k = 1; k <= radius; ++k) {
+                        before[k] = slot(y - k);
+                        after[k] = slot(y + k);
+                    }
+                    convolve(plane + static_cast<size_t>(y) * width + x0, slot(y), before.data(), after.data(),
+                             columns);
+                    load(y + radius + 1);
+                }
+            }
+        });
+    }
+
+public:
+    /**
+     * @param sigma Standard deviation of the Gaussian, in pixels (must be positive).
+     */
+    explicit GaussianBlur(double sigma) : radius(static_cast<int>(std::ceil(4 * sigma))) {
+        kernel.resize(radius + 1);
+        double sum = 0;
+        for (int k = 0; k <= radius; ++k) {
+            kernel[k] = static_cast<float>(std::exp(-0.5 * (k / sigma) * (k / sigma)));
+            sum += k == 0 ? kernel[k] : 2 * kernel[k];
+        }
+        for (float& weight : kernel) {
+            weight = static_cast<float>(weight / sum);
+        }
+    }
+
+    /**
+     * @brief Blurs one plane of width x height floats in place.
+     */
+    void apply(float* plane, int width, int height) const {
+        if (width <= 0 || height <= 0) return;
+        blurRows(plane, width, height);
+        blurColumns(plane, width, height);
+    }
+
+    /**
+     * @brief Blurs every plane of the image in place. An image of stacked slices is blurred one slice at a time,
+     * so rows of neighbouring slices never mix.
+     * @param slices Number of slices stacked vertically (image.height must be a multiple of it).
+     */
+    void apply(PlanarImage& image, int slices = 1) const {
+        int sliceHeight = image.height / slices;
+        size_t sliceSize = static_cast<size_t>(image.width) * sliceHeight;
+        for (int channel = 0; channel < 3; ++channel) {
+            for (int z = 0; z < slices; ++z) {
+                apply(image.plane(channel) + z * sliceSize, image.width, sliceHeight);
+            }
+        }
+    }
+};
+
+/**
+ * @brief Smooths an image in place with a Gaussian of the given sigma before its graph is built (no-op for
+ * sigma <= 0). The result is rounded back to integer pixels.
+ * @param slices Number of slices stacked vertically in the image; each is smoothed on its own.
+ */
+void smoothPixels(std::vector<Pixel>& pixels, int width, int height, double sigma, int slices = 1) {
+    if (sigma <= 0) return;
+    TGC_STATS_PHASE("smooth");
+    PlanarImage planar = PlanarImage::fromPixels(pixels, width, height);
+    GaussianBlur(sigma).apply(planar, slices);
+    planar.toPixels(pixels);
+}
+
+/**
+ * @brief Creates a graph representation from a PPM image, connecting neighboring pixels.
+ * @tparam Distance The distance policy giving the edge weights.
+ * @tparam Neighbourhood The neighbourhood policy giving the edges.
+ * @param width The width of the image.
+ * @param height The height of the image (of one slice, for a volume).
+ * @param pixels A vector of pixels representing the image; a volume holds pixels.size() / (width * height) slices.
+ * @param resource Where the graph's maps are allocated.
+ * @return A graph representation of the image.
+ */
+template <typename Distance = L2Distance, typename Neighbourhood = FourNeighbourhood>
+Grafo createGraphFromPPM(int width, int height, const std::vector<Pixel>& pixels,
+                         std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+    TGC_STATS_PHASE("graph_build");
+    Grafo graph(resource);
+    
+    
+    for (size_t i = 0; i < pixels.size(); ++i) {
+        graph.addVertex(static_cast<int>(i), pixels[i]);
+    }
+
+    int depth = static_cast<int>(pixels.size() / (static_cast<size_t>(width) * height));
+    long long edges = 0;
+    Neighbourhood::forEachEdge(width, height, depth, [&](int a, int b) {
+        graph.addEdge(a, b, Distance::between(pixels[a], pixels[b]));
+        edges++;
+    });
+    TGC_STATS_COUNT("graph_edges", edges);
+
+    return graph;
+}
+
+/**
+ * @brief Summary of one component, gathered while the labels are assigned.
+ */
+struct ComponentStats {
+    uint32_t pixelCount = 0;
+    int minX = 0, minY = 0, maxX = 0, maxY = 0;
+    double meanR = 0, meanG = 0, meanB = 0;
+    double centroidX = 0, centroidY = 0;
+};
+
+/**
+ * @brief Result of a segmentation: one dense label per pixel, in row-major order, and the stats of every
+ * component. Label l refers to components[l]; components are numbered in the order of their union-find roots.
+ */
+struct SegmentationResult {
+    std::vector<uint32_t> labels;
+    std::vector<ComponentStats> components;
+
+    /**
+     * @brief Number of components.
+     */
+    size_t size() const {
+        return components.size();
+    }
+};
+
+/**
+ * @brief Rebuilds a SegmentationResult from dense labels, gathering the component stats from the pixels the
+ * segmentation saw. Used for results that come from the cache instead of a graph.
+ * @param labels One label per pixel, each below components.
+ */
+SegmentationResult summarizeLabels(std::vector<uint32_t> labels, uint32_t components, int width,
+                                   const std::vector<Pixel>& pixels) {
+    SegmentationResult result;
+    result.labels = std::move(labels);
+    result.components.resize(components);
+    std::vector<uint64_t> sums(static_cast<size_t>(components) * 5, 0);
+    for (ComponentStats& stats : result.components) {
+        stats.minX = stats.minY = INT32_MAX;
+        stats.maxX = stats.maxY = -1;
+    }
+    for (size_t i = 0; i < result.labels.size(); ++i) {
+        uint32_t label = result.labels[i];
+        int x = static_cast<int>(i % width);
+        int y = static_cast<int>(i / width);
+        ComponentStats& stats = result.components[label];
+        uint64_t* sum = &sums[static_cast<size_t>(label) * 5];
+        stats.pixelCount++;
+        sum[0] += std::get<0>(pixels[i]);
+        sum[1] += std::get<1>(pixels[i]);
+        sum[2] += std::get<2>(pixels[i]);
+        sum[3] += x;
+        sum[4] += y;
+        stats.minX = std::min(stats.minX, x);
+        stats.minY = std::min(stats.minY, y);
+        stats.maxX = std::max(stats.maxX, x);
+        stats.maxY = std::max(stats.maxY, y);
+    }
+    for (uint32_t label = 0; label < components; ++label) {
+        ComponentStats& stats = result.components[label];
+        const uint64_t* sum = &sums[static_cast<size_t>(label) * 5];
+        double count = stats.pixelCount;
+        stats.meanR = sum[0] / count;
+        stats.meanG = sum[1] / count;
+        stats.meanB = sum[2] / count;
+        stats.centroidX = sum[3] / count;
+        stats.centroidY = sum[4] / count;
+    }
+    return result;
+}
+
+/**
+ * @brief Saves a segmentation image, coloring each component with a unique random color. The file is a PNG
+ * unless outputPath ends in ".ppm".
+ * @param segmentation The segmentation result.
+ * @param width The width of the image.
+ * @param height The height of the image.
+ * @param outputPath The path to save the output image.
+ */
+void writeSegmentationImage(const SegmentationResult& segmentation, int width, int height,
+                            const std::string& outputPath) {
+    TGC_STATS_PHASE("write");
+    std::vector<Pixel> componentColors;
+    std::srand(std::time(nullptr)); 
+    for (size_t i = 0; i < segmentation.size(); ++i) {
+        componentColors.push_back(std::make_tuple(
+            std::rand() % 256,
+            std::rand() % 256,
+            std::rand() % 256
+        ));
+    }
+
+    std::vector<unsigned char> outputPixels(segmentation.labels.size() * 3);
+    for (size_t i = 0; i < segmentation.labels.size(); ++i) {
+        const Pixel& color = componentColors[segmentation.labels[i]];
+        outputPixels[i * 3] = static_cast<unsigned char>(std::get<0>(color));
+        outputPixels[i * 3 + 1] = static_cast<unsigned char>(std::get<1>(color));
+        outputPixels[i * 3 + 2] = static_cast<unsigned char>(std::get<2>(color));
+    }
+
+    imageio::write(outputPath, width, height, outputPixels.data());
+}
+
+/**
+ * @brief Prints the segmentation results: the number of components and, for each one, its size, bounding
+ * box, mean colour and centroid.
+ * @param segmentation The segmentation result.
+ */
+void printSegmentation(const SegmentationResult& segmentation) {
+    std::cout << "Segmentation Results:\n";
+    std::cout << "Number of Components: " << segmentation.size() << "\n";
+    for (size_t i = 0; i < segmentation.size(); ++i) {
+        const ComponentStats& stats = segmentation.components[i];
+        std::cout << "Component " << i + 1 << ": " << stats.pixelCount << " pixels, bbox ("
+                  << stats.minX << "," << stats.minY << ")-(" << stats.maxX << "," << stats.maxY
+                  << "), mean RGB (" << stats.meanR << "," << stats.meanG << "," << stats.meanB
+                  << "), centroid (" << stats.centroidX << "," << stats.centroidY << ")\n";
+    }
+}
+
+/**
+ * @brief Merge dendrogram of the Fixed criterion. Leaves are the pixels 0..n-1. Internal node n + i is the i-th
+ * merge made by Kruskal over all edges; it stores the weight of the merging edge and the size of the merged
+ * component.
+ *
+ * Merges are stored in weight order, so the segmentation for any threshold is a prefix of the merges, and so is
+ * the segmentation with any number of components. Either is read off the tree in one linear pass, with no edge
+ * sorting and no union-find.
+ *
+ * Only the Fixed criterion can be answered. The Adaptive predicate and the minimum-size pass depend on the
+ * components' state, not just on the edge order. Weights are kept as float.
+ */
+class MergeTree {
+private:
+    static constexpr uint32_t NO_PARENT = UINT32_MAX;
+    static constexpr uint32_t VERSION = 1;
+
+    uint32_t width;
+    uint32_t height;
+    std::vector<uint32_t> parent;
+    std::vector<float> mergeWeight;
+    std::vector<uint32_t> mergeSize;
+
+    static const char* magic() {
+        return "TGCMTREE";
+    }
+
+public:
+    MergeTree() : width(0), height(0) {}
+
+    /**
+     * @brief Creates a tree with one leaf per pixel and no merges.
+     */
+    MergeTree(int width, int height)
+        : width(width), height(height), parent(static_cast<size_t>(width) * height, NO_PARENT) {}
+
+    /**
+     * @brief Records the merge of two top-level nodes. Merges must be added in non-decreasing weight order.
+     * @param a The first node.
+     * @param b The second node.
+     * @param weight The weight of the edge joining them.
+     * @param size The number of pixels of the merged component.
+     * @return The id of the new node.
+     */
+    uint32_t merge(uint32_t a, uint32_t b, float weight, uint32_t size) {
+        uint32_t node = static_cast<uint32_t>(parent.size());
+        parent.push_back(NO_PARENT);
+        parent[a] = node;
+        parent[b] = node;
+        mergeWeight.push_back(weight);
+        mergeSize.push_back(size);
+        return node;
+    }
+
+    size_t leaves() const { return static_cast<size_t>(width) * height; }
+
+    size_t merges() const { return mergeWeight.size(); }
+
+    int getWidth() const { return static_cast<int>(width); }
+
+    int getHeight() const { return static_cast<int>(height); }
+
+    /**
+     * @brief Number of merges the Fixed criterion makes with the given threshold (edges of weight < threshold).
+     */
+    size_t mergesBelow(double threshold) const {
+        return std::lower_bound(mergeWeight.begin(), mergeWeight.end(), threshold,
+                                [](float weight, double value) { return weight < value; }) - mergeWeight.begin();
+    }
+
+    /**
+     * @brief Labels of the segmentation made by the first merges of the tree.
+     * @param merges Number of merges to apply (clamped to the number recorded).
+     * @param labels Receives one dense label per pixel; components are numbered in order of their top node.
+     * @return The number of components.
+     */
+    size_t cut(size_t merges, std::vector<uint32_t>& labels) const {
+        size_t n = leaves();
+        size_t active = n + std::min(merges, this->merges());
+
+        // a parent always has a larger id than its children, so one pass from the top resolves every node
+        std::vector<uint32_t> top(active);
+        for (size_t v = active; v-- > 0;) {
+            uint32_t p = parent[v];
+            top[v] = p < active ? top[p] : static_cast<uint32_t>(v);
+        }
+
+        // dense labels: exclusive prefix sum over the nodes that are their own top
+        std::vector<uint32_t> denseId(active);
+        uint32_t components = 0;
+        for (size_t v = 0; v < active; ++v) {
+            denseId[v] = components;
+            components += top[v] == v;
+        }
+
+        labels.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            labels[i] = denseId[top[i]];
+        }
+        return components;
+    }
+
+    /**
+     * @brief The Fixed-criterion segmentation for a threshold, as segment(threshold) would compute it.
+     */
+    size_t cutAtThreshold(double threshold, std::vector<uint32_t>& labels) const {
+        return cut(mergesBelow(threshold), labels);
+    }
+
+    /**
+     * @brief The segmentation with the given number of components (or the closest the graph allows), obtained by
+     * stopping the merges early.
+     */
+    size_t cutToComponents(size_t components, std::vector<uint32_t>& labels) const {
+        return cut(leaves() > components ? leaves() - components : 0, labels);
+    }
+
+    /**
+     * @brief Writes the tree as a binary index: the magic "TGCMTREE", then version, width, height and number of
+     * merges as uint32, then the parent of every node (uint32), the weight of every merge (float) and the size of
+     * every merge (uint32), all in native (little-endian) byte order.
+     * @throws std::runtime_error If the file cannot be written.
+     */
+    void save(const std::string& path) const {
+        std::ofstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Error creating merge tree file: " + path);
+        }
+
+        uint32_t header[4] = {VERSION, width, height, static_cast<uint32_t>(merges())};
+        file.write(magic(), 8);
+        file.write(reinterpret_cast<const char*>(header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(parent.data()), parent.size() * sizeof(uint32_t));
+        file.write(reinterpret_cast<const char*>(mergeWeight.data()), mergeWeight.size() * sizeof(float));
+        file.write(reinterpret_cast<const char*>(mergeSize.data()), mergeSize.size() * sizeof(uint32_t));
+        if (!file) {
+            throw std::runtime_error("Error writing merge tree file: " + path);
+        }
+    }
+
+    /**
+     * @brief Reads a tree written by save().
+     * @throws std::runtime_error If the file cannot be read or is not a merge tree of this version.
+     */
+    static MergeTree load(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Cannot open merge tree file: " + path);
+        }
+
+        char fileMagic[8];
+        uint32_t header[4];
+        file.read(fileMagic, 8);
+        file.read(reinterpret_cast<char*>(header), sizeof(header));
+        if (!file || std::string(fileMagic, 8) != magic() || header[0] != VERSION) {
+            throw std::runtime_error("Unsupported merge tree file: " + path);
+        }
+
+        MergeTree tree(static_cast<int>(header[1]), static_cast<int>(header[2]));
+        size_t merges = header[3];
+        tree.parent.resize(tree.leaves() + merges);
+        tree.mergeWeight.resize(merges);
+        tree.mergeSize.resize(merges);
+        file.read(reinterpret_cast<char*>(tree.parent.data()), tree.parent.size() * sizeof(uint32_t));
+        file.read(reinterpret_cast<char*>(tree.mergeWeight.data()), merges * sizeof(float));
+        file.read(reinterpret_cast<char*>(tree.mergeSize.data()), merges * sizeof(uint32_t));
+        if (!file) {
+            throw std::runtime_error("Truncated merge tree file: " + path);
+        }
+        return tree;
+    }
+};
+
+/**
+ * @brief Graph-based segmentation (Kruskal over the edges sorted by weight with a union-find).
+ * @tparam Distance The distance policy the graph is built with (see buildGraph).
+ * @tparam Neighbourhood The neighbourhood policy the graph is built with.
+ */
+template <typename Distance = L2Distance, typename Neighbourhood = FourNeighbourhood>
+class ImageSegmentation {
+private:
+    Grafo& graph;
+    int width;
+    int height;
+    std::unique_ptr<arena::Arena> ownScratch;
+    arena::Arena* scratch;
+
+    struct Edge {
+        int source;
+        int dest;
+        double weight;
+        
+        Edge(int s, int d, double w) : source(s), dest(d), weight(w) {}
+        
+        bool operator<(const Edge& other) const {
+            return weight < other.weight;
+        }
+    };
+
+    /**
+     * @brief Lists every graph edge once and sorts the list by weight.
+     */
+    void collectSortedEdges(std::pmr::vector<Edge>& sortedEdges) {
+        sortedEdges.reserve(graph.getVertices().size() * 2);
+        {
+            TGC_STATS_PHASE("edge_list");
+            for (const auto& vertexPair : graph.getVertices()) {
+                int vertex = vertexPair.first;
+
+                for (const auto& neighborPair : graph.getEdges().at(vertex)) {
+                    int neighbor = neighborPair.first;
+
+                    if (vertex < neighbor) {
+                        double weight = neighborPair.second;
+                        sortedEdges.emplace_back(vertex, neighbor, weight);
+                    }
+                }
+            }
+        }
+        TGC_STATS_COUNT("edges", sortedEdges.size());
+
+        TGC_STATS_PHASE("sort");
+        parallel::sharedPool().parallelSort(sortedEdges.begin(), sortedEdges.end());
+    }
+
+    /**
+     * @brief Sums of one component, turned into ComponentStats at the end of relabel().
+     */
+    struct ComponentSums {
+        uint64_t r = 0, g = 0, b = 0, x = 0, y = 0;
+        uint32_t count = 0;
+        int minX = INT32_MAX, minY = INT32_MAX, maxX = -1, maxY = -1;
+    };
+
+    /**
+     * @brief Turns the union-find into dense labels. Each pixel's root is looked up once; an exclusive prefix sum
+     * over the "is a root" flags gives every root its label, and a second pass over the vertices writes the labels
+     * and accumulates the component stats. Vertex ids must be the pixel indices 0..width*height-1.
+     */
+    SegmentationResult relabel(UnionFind<int>& unionFind, std::pmr::memory_resource* memory) {
+        size_t n = static_cast<size_t>(width) * height;
+        std::pmr::vector<uint32_t> roots(n, memory);
+        std::pmr::vector<uint32_t> labelOf(n, memory);
+        for (const auto& vertexPair : graph.getVertices()) {
+            int vertex = vertexPair.first;
+            roots[vertex] = static_cast<uint32_t>(unionFind.find(vertex));
+            labelOf[vertex] = roots[vertex] == static_cast<uint32_t>(vertex);
+        }
+
+        uint32_t components = 0;
+        for (size_t i = 0; i < n; ++i) {
+            uint32_t isRoot = labelOf[i];
+            labelOf[i] = components;
+            components += isRoot;
+        }
+
+        SegmentationResult result;
+        result.labels.resize(n);
+        std::pmr::vector<ComponentSums> sums(components, memory);
+        for (const auto& vertexPair : graph.getVertices()) {
+            int vertex = vertexPair.first;
+            const Pixel& pixel = vertexPair.second;
+            int x = vertex % width;
+            int y = vertex / width;
+
+            uint32_t label = labelOf[roots[vertex]];
+            result.labels[vertex] = label;
+
+            ComponentSums& sum = sums[label];
+            sum.count++;
+            sum.r += std::get<0>(pixel);
+            sum.g += std::get<1>(pixel);
+            sum.b += std::get<2>(pixel);
+            sum.x += x;
+            sum.y += y;
+            sum.minX = std::min(sum.minX, x);
+            sum.minY = std::min(sum.minY, y);
+            sum.maxX = std::max(sum.maxX, x);
+            sum.maxY = std::max(sum.maxY, y);
+        }
+
+        result.components.resize(components);
+        for (uint32_t label = 0; label < components; ++label) {
+            const ComponentSums& sum = sums[label];
+            ComponentStats& stats = result.components[label];
+            double count = sum.count;
+            stats.pixelCount = sum.count;
+            stats.minX = sum.minX;
+            stats.minY = sum.minY;
+            stats.maxX = sum.maxX;
+            stats.maxY = sum.maxY;
+            stats.meanR = sum.r / count;
+            stats.meanG = sum.g / count;
+            stats.meanB = sum.b / count;
+            stats.centroidX = sum.x / count;
+            stats.centroidY = sum.y / count;
+        }
+        return result;
+    }
+
+public:
+    /**
+     * @brief Builds the graph of an image with this segmentation's policies.
+     * @param height The height of the image, or of one slice for a volume of stacked slices.
+     */
+    static Grafo buildGraph(int width, int height, const std::vector<Pixel>& pixels,
+                            std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+        return createGraphFromPPM<Distance, Neighbourhood>(width, height, pixels, resource);
+    }
+
+    /**
+     * @param scratch Arena for the structures that only live during one segment() call (edge list, union-find,
+     * relabelling tables). It is reset at the start of every call; when null, the segmentation keeps its own.
+     */
+    ImageSegmentation(Grafo& g, int w, int h, arena::Arena* scratch = nullptr)
+        : graph(g), width(w), height(h),
+          ownScratch(scratch == nullptr ? new arena::Arena() : nullptr),
+          scratch(scratch == nullptr ? ownScratch.get() : scratch) {}
+
+    /**
+     * @brief Segments an image into connected components based on pixel similarity.
+     * @param threshold The maximum allowable edge weight (Fixed) or the scale constant k (Adaptive).
+     * @param criterion The merge predicate to use.
+     * @param minSize Components smaller than this are merged into a neighbour in a second pass over the sorted
+     * edges (0 disables the pass).
+     * @return The label of every pixel and the stats of every component.
+     */
+    SegmentationResult segment(double threshold = 1.0,
+                               MergeCriterion criterion = MergeCriterion::Fixed,
+                               int minSize = 0) {
+        scratch->reset();
+        std::pmr::memory_resource* memory = scratch->resource();
+
+        std::pmr::vector<Edge> sortedEdges(memory);
+        collectSortedEdges(sortedEdges);
+
+        TGC_STATS_PHASE("merge");
+        std::pmr::vector<int> vertices(memory);
+        vertices.reserve(graph.getVertices().size());
+        for (const auto& vertexPair : graph.getVertices()) {
+            vertices.push_back(vertexPair.first);
+        }
+        UnionFind<int> unionFind(vertices, memory);
+
+        for (const Edge& edge : sortedEdges) {
+            int u = edge.source;
+            int v = edge.dest;
+            double weight = edge.weight;
+
+            int rootU = unionFind.find(u);
+            int rootV = unionFind.find(v);
+
+            if (rootU != rootV) {
+                if (shouldMerge(criterion, threshold, weight,
+                                unionFind.getInternalDifference(rootU), unionFind.getSize(rootU),
+                                unionFind.getInternalDifference(rootV), unionFind.getSize(rootV))) {
+                    unionFind.unionSets(rootU, rootV, weight);
+                }
+            }
+        }
+
+        if (minSize > 1) {
+            for (const Edge& edge : sortedEdges) {
+                int rootU = unionFind.find(edge.source);
+                int rootV = unionFind.find(edge.dest);
+
+                if (rootU != rootV &&
+                    (unionFind.getSize(rootU) < minSize || unionFind.getSize(rootV) < minSize)) {
+                    unionFind.unionSets(rootU, rootV, edge.weight);
+                }
+            }
+        }
+
+        SegmentationResult result = relabel(unionFind, memory);
+        TGC_STATS_COUNT("union_find_hops", unionFind.getFindHops());
+        TGC_STATS_COUNT("components", result.size());
+        return result;
+    }
+
+    /**
+     * @brief Runs Kruskal once over all edges, with no threshold, and records every merge in a MergeTree.
+     * @return The tree, from which Fixed-criterion segmentations for any threshold can be cut.
+     */
+    MergeTree buildMergeTree() {
+        scratch->reset();
+        std::pmr::vector<Edge> sortedEdges(scratch->resource());
+        collectSortedEdges(sortedEdges);
+
+        TGC_STATS_PHASE("merge_tree");
+        size_t n = static_cast<size_t>(width) * height;
+        MergeTree tree(width, height);
+        ArrayUnionFind unionFind(n);
+        std::vector<uint32_t> nodeOf(n);
+        for (size_t i = 0; i < n; ++i) {
+            nodeOf[i] = static_cast<uint32_t>(i);
+        }
+
+        for (const Edge& edge : sortedEdges) {
+            uint32_t rootA = unionFind.find(static_cast<uint32_t>(edge.source));
+            uint32_t rootB = unionFind.find(static_cast<uint32_t>(edge.dest));
+            if (rootA == rootB) continue;
+
+            uint32_t node = tree.merge(nodeOf[rootA], nodeOf[rootB], static_cast<float>(edge.weight),
+                                       unionFind.getSize(rootA) + unionFind.getSize(rootB));
+            nodeOf[unionFind.unite(rootA, rootB, static_cast<float>(edge.weight))] = node;
+        }
+        TGC_STATS_COUNT("union_find_hops", unionFind.takeFindHops());
+        return tree;
+    }
+
+    /**
+     * @brief Saves the segmented image; see writeSegmentationImage.
+     */
+    void saveSegmentationImage(const SegmentationResult& segmentation,
+                                const std::string& outputPath) {
+        writeSegmentationImage(segmentation, width, height, outputPath);
+    }
+
+    /**
+     * @brief Prints the segmentation results; see ::printSegmentation.
+     */
+    void printSegmentation(const SegmentationResult& segmentation) {
+        ::printSegmentation(segmentation);
+    }
+};
+
+/**
+ * @brief Reads a binary PPM (P6) in row strips without loading the whole image. On POSIX systems each strip is
+ * memory-mapped straight from the file and unmapped when the next one is requested; elsewhere it is read into a
+ * strip-sized buffer.
+ */
+class PPMStripReader {
+private:
+    int width;
+    int height;
+    std::streamoff dataOffset;
+#ifdef _WIN32
+    std::ifstream file;
+    std::vector<unsigned char> buffer;
+#else
+    int fd;
+    void* mapping;
+    size_t mappingLength;
+
+    void unmap() {
+        if (mapping != nullptr) {
+            munmap(mapping, mappingLength);
+            mapping = nullptr;
+        }
+    }
+#endif
+
+public:
+    /**
+     * @brief Opens a PPM file and parses its header.
+     * @param filename The path to the PPM file.
+     * @throws std::runtime_error If the file cannot be opened or is not an 8-bit P6 image.
+     */
+    explicit PPMStripReader(const std::string& filename) {
+        std::ifstream header(filename, std::ios::binary);
+        if (!header.is_open()) {
+            throw std::runtime_error("Cannot open file: " + filename);
+        }
+
+        std::string magic;
+        int maxVal;
+        header >> magic >> width >> height >> maxVal;
+        header.ignore(1);
+        if (magic != "P6" || maxVal > 255 || !header) {
+            throw std::runtime_error("Unsupported PPM file: " + filename);
+        }
+        dataOffset = header.tellg();
+
+#ifdef _WIN32
+        file.open(filename, std::ios::binary);
+#else
+        mapping = nullptr;
+        mappingLength = 0;
+        fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open file: " + filename);
+        }
+#endif
+    }
+
+    ~PPMStripReader() {
+#ifndef _WIN32
+        unmap();
+        close(fd);
+#endif
+    }
+
+    PPMStripReader(const PPMStripReader&) = delete;
+    PPMStripReader& operator=(const PPMStripReader&) = delete;
+
+    int getWidth() const { return width; }
+
+    int getHeight() const { return height; }
+
+    /**
+     * @brief Gives access to the interleaved RGB bytes of rows [y0, y0 + rows).
+     * @return A pointer that stays valid until the next call.
+     * @throws std::runtime_error If the rows cannot be read.
+     */
+    const unsigned char* readRows(int y0, int rows) {
+        size_t length = static_cast<size_t>(rows) * width * 3;
+        std::streamoff offset = dataOffset + static_cast<std::streamoff>(y0) * width * 3;
+#ifdef _WIN32
+        buffer.resize(length);
+        file.seekg(offset);
+        if (!file.read(reinterpret_cast<char*>(buffer.data()), length)) {
+            throw std::runtime_error("Unexpected end of PPM data.");
+        }
+        return buffer.data();
+#else
+        unmap();
+        static const long pageSize = sysconf(_SC_PAGESIZE);
+        std::streamoff aligned = offset - offset % pageSize;
+        size_t delta = static_cast<size_t>(offset - aligned);
+
+        mappingLength = length + delta;
+        mapping = mmap(nullptr, mappingLength, PROT_READ, MAP_PRIVATE, fd, aligned);
+        if (mapping == MAP_FAILED) {
+            mapping = nullptr;
+            throw std::runtime_error("Cannot map PPM data.");
+        }
+        return static_cast<const unsigned char*>(mapping) + delta;
+#endif
+    }
+};
+
+/**
+ * @brief Euclidean RGB distance between two interleaved RGB pixels, as in L2Distance.
+ */
+inline float rgbDifference(const unsigned char* p1, const unsigned char* p2) {
+    int dr = p1[0] - p2[0];
+    int dg = p1[1] - p2[1];
+    int db = p1[2] - p2[2];
+    return std::sqrt(static_cast<float>(dr * dr + dg * dg + db * db));
+}
+
+/**
+ * @brief Colour used to draw a component label, derived from the label itself so that no per-component table is
+ * needed when writing strip by strip.
+ */
+inline void labelColor(uint32_t label, unsigned char* rgb) {
+    uint32_t h = label * 2654435761u;
+    h ^= h >> 15;
+    rgb[0] = static_cast<unsigned char>(h);
+    rgb[1] = static_cast<unsigned char>(h >> 8);
+    rgb[2] = static_cast<unsigned char>(h >> 16);
+}
+
+/**
+ * @brief Out-of-core segmentation for images that do not fit in memory.
+ *
+ * The PPM is processed in strips of full-width rows. Each strip is segmented on its own with flat arrays (edges,
+ * union-find), its components receive global ids in a boundary union-find that keeps only their size and internal
+ * difference, and its provisional labels are appended to the label file. The seam between consecutive strips is
+ * then stitched by running the same merge predicate over the seam edges against the boundary union-find. A second
+ * pass rewrites the label file strip by strip with the final ids and writes the coloured PPM.
+ *
+ * Peak memory is proportional to the strip (width * tileRows pixels) plus 12 bytes per component.
+ *
+ * segmentFrame() applies the same scheme to the frames of a video held in memory. Every strip keeps its
+ * segmentation and the pixels it was computed from; in the next frame a strip is segmented again only if some
+ * channel of some pixel moved by more than the tolerance, while the boundary union-find, the seams and the final
+ * labels are rebuilt from the kept strips every frame.
+ */
+class TiledSegmentation {
+private:
+    struct StripEdge {
+        uint32_t a;
+        uint32_t b;
+        float weight;
+
+        bool operator<(const StripEdge& other) const {
+            return weight < other.weight;
+        }
+    };
+
+    /**
+     * @brief Segmentation of one strip on its own: the component of every pixel, numbered in pixel order, and the
+     * size and internal difference of every component.
+     */
+    struct Strip {
+        std::vector<uint32_t> labels;
+        std::vector<uint32_t> sizes;
+        std::vector<float> internalDifferences;
+        std::vector<unsigned char> pixels;
+    };
+
+    MergeCriterion criterion;
+    double threshold;
+    int minSize;
+    int tileRows;
+
+    ArrayUnionFind local;
+    ArrayUnionFind boundary;
+    std::vector<StripEdge> edges;
+    std::vector<StripEdge> seam;
+    std::vector<Strip> frameStrips;
+    int frameWidth = 0;
+    int frameHeight = 0;
+
+    /**
+     * @brief Applies the merge predicate to a list of edges sorted by weight.
+     */
+    void mergeEdges(ArrayUnionFind& unionFind, const std::vector<StripEdge>& sortedEdges) {
+        for (const StripEdge& edge : sortedEdges) {
+            uint32_t rootA = unionFind.find(edge.a);
+            uint32_t rootB = unionFind.find(edge.b);
+
+            if (rootA != rootB &&
+                shouldMerge(criterion, threshold, edge.weight,
+                            unionFind.getInternalDifference(rootA), unionFind.getSize(rootA),
+                            unionFind.getInternalDifference(rootB), unionFind.getSize(rootB))) {
+                unionFind.unite(rootA, rootB, edge.weight);
+            }
+        }
+    }
+
+    /**
+     * @brief Segments one strip on its own.
+     * @param rgb Interleaved pixels of the strip.
+     * @param width Strip width.
+     * @param rows Strip height.
+     * @param strip Receives the components of the strip (its pixels are left untouched).
+     */
+    void segmentStrip(const unsigned char* rgb, int width, int rows, Strip& strip) {
+        size_t pixels = static_cast<size_t>(width) * rows;
+
+        edges.clear();
+        {
+            TGC_STATS_PHASE("graph_build");
+            for (int y = 0; y < rows; ++y) {
+                for (int x = 0; x < width; ++x) {
+                    uint32_t current = static_cast<uint32_t>(y * width + x);
+                    if (x + 1 < width) {
+                        edges.push_back({current, current + 1,
+                                         rgbDifference(rgb + current * 3, rgb + (current + 1) * 3)});
+                    }
+                    if (y + 1 < rows) {
+                        uint32_t bottom = current + width;
+                        edges.push_back({current, bottom, rgbDifference(rgb + current * 3, rgb + bottom * 3)});
+                    }
+                }
+            }
+        }
+        TGC_STATS_COUNT("edges", edges.size());
+        {
+            TGC_STATS_PHASE("sort");
+            parallel::sharedPool().parallelSort(edges.begin(), edges.end());
+        }
+
+        TGC_STATS_PHASE("merge");
+        local.reset(pixels);
+        mergeEdges(local, edges);
+
+        if (minSize > 1) {
+            for (const StripEdge& edge : edges) {
+                uint32_t rootA = local.find(edge.a);
+                uint32_t rootB = local.find(edge.b);
+                if (rootA != rootB &&
+                    (local.getSize(rootA) < static_cast<uint32_t>(minSize) ||
+                     local.getSize(rootB) < static_cast<uint32_t>(minSize))) {
+                    local.unite(rootA, rootB, edge.weight);
+                }
+            }
+        }
+
+        // components are numbered in the pixel order of their roots' first appearance
+        const uint32_t unassigned = UINT32_MAX;
+        std::vector<uint32_t> componentOf(pixels, unassigned);
+        strip.labels.resize(pixels);
+        strip.sizes.clear();
+        strip.internalDifferences.clear();
+        for (size_t i = 0; i < pixels; ++i) {
+            uint32_t root = local.find(static_cast<uint32_t>(i));
+            if (componentOf[root] == unassigned) {
+                componentOf[root] = static_cast<uint32_t>(strip.sizes.size());
+                strip.sizes.push_back(local.getSize(root));
+                strip.internalDifferences.push_back(local.getInternalDifference(root));
+            }
+            strip.labels[i] = componentOf[root];
+        }
+        TGC_STATS_COUNT("union_find_hops", local.takeFindHops());
+    }
+
+    /**
+     * @brief Appends the components of a strip to the boundary union-find.
+     * @param labels Receives the global id of every pixel of the strip.
      */
-    void saveSegmentationImage(const std::vector<std::vector<int>>& segmentation, 
-                                const std::string& outputPath) {
-        const auto& vertices = graph.getVertices();
-        
-        std::vector<Pixel> outputPixels(width * height);
-        
-        std::vector<Pixel> componentColors;
-        std::srand(std::time(nullptr)); 
-        for (size_t i = 0; i < segmentation.size(); ++i) {
-            componentColors.push_back(std::make_tuple(
-                std::rand() % 256,
-                std::rand() % 256,
-                std::rand() % 256
-            ));
+    void addStrip(const Strip& strip, std::vector<uint32_t>& labels) {
+        uint32_t first = static_cast<uint32_t>(boundary.size());
+        for (size_t c = 0; c < strip.sizes.size(); ++c) {
+            boundary.add(strip.sizes[c], strip.internalDifferences[c]);
         }
-        
-        for (size_t colorIndex = 0; colorIndex < segmentation.size(); ++colorIndex) {
-            for (int pixel : segmentation[colorIndex]) {
-                outputPixels[pixel] = componentColors[colorIndex];
+        labels.resize(strip.labels.size());
+        for (size_t i = 0; i < labels.size(); ++i) {
+            labels[i] = first + strip.labels[i];
+        }
+    }
+
+    /**
+     * @brief Runs the merge predicate over the seam between the last row of a strip and the first row of the next.
+     * @param aboveRgb Interleaved pixels of the last row above the seam; aboveLabels holds their global ids.
+     * @param belowRgb Interleaved pixels of the first row below the seam; belowLabels holds their global ids.
+     */
+    void stitch(const unsigned char* aboveRgb, const uint32_t* aboveLabels, const unsigned char* belowRgb,
+                const uint32_t* belowLabels, int width) {
+        seam.clear();
+        for (int x = 0; x < width; ++x) {
+            seam.push_back({aboveLabels[x], belowLabels[x], rgbDifference(aboveRgb + x * 3, belowRgb + x * 3)});
+        }
+        std::sort(seam.begin(), seam.end());
+        mergeEdges(boundary, seam);
+    }
+
+    /**
+     * @brief Whether any channel of any pixel differs by more than tolerance between two pixel buffers of the same
+     * length.
+     */
+    static bool changedBeyond(const unsigned char* a, const unsigned char* b, size_t length, int tolerance) {
+        int largest = 0;
+        for (size_t i = 0; i < length; ++i) {
+            largest = std::max(largest, std::abs(a[i] - b[i]));
+        }
+        return largest > tolerance;
+    }
+
+public:
+    /**
+     * @param criterion The merge predicate to use.
+     * @param threshold The global threshold (Fixed) or the scale constant k (Adaptive).
+     * @param minSize Minimum component size enforced inside each strip (0 disables it).
+     * @param tileRows Number of image rows per strip.
+     */
+    TiledSegmentation(MergeCriterion criterion, double threshold, int minSize = 0, int tileRows = 256)
+        : criterion(criterion), threshold(threshold), minSize(minSize), tileRows(std::max(1, tileRows)) {}
+
+    /**
+     * @brief Segments a PPM file strip by strip.
+     * @param inputPath The PPM image to segment.
+     * @param labelsPath Output file with one little-endian uint32 label per pixel, in row-major order.
+     * @param outputPath Output PPM with every component drawn in its own colour (empty to skip it).
+     * @return The number of components of the final segmentation.
+     * @throws std::runtime_error If a file cannot be read or written.
+     */
+    size_t segment(const std::string& inputPath, const std::string& labelsPath, const std::string& outputPath) {
+        PPMStripReader reader(inputPath);
+        int width = reader.getWidth();
+        int height = reader.getHeight();
+
+        boundary.reset(0);
+        std::fstream labelFile(labelsPath, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+        if (!labelFile.is_open()) {
+            throw std::runtime_error("Error creating label file.");
+        }
+
+        std::vector<uint32_t> labels;
+        std::vector<unsigned char> previousRow(static_cast<size_t>(width) * 3);
+        std::vector<uint32_t> previousLabels(width);
+        Strip strip;
+
+        for (int y0 = 0; y0 < height; y0 += tileRows) {
+            int rows = std::min(tileRows, height - y0);
+            const unsigned char* rgb;
+            {
+                TGC_STATS_PHASE("read");
+                rgb = reader.readRows(y0, rows);
             }
+
+            segmentStrip(rgb, width, rows, strip);
+            addStrip(strip, labels);
+
+            if (y0 > 0) {
+                stitch(previousRow.data(), previousLabels.data(), rgb, labels.data(), width);
+            }
+
+            const unsigned char* lastRow = rgb + static_cast<size_t>(rows - 1) * width * 3;
+            std::copy(lastRow, lastRow + previousRow.size(), previousRow.begin());
+            std::copy(labels.end() - width, labels.end(), previousLabels.begin());
+
+            labelFile.write(reinterpret_cast<const char*>(labels.data()), labels.size() * sizeof(uint32_t));
         }
-        
-        std::ofstream outputFile(outputPath, std::ios::binary);
-        if (!outputFile.is_open()) {
-            throw std::runtime_error("Error creating output file.");
+
+        // final ids are dense: roots are numbered in order of first appearance
+        TGC_STATS_PHASE("write");
+        const uint32_t unassigned = UINT32_MAX;
+        std::vector<uint32_t> finalId(boundary.size(), unassigned);
+        uint32_t components = 0;
+
+        std::ofstream outputFile;
+        if (!outputPath.empty()) {
+            outputFile.open(outputPath, std::ios::binary);
+            if (!outputFile.is_open()) {
+                throw std::runtime_error("Error creating output file.");
+            }
+            outputFile << "P6\n" << width << " " << height << "\n255\n";
         }
-        
-        outputFile << "P6\n" << width << " " << height << "\n255\n";
-        
-        for (const auto& pixel : outputPixels) {
-            outputFile.put(std::get<0>(pixel));
-            outputFile.put(std::get<1>(pixel));
-            outputFile.put(std::get<2>(pixel));
+
+        std::vector<unsigned char> colors;
+        for (int y0 = 0; y0 < height; y0 += tileRows) {
+            int rows = std::min(tileRows, height - y0);
+            size_t pixels = static_cast<size_t>(rows) * width;
+            std::streamoff offset = static_cast<std::streamoff>(y0) * width * sizeof(uint32_t);
+
+            labels.resize(pixels);
+            labelFile.seekg(offset);
+            labelFile.read(reinterpret_cast<char*>(labels.data()), pixels * sizeof(uint32_t));
+
+            for (uint32_t& label : labels) {
+                uint32_t root = boundary.find(label);
+                if (finalId[root] == unassigned) {
+                    finalId[root] = components++;
+                }
+                label = finalId[root];
+            }
+
+            labelFile.seekp(offset);
+            labelFile.write(reinterpret_cast<const char*>(labels.data()), pixels * sizeof(uint32_t));
+
+            if (outputFile.is_open()) {
+                colors.resize(pixels * 3);
+                for (size_t i = 0; i < pixels; ++i) {
+                    labelColor(labels[i], colors.data() + i * 3);
+                }
+                outputFile.write(reinterpret_cast<const char*>(colors.data()), colors.size());
+            }
         }
-        
-        outputFile.close();
+
+        if (!labelFile) {
+            throw std::runtime_error("Error writing label file.");
+        }
+        TGC_STATS_COUNT("union_find_hops", boundary.takeFindHops());
+        TGC_STATS_COUNT("components", components);
+        return components;
     }
-    
+
     /**
-     * @brief Prints the segmentation results, including the number of components and the size of each component.
-     * @param segmentation The segmentation result containing components of pixel indices.
+     * @brief Segments one frame of a sequence, reusing the strips of the previous frames that did not change.
+     * With tolerance 0 the result is the one segment() gives for the same image; a larger tolerance keeps strips
+     * whose pixels moved only by noise, at the price of using their older segmentation.
+     * @param rgb Interleaved pixels of the frame.
+     * @param width Frame width; a frame of another size discards the kept strips.
+     * @param height Frame height.
+     * @param tolerance Largest per-channel change, in grey levels, for which a strip is reused.
+     * @param labels Receives one dense label per pixel, numbered in order of first appearance.
+     * @param stripsSegmented If not null, receives the number of strips segmented again for this frame.
+     * @return The number of components of the frame.
      */
-    void printSegmentation(const std::vector<std::vector<int>>& segmentation) {
-        std::cout << "Segmentation Results:\n";
-        std::cout << "Number of Components: " << segmentation.size() << "\n";
-        for (size_t i = 0; i < segmentation.size(); ++i) {
-            std::cout << "Component " << i + 1 << ": " 
-                      << segmentation[i].size() << " pixels\n";
+    size_t segmentFrame(const unsigned char* rgb, int width, int height, int tolerance,
+                        std::vector<uint32_t>& labels, size_t* stripsSegmented = nullptr) {
+        if (width != frameWidth || height != frameHeight) {
+            frameStrips.assign((height + tileRows - 1) / tileRows, Strip());
+            frameWidth = width;
+            frameHeight = height;
+        }
+
+        size_t rowBytes = static_cast<size_t>(width) * 3;
+        std::vector<size_t> stale;
+        for (size_t s = 0; s < frameStrips.size(); ++s) {
+            int rows = std::min(tileRows, height - static_cast<int>(s) * tileRows);
+            const unsigned char* stripRgb = rgb + s * tileRows * rowBytes;
+            const Strip& strip = frameStrips[s];
+            if (strip.pixels.empty() || changedBeyond(stripRgb, strip.pixels.data(), rows * rowBytes, tolerance)) {
+                stale.push_back(s);
+            }
+        }
+
+        for (size_t s : stale) {
+            int rows = std::min(tileRows, height - static_cast<int>(s) * tileRows);
+            const unsigned char* stripRgb = rgb + s * tileRows * rowBytes;
+            segmentStrip(stripRgb, width, rows, frameStrips[s]);
+            frameStrips[s].pixels.assign(stripRgb, stripRgb + rows * rowBytes);
+        }
+
+        TGC_STATS_PHASE("merge");
+        boundary.reset(0);
+        labels.resize(static_cast<size_t>(width) * height);
+        std::vector<uint32_t> stripLabels;
+        for (size_t s = 0; s < frameStrips.size(); ++s) {
+            size_t offset = s * tileRows * static_cast<size_t>(width);
+            addStrip(frameStrips[s], stripLabels);
+            std::copy(stripLabels.begin(), stripLabels.end(), labels.begin() + offset);
+            if (s > 0) {
+                stitch(rgb + (offset - width) * 3, &labels[offset - width], rgb + offset * 3, &labels[offset], width);
+            }
+        }
+
+        const uint32_t unassigned = UINT32_MAX;
+        std::vector<uint32_t> finalId(boundary.size(), unassigned);
+        uint32_t components = 0;
+        for (uint32_t& label : labels) {
+            uint32_t root = boundary.find(label);
+            if (finalId[root] == unassigned) {
+                finalId[root] = components++;
+            }
+            label = finalId[root];
         }
+        TGC_STATS_COUNT("union_find_hops", boundary.takeFindHops());
+        TGC_STATS_COUNT("strips_segmented", stale.size());
+        TGC_STATS_COUNT("components", components);
+        if (stripsSegmented != nullptr) *stripsSegmented = stale.size();
+        return components;
     }
 };
 
-int main() {
-    try {
-        std::string inputPath = "imagem.ppm";
+/**
+ * @brief Bump when a change alters the labels the segmentation produces, so that old cache entries stop matching.
+ */
+const char* const CACHE_VERSION = "ImageSegmentation/1";
+
+/**
+ * @brief Starts a cache key with the pixels the segmentation sees (after smoothing) and the program version.
+ * Copies of the returned hasher take the parameters of each run.
+ */
+cache::Hasher hashPixels(const std::vector<Pixel>& pixels, int width, int height) {
+    cache::Hasher hasher;
+    hasher.add(CACHE_VERSION).add(width).add(height);
+    unsigned char chunk[3 * 1024];
+    for (size_t i = 0; i < pixels.size();) {
+        size_t count = std::min<size_t>(1024, pixels.size() - i);
+        for (size_t j = 0; j < count; ++j, ++i) {
+            chunk[3 * j] = static_cast<unsigned char>(std::get<0>(pixels[i]));
+            chunk[3 * j + 1] = static_cast<unsigned char>(std::get<1>(pixels[i]));
+            chunk[3 * j + 2] = static_cast<unsigned char>(std::get<2>(pixels[i]));
+        }
+        hasher.update(chunk, 3 * count);
+    }
+    return hasher;
+}
+
+/**
+ * @brief Cache key of one segmentation run.
+ * @param image Hasher returned by hashPixels.
+ * @param policies Distance and neighbourhood policy names and the slice count, e.g. "l2;4;1".
+ */
+uint64_t segmentationKey(const cache::Hasher& image, const std::string& policies, MergeCriterion criterion,
+                         double threshold, int minSize) {
+    cache::Hasher hasher = image;
+    hasher.add(policies).add(static_cast<int>(criterion)).add(threshold).add(minSize);
+    return hasher.digest();
+}
+
+/**
+ * @brief Looks a segmentation up in the cache (if there is one).
+ * @param pixels The pixels the segmentation saw, for the component stats.
+ */
+std::optional<SegmentationResult> findCached(const cache::ResultCache* results, uint64_t key, int width,
+                                             const std::vector<Pixel>& pixels) {
+    if (results == nullptr) return std::nullopt;
+    TGC_STATS_PHASE("cache");
+    std::optional<cache::Labels> hit = results->find(key);
+    if (!hit || hit->size() != pixels.size()) return std::nullopt;
+    TGC_STATS_COUNT("cache_hits", 1);
+    std::vector<uint32_t> labels;
+    hit->copyTo(labels);
+    return summarizeLabels(std::move(labels), hit->labelCount(), width, pixels);
+}
+
+/**
+ * @brief Stores the labels of a segmentation in the cache (if there is one).
+ */
+void storeCached(const cache::ResultCache* results, uint64_t key, int width, int height,
+                 const SegmentationResult& segmentation) {
+    if (results == nullptr) return;
+    TGC_STATS_PHASE("cache");
+    results->store(key, width, height, segmentation.labels.data());
+}
+
+/**
+ * @brief One image travelling through the batch pipeline.
+ */
+struct BatchJob {
+    std::string inputPath;
+    int width = 0;
+    int height = 0;
+    std::vector<Pixel> pixels;
+    std::unique_ptr<arena::Arena> memory;
+    std::optional<Grafo> graph;
+    SegmentationResult segmentation;
+    uint64_t cacheKey = 0;
+    bool cached = false;
+};
+
+/**
+ * @brief Batch mode ("--batch outputDir input..."): segments every image given (PNG, JPEG or PPM files, or
+ * directories of them) through a bounded pipeline of read -> smoothing and graph build -> segment -> write stages.
+ * Each stage has its own threads and passes images on through queues of two slots, so reading image N+1 overlaps
+ * segmenting image N while at most a few images are in memory at once. Each job's graph lives in an arena that goes
+ * back to a shelf once the image is written, so later images reuse the memory of earlier ones instead of going
+ * through malloc node by node. With a result cache, images already segmented skip the graph and the segmentation.
+ */
+int runBatch(int argc, char* argv[], const std::string& extension, const cache::ResultCache* results) {
+    if (argc < 4) {
+        std::cerr << "Usage: " << argv[0] << " --batch <outputDir> <image|dir>... [--format png|ppm]\n";
+        return 1;
+    }
+    std::string outputDir = argv[2];
+    std::vector<std::string> inputs =
+        pipeline::collectInputs(std::vector<std::string>(argv + 3, argv + argc), imageio::inputExtensions());
+
+    const double k = 300;
+    const int minSize = 50;
+    const double sigma = 0.8;
+    const size_t queueSlots = 2;
+    int segmentWorkers = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 3);
+
+    using Job = std::unique_ptr<BatchJob>;
+    pipeline::BoundedQueue<std::string> paths(inputs.size() + 1);
+    pipeline::BoundedQueue<Job> loaded(queueSlots), built(queueSlots), segmented(queueSlots);
+
+    std::mutex outputMutex;
+    std::atomic<int> failures(0);
+    auto onError = [&](const std::string& message) {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        std::cerr << "Error: " << message << std::endl;
+        failures++;
+    };
+
+    std::mutex shelfMutex;
+    std::vector<std::unique_ptr<arena::Arena>> shelf;
+    auto takeArena = [&]() {
+        std::lock_guard<std::mutex> lock(shelfMutex);
+        if (shelf.empty()) return std::unique_ptr<arena::Arena>(new arena::Arena(1 << 20));
+        std::unique_ptr<arena::Arena> memory = std::move(shelf.back());
+        shelf.pop_back();
+        return memory;
+    };
+
+    std::vector<std::vector<std::thread>> stages;
+    stages.push_back(pipeline::startStage(1, paths, loaded, [](std::string path) {
+        Job job(new BatchJob());
+        int maxVal;
+        std::tie(job->width, job->height, maxVal, job->pixels) = readImage(path);
+        job->inputPath = path;
+        return job;
+    }, onError));
+    stages.push_back(pipeline::startStage(1, loaded, built, [&](Job job) {
+        smoothPixels(job->pixels, job->width, job->height, sigma);
+        if (results != nullptr) {
+            job->cacheKey = segmentationKey(hashPixels(job->pixels, job->width, job->height),
+                                            "l2;4;1", MergeCriterion::Adaptive, k, minSize);
+            if (std::optional<SegmentationResult> hit = findCached(results, job->cacheKey, job->width, job->pixels)) {
+                job->segmentation = std::move(*hit);
+                job->cached = true;
+                return job;
+            }
+        }
+        job->memory = takeArena();
+        job->graph.emplace(createGraphFromPPM(job->width, job->height, job->pixels, job->memory->resource()));
+        return job;
+    }, onError));
+    stages.push_back(pipeline::startStage(segmentWorkers, built, segmented, [&](Job job) {
+        if (job->cached) return job;
+        static thread_local arena::Arena segmentScratch;
+        ImageSegmentation segmentator(*job->graph, job->width, job->height, &segmentScratch);
+        job->segmentation = segmentator.segment(k, MergeCriterion::Adaptive, minSize);
+        storeCached(results, job->cacheKey, job->width, job->height, job->segmentation);
+        return job;
+    }, onError));
+    stages.push_back(pipeline::startSink(1, segmented, [&](Job job) {
+        std::string outputPath = pipeline::outputPathFor(outputDir, job->inputPath, "_segmented" + extension);
+        writeSegmentationImage(job->segmentation, job->width, job->height, outputPath);
+
+        if (job->memory) {
+            job->graph.reset();
+            job->memory->reset();
+            std::lock_guard<std::mutex> lock(shelfMutex);
+            shelf.push_back(std::move(job->memory));
+        }
+
+        std::lock_guard<std::mutex> lock(outputMutex);
+        std::cout << job->inputPath << " -> " << outputPath << " (" << job->segmentation.size()
+                  << " components" << (job->cached ? ", cached" : "") << ")\n";
+    }, onError));
+
+    for (const std::string& input : inputs) {
+        paths.push(input);
+    }
+    paths.close();
+    pipeline::joinAll(stages);
+
+    return failures == 0 ? 0 : 1;
+}
+
+/**
+ * @brief Bench rows for one pair of policies: graph build and Fixed segmentation, with the policies named in the
+ * case column.
+ * @param threshold Fixed threshold on the L2 scale, converted with Distance::fromL2.
+ */
+template <typename Distance, typename Neighbourhood>
+void benchmarkPolicies(const std::string& policies, long side, const std::vector<Pixel>& image, double threshold) {
+    using Segmentation = ImageSegmentation<Distance, Neighbourhood>;
+    int width = static_cast<int>(side), height = static_cast<int>(side);
+    arena::Arena graphMemory, scratch;
+
+    std::optional<Grafo> graph;
+    double seconds = bench::measure([&]() {
+        graph.emplace(Segmentation::buildGraph(width, height, image, graphMemory.resource()));
+    });
+    bench::csvRow("ImageSegmentation", "graph(" + policies + ")", side, seconds, side * side);
+
+    Segmentation segmentator(*graph, width, height, &scratch);
+    SegmentationResult segmentation;
+    seconds = bench::measure([&]() { segmentation = segmentator.segment(Distance::fromL2(threshold)); });
+    bench::csvRow("ImageSegmentation",
+                  "segment(fixed;" + policies + ";components=" + std::to_string(segmentation.size()) + ")",
+                  side, seconds, side * side);
+}
+
+/**
+ * @brief Benchmark mode ("--bench [side...]"): segments synthetic side x side
+ * PPMs and prints one CSV row per phase (read, graph build, segment, merge tree build and cut, write). Reading and
+ * writing are measured as PPM and as PNG.
+ * Segmentation is measured with both merge criteria; the case column carries the component count. Graph build and
+ * Fixed segmentation are then repeated with other distance and neighbourhood policies, and on the image after
+ * Gaussian pre-smoothing. Then come the mean time per frame of an 8-frame sequence in which a square moves 2 pixels
+ * per frame, with every strip segmented again and with only the changed strips. Last, the luma >= 128 mask is
+ * labelled sequentially and with ConcurrentUnionFind on pools of 1 to 32 threads.
+ * @param sides Image sides of the sweep.
+ */
+void benchmark(const std::vector<long>& sides) {
+    const std::string inputPath = "bench_input.ppm";
+    const std::string outputPath = "bench_output.ppm";
+    const std::string pngInputPath = "bench_input.png";
+    const std::string pngOutputPath = "bench_output.png";
+    const double threshold = 15;
+    const double scale = 300;
+    const int minSize = 50;
+
+    arena::Arena graphMemory, scratch;
+
+    bench::csvHeader();
+    for (long side : sides) {
+        bench::writeSyntheticPPM(inputPath, side, side, static_cast<unsigned>(side));
+        long pixels = side * side;
+
         int width, height, maxVal;
-        std::vector<Pixel> pixels;
+        std::vector<Pixel> image;
+        double seconds = bench::measure([&]() {
+            std::tie(width, height, maxVal, image) = readPPM(inputPath);
+        });
+        bench::csvRow("ImageSegmentation", "read", side, seconds, pixels);
 
-        std::tie(width, height, maxVal, pixels) = readPPM(inputPath);
+        imageio::Image raw = imageio::read(inputPath);
+        imageio::write(pngInputPath, raw.width, raw.height, raw.rgb.data());
+        std::vector<Pixel> decoded;
+        seconds = bench::measure([&]() { std::tie(width, height, maxVal, decoded) = readImage(pngInputPath); });
+        bench::csvRow("ImageSegmentation", "read/png", side, seconds, pixels);
 
-        Grafo graph = createGraphFromPPM(width, height, pixels);
+        graphMemory.reset();
+        std::optional<Grafo> graph;
+        seconds = bench::measure([&]() {
+            graph.emplace(createGraphFromPPM(width, height, image, graphMemory.resource()));
+        });
+        bench::csvRow("ImageSegmentation", "graph", side, seconds, pixels);
+
+        ImageSegmentation segmentator(*graph, width, height, &scratch);
+        SegmentationResult segmentation;
+        seconds = bench::measure([&]() { segmentation = segmentator.segment(threshold); });
+        bench::csvRow("ImageSegmentation", "segment(fixed;components=" + std::to_string(segmentation.size()) + ")",
+                      side, seconds, pixels);
+
+        SegmentationResult adaptive;
+        seconds = bench::measure([&]() {
+            adaptive = segmentator.segment(scale, MergeCriterion::Adaptive, minSize);
+        });
+        bench::csvRow("ImageSegmentation", "segment(adaptive;components=" + std::to_string(adaptive.size()) + ")",
+                      side, seconds, pixels);
+
+        MergeTree tree;
+        seconds = bench::measure([&]() { tree = segmentator.buildMergeTree(); });
+        bench::csvRow("ImageSegmentation", "merge_tree", side, seconds, pixels);
+
+        std::vector<uint32_t> labels;
+        size_t cutComponents = 0;
+        seconds = bench::measure([&]() { cutComponents = tree.cutAtThreshold(threshold, labels); });
+        bench::csvRow("ImageSegmentation", "tree_cut(fixed;components=" + std::to_string(cutComponents) + ")",
+                      side, seconds, pixels);
+
+        seconds = bench::measure([&]() { segmentator.saveSegmentationImage(segmentation, outputPath); });
+        bench::csvRow("ImageSegmentation", "write", side, seconds, pixels);
+
+        seconds = bench::measure([&]() { segmentator.saveSegmentationImage(segmentation, pngOutputPath); });
+        bench::csvRow("ImageSegmentation", "write/png", side, seconds, pixels);
+
+        graph.reset();
+        benchmarkPolicies<L1Distance, FourNeighbourhood>("l1;4conn", side, image, threshold);
+        benchmarkPolicies<SquaredL2Distance, FourNeighbourhood>("l2sq;4conn", side, image, threshold);
+        benchmarkPolicies<GrayDistance, FourNeighbourhood>("gray;4conn", side, image, threshold);
+        benchmarkPolicies<L2Distance, EightNeighbourhood>("l2;8conn", side, image, threshold);
+
+        std::vector<Pixel> smoothed;
+        seconds = bench::measure([&]() {
+            smoothed = image;
+            smoothPixels(smoothed, width, height, 0.8);
+        });
+        bench::csvRow("ImageSegmentation", "smooth(sigma=0.8)", side, seconds, pixels);
+        benchmarkPolicies<L2Distance, FourNeighbourhood>("l2;4conn;smoothed", side, smoothed, threshold);
+
+        const int frames = 8;
+        std::vector<std::vector<unsigned char>> sequence(frames, std::vector<unsigned char>(pixels * 3));
+        for (int f = 0; f < frames; ++f) {
+            for (long i = 0; i < pixels; ++i) {
+                long x = i % side, y = i / side;
+                bool square = y >= side / 4 && y < side / 2 && x >= side / 4 + 2 * f && x < side / 2 + 2 * f;
+                sequence[f][i * 3] = static_cast<unsigned char>(square ? 230 : std::get<0>(image[i]));
+                sequence[f][i * 3 + 1] = static_cast<unsigned char>(square ? 230 : std::get<1>(image[i]));
+                sequence[f][i * 3 + 2] = static_cast<unsigned char>(square ? 230 : std::get<2>(image[i]));
+            }
+        }
+        std::vector<uint32_t> frameLabels;
+        seconds = bench::measure([&]() {
+            for (int f = 0; f < frames; ++f) {
+                TiledSegmentation fresh(MergeCriterion::Adaptive, scale, minSize, 32);
+                fresh.segmentFrame(sequence[f].data(), width, height, 0, frameLabels);
+            }
+        });
+        bench::csvRow("ImageSegmentation", "sequence(all strips)", side, seconds / frames, pixels);
+
+        seconds = bench::measure([&]() {
+            TiledSegmentation incremental(MergeCriterion::Adaptive, scale, minSize, 32);
+            for (int f = 0; f < frames; ++f) {
+                incremental.segmentFrame(sequence[f].data(), width, height, 0, frameLabels);
+            }
+        });
+        bench::csvRow("ImageSegmentation", "sequence(changed strips)", side, seconds / frames, pixels);
+
+        std::vector<unsigned char> mask = thresholdLuma(image, 128);
+        std::vector<uint32_t> componentLabels;
+        uint32_t components = 0;
+        seconds = bench::measure([&]() { components = labelComponents(mask, width, height, componentLabels); });
+        bench::csvRow("ImageSegmentation", "components(sequential;components=" + std::to_string(components) + ")",
+                      side, seconds, pixels);
+        for (size_t threads : {1, 2, 4, 8, 16, 32}) {
+            parallel::ThreadPool pool(std::max<size_t>(1, threads - 1));
+            seconds = bench::measure([&]() {
+                components = labelComponentsParallel(mask, width, height, componentLabels, pool, threads);
+            });
+            bench::csvRow("ImageSegmentation", "components(parallel;threads=" + std::to_string(threads) + ")",
+                          side, seconds, pixels);
+        }
+    }
+    std::remove(inputPath.c_str());
+    std::remove(outputPath.c_str());
+    std::remove(pngInputPath.c_str());
+    std::remove(pngOutputPath.c_str());
+}
+
+/**
+ * @brief Merge tree mode ("--tree input output threshold" or "--tree input output --components n"):
+ * cuts the Fixed-criterion segmentation from the merge tree index stored next to the image (input.mtree). The
+ * index is built by the first query and rebuilt when the image is newer than it; later queries only read it and cut
+ * the tree. The output is a PNG unless its name ends in ".ppm".
+ */
+int runTree(int argc, char* argv[]) {
+    if (argc < 5 || (std::string(argv[4]) == "--components" && argc < 6)) {
+        std::cerr << "Usage: " << argv[0] << " --tree <input> <output.png|ppm> (<threshold> | --components <n>)\n";
+        return 1;
+    }
+    std::string inputPath = argv[2];
+    std::string outputPath = argv[3];
+    std::string indexPath = inputPath + ".mtree";
 
+    MergeTree tree;
+    if (std::filesystem::exists(indexPath)
+        && std::filesystem::last_write_time(indexPath) >= std::filesystem::last_write_time(inputPath)) {
+        tree = MergeTree::load(indexPath);
+    } else {
+        int width, height, maxVal;
+        std::vector<Pixel> pixels;
+        std::tie(width, height, maxVal, pixels) = readImage(inputPath);
+        Grafo graph = createGraphFromPPM(width, height, pixels);
         ImageSegmentation segmentator(graph, width, height);
+        tree = segmentator.buildMergeTree();
+        tree.save(indexPath);
+    }
+
+    std::vector<uint32_t> labels;
+    size_t components = std::string(argv[4]) == "--components"
+        ? tree.cutToComponents(std::stoul(argv[5]), labels)
+        : tree.cutAtThreshold(std::stod(argv[4]), labels);
+
+    std::vector<unsigned char> colors(labels.size() * 3);
+    for (size_t i = 0; i < labels.size(); ++i) {
+        labelColor(labels[i], colors.data() + i * 3);
+    }
+    imageio::write(outputPath, tree.getWidth(), tree.getHeight(), colors.data());
+
+    std::cout << "Number of Components: " << components << "\n";
+    return 0;
+}
+
+/**
+ * @brief Tiled mode ("--tiled input.ppm output.ppm [k] [tileRows]"): adaptive segmentation of an image of any size
+ * with memory bounded by the strip height. Writes the coloured segmentation and output.ppm.labels (uint32 per pixel).
+ */
+int runTiled(int argc, char* argv[]) {
+    if (argc < 4) {
+        std::cerr << "Usage: " << argv[0] << " --tiled <input.ppm> <output.ppm> [k] [tileRows]\n";
+        return 1;
+    }
+    std::string inputPath = argv[2];
+    std::string outputPath = argv[3];
+    double k = argc > 4 ? std::stod(argv[4]) : 300;
+    int tileRows = argc > 5 ? std::stoi(argv[5]) : 256;
+
+    TiledSegmentation segmentator(MergeCriterion::Adaptive, k, 50, tileRows);
+    size_t components = segmentator.segment(inputPath, outputPath + ".labels", outputPath);
+    std::cout << "Number of Components: " << components << "\n";
+    return 0;
+}
+
+/**
+ * @brief Sequence mode ("--sequence outputDir frame|dir... [--k k] [--tolerance t] [--tile-rows n]"):
+ * adaptive segmentation of the numbered frames of a video (directories are read in name order). Frames are cut
+ * into strips of tileRows rows (default 32) and a strip is segmented again only when some pixel changed by more than
+ * the tolerance (default 0, which gives the same labels as segmenting every frame from scratch); the seams are
+ * stitched every frame. Prints one CSV row per frame with the latency of each step in milliseconds.
+ */
+int runSequence(int argc, char* argv[], const std::string& extension) {
+    double k = 300;
+    int tolerance = 0;
+    int tileRows = 32;
+    std::vector<std::string> arguments;
+    for (int i = 2; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (argument == "--k" && i + 1 < argc) {
+            k = std::stod(argv[++i]);
+        } else if (argument == "--tolerance" && i + 1 < argc) {
+            tolerance = std::stoi(argv[++i]);
+        } else if (argument == "--tile-rows" && i + 1 < argc) {
+            tileRows = std::stoi(argv[++i]);
+        } else {
+            arguments.push_back(argument);
+        }
+    }
+    if (arguments.size() < 2) {
+        std::cerr << "Usage: " << argv[0] << " --sequence <outputDir> <frame|dir>... [--k k] [--tolerance t]"
+                  << " [--tile-rows n] [--format png|ppm]\n";
+        return 1;
+    }
+    std::string outputDir = arguments[0];
+    std::vector<std::string> frames =
+        pipeline::collectInputs(std::vector<std::string>(arguments.begin() + 1, arguments.end()),
+                                imageio::inputExtensions());
+
+    TiledSegmentation segmentator(MergeCriterion::Adaptive, k, 50, tileRows);
+    std::vector<unsigned char> rgb;
+    std::vector<uint32_t> labels;
+    std::vector<unsigned char> colors;
+    std::cout << "frame,input,read_ms,segment_ms,write_ms,strips_segmented,components\n";
+    for (size_t i = 0; i < frames.size(); ++i) {
+        int width = 0, height = 0;
+        double readSeconds = bench::measure([&]() {
+            TGC_STATS_PHASE("read");
+            imageio::Image image = imageio::read(frames[i]);
+            width = image.width;
+            height = image.height;
+            rgb = std::move(image.rgb);
+        });
+
+        size_t components = 0, stripsSegmented = 0;
+        double segmentSeconds = bench::measure([&]() {
+            components = segmentator.segmentFrame(rgb.data(), width, height, tolerance, labels, &stripsSegmented);
+        });
+
+        std::string outputPath = pipeline::outputPathFor(outputDir, frames[i], "_segmented" + extension);
+        double writeSeconds = bench::measure([&]() {
+            TGC_STATS_PHASE("write");
+            colors.resize(labels.size() * 3);
+            for (size_t p = 0; p < labels.size(); ++p) {
+                labelColor(labels[p], colors.data() + p * 3);
+            }
+            imageio::write(outputPath, width, height, colors.data());
+        });
+
+        std::cout << i << "," << frames[i] << "," << readSeconds * 1000 << "," << segmentSeconds * 1000 << ","
+                  << writeSeconds * 1000 << "," << stripsSegmented << "," << components << std::endl;
+    }
+    return 0;
+}
+
+/**
+ * @brief Default mode: segments the input image (imagem.ppm unless --input is given) with fixed thresholds and with
+ * the adaptive criterion, writing every result to ./segments. Thresholds and k are given on the L2 scale and
+ * converted with Distance::fromL2; output names keep the L2 values. For SquaredL2Distance the adaptive k only
+ * approximates the L2 behaviour, since k / |C| does not square along with the weights.
+ * @tparam Distance The distance policy of the graph.
+ * @tparam Neighbourhood The neighbourhood policy of the graph.
+ * @param inputPath The PNG, JPEG or PPM image to segment.
+ * @param extension Extension of the output images (".png" or ".ppm").
+ * @param slices Number of slices stacked vertically in the image (a volume, for SixNeighbourhood).
+ * @param sigma Gaussian pre-smoothing applied before the graph is built (0 disables it).
+ * @param results Cache of earlier runs, or nullptr. The graph is only built if some run misses it.
+ */
+template <typename Distance, typename Neighbourhood>
+int segmentImageFile(const std::string& inputPath, const std::string& extension, int slices, double sigma,
+                     const cache::ResultCache* results) {
+    int width, height, maxVal;
+    std::vector<Pixel> pixels;
+
+    std::tie(width, height, maxVal, pixels) = readImage(inputPath);
+
+    if (height % slices != 0) {
+        throw std::runtime_error("Image height is not a multiple of the number of slices.");
+    }
+    smoothPixels(pixels, width, height, sigma, slices);
+    using Segmentation = ImageSegmentation<Distance, Neighbourhood>;
+    std::optional<Grafo> graph;
+    std::optional<Segmentation> segmentator;
+
+    cache::Hasher image;
+    if (results != nullptr) image = hashPixels(pixels, width, height);
+    std::string policies = std::string(Distance::name) + ";" + Neighbourhood::name + ";" + std::to_string(slices);
+
+    auto run = [&](double threshold, MergeCriterion criterion, int minSize) {
+        uint64_t key = results != nullptr ? segmentationKey(image, policies, criterion, threshold, minSize) : 0;
+        if (std::optional<SegmentationResult> hit = findCached(results, key, width, pixels)) {
+            return std::move(*hit);
+        }
+        if (!segmentator) {
+            graph.emplace(Segmentation::buildGraph(width, height / slices, pixels));
+            segmentator.emplace(*graph, width, height);
+        }
+        SegmentationResult segmentation = segmentator->segment(threshold, criterion, minSize);
+        storeCached(results, key, width, height, segmentation);
+        return segmentation;
+    };
 
-        double thresholds[] = {10, 15, 20};
+    double thresholds[] = {10, 15, 20};
+    
+    for (double threshold : thresholds) {
+        std::cout << "\nSegmentation with Threshold: " << threshold << "\n";
         
-        for (double threshold : thresholds) {
-            std::cout << "\nSegmentation with Threshold: " << threshold << "\n";
-            
-            auto segmentation = segmentator.segment(threshold);
-            
-            segmentator.printSegmentation(segmentation);
-            
-            std::string outputPath = "./segments/segmentation_" 
-                                     + std::to_string(threshold) + ".ppm";
-            segmentator.saveSegmentationImage(segmentation, outputPath);
-        }
-    } 
-    catch (const std::exception& e) {
+        auto segmentation = run(Distance::fromL2(threshold), MergeCriterion::Fixed, 0);
+        
+        printSegmentation(segmentation);
+        
+        std::string outputPath = "./segments/segmentation_" 
+                                 + std::to_string(threshold) + extension;
+        writeSegmentationImage(segmentation, width, height, outputPath);
+    }
+
+    double scales[] = {300};
+    const int minSize = 50;
+
+    for (double k : scales) {
+        std::cout << "\nAdaptive segmentation with k: " << k << ", min size: " << minSize << "\n";
+
+        auto segmentation = run(Distance::fromL2(k), MergeCriterion::Adaptive, minSize);
+
+        printSegmentation(segmentation);
+
+        std::string outputPath = "./segments/segmentation_adaptive_"
+                                 + std::to_string(k) + extension;
+        writeSegmentationImage(segmentation, width, height, outputPath);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Picks the neighbourhood policy for segmentImageFile (4, 8 or 6 for a volume of slices).
+ */
+template <typename Distance>
+int segmentImageFile(const std::string& inputPath, const std::string& extension, int connectivity, int slices,
+                     double sigma, const cache::ResultCache* results) {
+    if (connectivity == 8) {
+        return segmentImageFile<Distance, EightNeighbourhood>(inputPath, extension, slices, sigma, results);
+    }
+    if (connectivity == 6) {
+        return segmentImageFile<Distance, SixNeighbourhood>(inputPath, extension, slices, sigma, results);
+    }
+    return segmentImageFile<Distance, FourNeighbourhood>(inputPath, extension, slices, sigma, results);
+}
+
+int main(int argc, char* argv[]) {
+    stats::Report report("ImageSegmentation");
+    if (stats::takeFlag(argc, argv, "--stats")) {
+        report.request();
+    }
+    std::string extension;
+    std::unique_ptr<cache::ResultCache> results;
+    try {
+        extension = imageio::takeFormat(argc, argv);
+        results = cache::takeOptions(argc, argv);
+    } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
         return 1;
     }
 
-    return 0;
-}
\ No newline at end of file
+    if (argc > 1 && std::string(argv[1]) == "--bench") {
+        benchmark(bench::sweepFromArgs(argc, argv, {64, 128, 256, 512}));
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--batch") {
+        return runBatch(argc, argv, extension, results.get());
+    }
+    if (argc > 1 && std::string(argv[1]) == "--tiled") {
+        try {
+            return runTiled(argc, argv);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    if (argc > 1 && std::string(argv[1]) == "--tree") {
+        try {
+            return runTree(argc, argv);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    if (argc > 1 && std::string(argv[1]) == "--sequence") {
+        try {
+            return runSequence(argc, argv, extension);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    std::string inputPath = "imagem.ppm";
+    std::string metric = "l2";
+    int connectivity = 4;
+    int slices = 1;
+    double sigma = 0.8;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        if (option == "--input") {
+            inputPath = argv[i + 1];
+        } else if (option == "--metric") {
+            metric = argv[i + 1];
+        } else if (option == "--connectivity") {
+            connectivity = std::atoi(argv[i + 1]);
+        } else if (option == "--slices") {
+            slices = std::max(1, std::atoi(argv[i + 1]));
+        } else if (option == "--sigma") {
+            sigma = std::atof(argv[i + 1]);
+        }
+    }
+
+    try {
+        if (metric == "l1") {
+            return segmentImageFile<L1Distance>(inputPath, extension, connectivity, slices, sigma, results.get());
+        }
+        if (metric == "l2sq") {
+            return segmentImageFile<SquaredL2Distance>(inputPath, extension, connectivity, slices, sigma,
+                                                      results.get());
+        }
+        if (metric == "gray") {
+            return segmentImageFile<GrayDistance>(inputPath, extension, connectivity, slices, sigma, results.get());
+        }
+        return segmentImageFile<L2Distance>(inputPath, extension, connectivity, slices, sigma, results.get());
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -10,6 +10,26 @@
 #include <ctime>
 #include <queue>
 #include <limits>
+#include <cstdio>
+#include <cstdint>
+#include "../../common/benchmark.h"
+#include "../../common/pipeline.h"
+#include "../../common/threadpool.h"
+#include "../../common/stats.h"
+#include "../../common/imageio.h"
+#include "../../common/cache.h"
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <filesystem>
+#include <optional>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 /**
  * @brief Representa um pixel com componentes de cores RGB.
@@ -29,389 +49,2391 @@ struct Pixel {
 };
 
 /**
- * @brief Implementa um grafo para análise de fluxo com suporte ao algoritmo de Ford-Fulkerson e segmentação de imagem.
+ * @brief Faixas de intensidade que definem as arestas terminais para um par de limiares.
+ * 
+ * A intensidade (r + g + b) / 3 é comparada aos limiares pela soma inteira r + g + b: foregroundMin é a menor soma
+ * com intensidade >= limiar de primeiro plano e backgroundMax a maior soma com intensidade <= limiar de fundo. As
+ * 766 somas possíveis são testadas com a mesma expressão em double, então a classificação é idêntica à comparação
+ * direta.
+ */
+struct IntensityCutoffs {
+    int foregroundMin;
+    int backgroundMax;
+
+    IntensityCutoffs(double foregroundThreshold, double backgroundThreshold) : foregroundMin(766), backgroundMax(-1) {
+        for (int sum = 765; sum >= 0 && sum / 3.0 >= foregroundThreshold; --sum) foregroundMin = sum;
+        for (int sum = 0; sum <= 765 && sum / 3.0 <= backgroundThreshold; ++sum) backgroundMax = sum;
+    }
+
+    int source(int sum) const {
+        return 1000 * (sum >= foregroundMin);
+    }
+
+    int sink(int sum) const {
+        return 1000 * ((sum <= backgroundMax) & (sum < foregroundMin));
+    }
+};
+
+/**
+ * @brief Atributos dos pixels em planos separados (um vetor por canal e um com a soma r + g + b), calculados uma
+ * vez por imagem.
  * 
- * @param V Número de vértices no grafo.
- * @param graph Matriz de adjacência representando o grafo original.
- * @param residualGraph Matriz de adjacência representando a capacidade residual.
- * @param vertices Vetor de vértices com informações associadas (pixels).
+ * As capacidades são geradas daqui por laços sem desvios sobre vetores contíguos, que o compilador vetoriza. A raiz
+ * quadrada da diferença de cor vira consulta a uma tabela indexada pela distância ao quadrado: acima de 100 ao
+ * quadrado a capacidade é sempre zero, então a tabela tem só 10001 entradas.
+ * 
+ * Também servem para volumes: as fatias ficam uma após a outra, e a "linha" y de horizontalCapacities e
+ * verticalCapacities é então z * altura + y.
+ * 
+ * @param red Canal vermelho (idem green e blue).
+ * @param sum Soma dos três canais, usada no lugar da intensidade.
  */
-class Graph {
+class PixelFeatures {
 private:
-    int V;
-    std::vector<std::vector<int> > graph;
-    std::vector<std::vector<int> > residualGraph;
-    std::vector<Pixel> vertices;
+    int width, height, depth;
+    std::vector<uint16_t> red, green, blue, sum;
+
+public:
+    static const int MAX_SQUARED_DIFFERENCE = 100 * 100;
+
+    PixelFeatures(const std::vector<Pixel>& pixels, int w, int h, int d = 1)
+        : width(w), height(h), depth(d), red(pixels.size()), green(pixels.size()), blue(pixels.size()), sum(pixels.size()) {
+        for (size_t i = 0; i < pixels.size(); ++i) {
+            red[i] = pixels[i].r;
+            green[i] = pixels[i].g;
+            blue[i] = pixels[i].b;
+            sum[i] = static_cast<uint16_t>(pixels[i].r + pixels[i].g + pixels[i].b);
+        }
+    }
 
     /**
-     * @brief Realiza uma busca em largura no grafo residual para encontrar um caminho de aumento.
-     * 
-     * @param source Vértice de origem.
-     * @param sink Vértice de destino.
-     * @param parent Vetor que armazena o caminho de aumento.
-     * @return true se existir um caminho de origem a destino; caso contrário, false.
+     * @brief Tabela capacidade(d²) = max(0, (int)(100 - sqrt(d²))), sendo d a distância euclidiana entre as cores.
      */
-    bool bfs(int source, int sink, std::vector<int>& parent) {
-        std::vector<bool> visited(V, false);
-        std::queue<int> q;
+    static const std::vector<int>& capacityTable() {
+        static const std::vector<int> table = []() {
+            std::vector<int> values(MAX_SQUARED_DIFFERENCE + 1);
+            for (int squared = 0; squared <= MAX_SQUARED_DIFFERENCE; ++squared) {
+                values[squared] = std::max(0, static_cast<int>(100 - std::sqrt(static_cast<double>(squared))));
+            }
+            return values;
+        }();
+        return table;
+    }
 
-        q.push(source);
-        visited[source] = true;
-        parent[source] = -1;
+    /**
+     * @brief Capacidade da aresta entre dois pixels quaisquer (para quem não tem os planos à mão).
+     */
+    static int capacityBetween(const Pixel& a, const Pixel& b) {
+        int dr = a.r - b.r, dg = a.g - b.g, db = a.b - b.b;
+        return capacityTable()[std::min(dr * dr + dg * dg + db * db, MAX_SQUARED_DIFFERENCE)];
+    }
 
-        while (!q.empty()) {
-            int u = q.front();
-            q.pop();
+    /**
+     * @brief Capacidades das arestas de cada pixel da linha y para o vizinho à esquerda (out[0] = 0).
+     */
+    void horizontalCapacities(int y, int* out) const {
+        const uint16_t* r = &red[y * width];
+        const uint16_t* g = &green[y * width];
+        const uint16_t* b = &blue[y * width];
+        const int* table = capacityTable().data();
 
-            for (int v = 0; v < V; ++v) {
-                if (!visited[v] && residualGraph[u][v] > 0) {
-                    q.push(v);
-                    parent[v] = u;
-                    visited[v] = true;
-                }
-            }
+        out[0] = 0;
+        for (int x = 1; x < width; ++x) {
+            int dr = r[x] - r[x - 1], dg = g[x] - g[x - 1], db = b[x] - b[x - 1];
+            out[x] = table[std::min(dr * dr + dg * dg + db * db, MAX_SQUARED_DIFFERENCE)];
         }
-
-        return visited[sink];
     }
 
-public:
-    Graph(int vertexCount) : V(vertexCount) {
-        graph.resize(V, std::vector<int>(V, 0));
-        residualGraph.resize(V, std::vector<int>(V, 0));
-        vertices.resize(V);
+    /**
+     * @brief Capacidades das arestas de cada pixel da linha y (y > 0) para o vizinho de cima.
+     */
+    void verticalCapacities(int y, int* out) const {
+        const uint16_t* r = &red[y * width];
+        const uint16_t* g = &green[y * width];
+        const uint16_t* b = &blue[y * width];
+        const int* table = capacityTable().data();
+
+        for (int x = 0; x < width; ++x) {
+            int dr = r[x] - r[x - width], dg = g[x] - g[x - width], db = b[x] - b[x - width];
+            out[x] = table[std::min(dr * dr + dg * dg + db * db, MAX_SQUARED_DIFFERENCE)];
+        }
     }
 
     /**
-     * @brief Adiciona um vértice ao grafo com suas informações associadas.
-     * 
-     * @param id Identificador do vértice.
-     * @param pixel Informações do pixel associadas ao vértice.
+     * @brief Capacidades das arestas de cada voxel da fatia z (z > 0) para o vizinho da fatia anterior.
      */
-    void addVertex(int id, const Pixel& pixel) {
-        vertices[id] = pixel;
+    void depthCapacities(int z, int* out) const {
+        const int slice = width * height;
+        const uint16_t* r = &red[z * slice];
+        const uint16_t* g = &green[z * slice];
+        const uint16_t* b = &blue[z * slice];
+        const int* table = capacityTable().data();
+
+        for (int i = 0; i < slice; ++i) {
+            int dr = r[i] - r[i - slice], dg = g[i] - g[i - slice], db = b[i] - b[i - slice];
+            out[i] = table[std::min(dr * dr + dg * dg + db * db, MAX_SQUARED_DIFFERENCE)];
+        }
     }
 
     /**
-     * @brief Adiciona uma aresta ao grafo com uma capacidade especificada.
-     * 
-     * @param u Vértice de origem.
-     * @param v Vértice de destino.
-     * @param capacity Capacidade da aresta.
+     * @brief Capacidades terminais de todos os pixels para as faixas dadas.
      */
-    void addEdge(int u, int v, int capacity) {
-        graph[u][v] += capacity;
-        residualGraph[u][v] += capacity;
+    void terminalCapacities(const IntensityCutoffs& cutoffs, int* source, int* sink) const {
+        const int n = width * height * depth;
+        for (int i = 0; i < n; ++i) {
+            source[i] = cutoffs.source(sum[i]);
+            sink[i] = cutoffs.sink(sum[i]);
+        }
+    }
+
+    int intensitySum(int i) const {
+        return sum[i];
     }
+};
+
+/**
+ * @brief Rede de fluxo especializada para grades 4-conexas de pixels, com o algoritmo de Dinic (e, com mais de uma
+ * thread, push-relabel por blocos em paralelo).
+ * 
+ * Em vez de uma matriz de adjacência, cada pixel guarda apenas as capacidades residuais das suas quatro arestas
+ * vizinhas e das duas arestas terminais, em vetores separados por direção (estrutura de vetores). O vizinho de
+ * um pixel p é obtido por aritmética de índices (p + 1, p - 1, p + largura, p - largura); as arestas que sairiam
+ * da imagem têm capacidade zero e por isso nunca são percorridas. São cerca de 30 bytes por pixel.
+ * 
+ * Com profundidade maior que 1 a grade é um volume 6-conexo: os voxels são indexados por (z * altura + y) * largura
+ * + x e ganham as direções FRONT (p + largura * altura) e BACK (p - largura * altura). Os vetores dessas duas
+ * direções só são alocados nesse caso, então a grade 2-D continua com o mesmo consumo de memória.
+ * 
+ * @param width Largura da grade.
+ * @param height Altura da grade.
+ * @param depth Número de fatias (1 para imagens).
+ * @param directions Número de direções vizinhas percorridas (4 em 2-D, 6 em 3-D).
+ * @param capRight Capacidade residual de p para o vizinho à direita (idem capLeft, capDown, capUp, capFront e
+ * capBack).
+ * @param capSource Capacidade residual da fonte para p.
+ * @param capSink Capacidade residual de p para o sumidouro.
+ * @param termSource Capacidade atual (não residual) da aresta fonte -> p; idem termSink. Permitem alterar as
+ * arestas terminais depois de resolvida a rede sem perder o fluxo já enviado.
+ * @param excess Excesso de cada pixel no fluxo em paralelo (push-relabel), alocado só no primeiro maxFlow com mais
+ * de uma thread e zerado ao fim de cada um.
+ */
+class GridFlowNetwork {
+public:
+    enum Direction { RIGHT = 0, LEFT = 1, DOWN = 2, UP = 3, FRONT = 4, BACK = 5 };
+
+private:
+    int width, height, depth;
+    int directions;
+    std::vector<int> capRight, capLeft, capDown, capUp, capFront, capBack;
+    std::vector<int> capSource, capSink;
+    std::vector<int> termSource, termSink;
+    std::vector<int> level;
+    std::vector<unsigned char> currentArc;
+    std::vector<int> queue;
+    std::vector<int> path;
+    std::vector<char> dirtyBlocks;
+    std::vector<int> excess;
+    long long totalFlow;
 
     /**
-     * @brief Calcula o fluxo máximo entre dois vértices utilizando o algoritmo de Ford-Fulkerson.
-     * 
-     * @param source Vértice de origem.
-     * @param sink Vértice de destino.
-     * @return Fluxo máximo entre origem e destino.
+     * @brief Retângulo [x0, x1) x [y0, y1) de pixels ao qual uma busca fica restrita (em todas as fatias).
      */
-    int fordFulkerson(int source, int sink) {
-        int maxFlow = 0;
-        std::vector<int> parent(V);
+    struct Region {
+        int x0, y0, x1, y1;
+    };
 
-        while (bfs(source, sink, parent)) {
-            int pathFlow = std::numeric_limits<int>::max();
-
-            for (int v = sink; v != source; v = parent[v]) {
-                int u = parent[v];
-                pathFlow = std::min(pathFlow, residualGraph[u][v]);
-            }
+    static const int BLOCK_SIZE = 64;
 
-            for (int v = sink; v != source; v = parent[v]) {
-                int u = parent[v];
-                residualGraph[u][v] -= pathFlow;
-                residualGraph[v][u] += pathFlow;
-            }
+    int* residuals(int direction) {
+        switch (direction) {
+            case RIGHT: return capRight.data();
+            case LEFT: return capLeft.data();
+            case DOWN: return capDown.data();
+            case UP: return capUp.data();
+            case FRONT: return capFront.data();
+            default: return capBack.data();
+        }
+    }
 
-            maxFlow += pathFlow;
+    int offset(int direction) const {
+        switch (direction) {
+            case RIGHT: return 1;
+            case LEFT: return -1;
+            case DOWN: return width;
+            case UP: return -width;
+            case FRONT: return width * height;
+            default: return -width * height;
         }
+    }
 
-        return maxFlow;
+    bool isWhole(const Region& region) const {
+        return region.x0 == 0 && region.y0 == 0 && region.x1 == width && region.y1 == height;
+    }
+
+    /**
+     * @brief Verifica se o vizinho de u na direção dada continua dentro da região. As regiões cobrem todas as
+     * fatias, e as arestas FRONT/BACK que sairiam do volume já têm capacidade zero.
+     */
+    bool staysInside(const Region& region, int u, int direction) const {
+        int x = u % width;
+        int y = (u / width) % height;
+        switch (direction) {
+            case RIGHT: return x + 1 < region.x1;
+            case LEFT: return x - 1 >= region.x0;
+            case DOWN: return y + 1 < region.y1;
+            case UP: return y - 1 >= region.y0;
+            default: return true;
+        }
     }
 
     /**
-     * @brief Realiza a segmentação do grafo usando o corte mínimo com base no fluxo máximo.
+     * @brief Contadores de trabalho de uma chamada de fluxo (um por thread), somados às estatísticas de --stats.
      * 
-     * @param source Vértice de origem.
-     * @param sink Vértice de destino.
-     * @return Vetor de dois conjuntos, representando os vértices no corte mínimo.
+     * @param paths Caminhos aumentantes encontrados.
+     * @param visits Pixels visitados pelas buscas em largura que montam os níveis.
      */
-    std::vector<std::vector<int> > minCutSegmentation(int source, int sink) {
-        fordFulkerson(source, sink);
-        
-        std::vector<bool> visited(V, false);
-        std::queue<int> q;
-        
-        q.push(source);
-        visited[source] = true;
-        
-        while (!q.empty()) {
-            int u = q.front();
-            q.pop();
-            
-            for (int v = 0; v < V; ++v) {
-                if (!visited[v] && residualGraph[u][v] > 0) {
-                    q.push(v);
-                    visited[v] = true;
+    struct WorkCounters {
+        long long paths;
+        long long visits;
+
+        WorkCounters() : paths(0), visits(0) {}
+
+        void report() const {
+            TGC_STATS_COUNT("augmenting_paths", paths);
+            TGC_STATS_COUNT("bfs_visits", visits);
+        }
+    };
+
+    /**
+     * @brief Expande por busca em largura, a partir dos pixels já na fila (nível 1), os níveis do grafo residual
+     * sem sair da região.
+     * 
+     * @param queue Fila de trabalho (uma por thread), já com as sementes.
+     * @return true se algum pixel com capacidade residual para o sumidouro for alcançado.
+     */
+    bool expandLevels(const Region& region, std::vector<int>& queue) {
+        bool whole = isWhole(region);
+        bool reachesSink = false;
+
+        for (size_t head = 0; head < queue.size(); ++head) {
+            int u = queue[head];
+            if (capSink[u] > 0) reachesSink = true;
+
+            for (int d = 0; d < directions; ++d) {
+                int v = u + offset(d);
+                if (residuals(d)[u] > 0 && (whole || staysInside(region, u, d)) && level[v] < 0) {
+                    level[v] = level[u] + 1;
+                    queue.push_back(v);
                 }
             }
         }
-        
-        
-        std::vector<std::vector<int> > segmentation;
-        std::vector<int> foreground, background;
-        
-        for (int i = 0; i < V - 2; ++i) {
-            if (visited[i]) {
-                foreground.push_back(i);
-            } else {
-                background.push_back(i);
-            }
+        return reachesSink;
+    }
+
+    /**
+     * @brief Reinicia o nível e o arco atual de um pixel e o coloca na fila se ele tiver capacidade vinda da fonte.
+     */
+    void seedLevel(int p, std::vector<int>& queue) {
+        level[p] = -1;
+        currentArc[p] = 0;
+        if (capSource[p] > 0) {
+            level[p] = 1;
+            queue.push_back(p);
         }
-        
-        segmentation.push_back(foreground);
-        segmentation.push_back(background);
-        
-        return segmentation;
     }
 
     /**
-     * @brief Retorna o vetor de vértices do grafo.
+     * @brief Calcula os níveis (distância a partir da fonte) por busca em largura no grafo residual, sem sair da
+     * região.
      * 
-     * @return Referência constante ao vetor de vértices.
+     * @param queue Fila de trabalho (uma por thread).
+     * @return true se algum pixel com capacidade residual para o sumidouro for alcançado.
      */
-    const std::vector<Pixel>& getVertices() const {
-        return vertices;
+    bool buildLevels(const Region& region, std::vector<int>& queue) {
+        queue.clear();
+        for (int row = 0; row < depth * height; ++row) {
+            int y = row % height;
+            if (y < region.y0 || y >= region.y1) continue;
+            for (int p = row * width + region.x0; p < row * width + region.x1; ++p) {
+                seedLevel(p, queue);
+            }
+        }
+        return expandLevels(region, queue);
     }
-};
 
-/**
- * @brief Calcula a diferença entre dois pixels com base na distância euclidiana das cores RGB.
- * 
- * @param p1 Primeiro pixel.
- * @param p2 Segundo pixel.
- * @return Diferença entre os pixels.
- */
-double calculatePixelDifference(const Pixel& p1, const Pixel& p2) {
-    return std::sqrt(
-        std::pow(static_cast<int>(p1.r) - p2.r, 2) +
-        std::pow(static_cast<int>(p1.g) - p2.g, 2) +
-        std::pow(static_cast<int>(p1.b) - p2.b, 2)
-    );
-}
+    /**
+     * @brief Envia fluxo a partir de um pixel de nível 1 pelo grafo de níveis, com busca em profundidade iterativa
+     * e arco atual por pixel, até esgotar a capacidade vinda da fonte ou não haver mais caminhos.
+     * 
+     * @param path Pilha do caminho atual (uma por thread).
+     * @param work Contadores da thread.
+     * @return Fluxo enviado.
+     */
+    long long augmentFrom(int start, const Region& region, bool whole, std::vector<int>& path, WorkCounters& work) {
+        int* caps[6] = {residuals(RIGHT), residuals(LEFT), residuals(DOWN), residuals(UP), residuals(FRONT),
+                        residuals(BACK)};
+        const int offsets[6] = {offset(RIGHT), offset(LEFT), offset(DOWN), offset(UP), offset(FRONT), offset(BACK)};
+        long long pushed = 0;
+
+        while (level[start] == 1 && capSource[start] > 0) {
+            path.clear();
+            path.push_back(start);
+
+            while (!path.empty()) {
+                int u = path.back();
+
+                if (capSink[u] > 0) {
+                    int bottleneck = std::min(capSource[start], capSink[u]);
+                    for (size_t i = 0; i + 1 < path.size(); ++i) {
+                        bottleneck = std::min(bottleneck, caps[currentArc[path[i]]][path[i]]);
+                    }
+
+                    capSource[start] -= bottleneck;
+                    capSink[u] -= bottleneck;
+                    size_t firstSaturated = path.size() - 1;
+                    for (size_t i = 0; i + 1 < path.size(); ++i) {
+                        int v = path[i];
+                        int d = currentArc[v];
+                        caps[d][v] -= bottleneck;
+                        caps[d ^ 1][v + offsets[d]] += bottleneck;
+                        if (caps[d][v] == 0 && firstSaturated == path.size() - 1) {
+                            firstSaturated = i;
+                        }
+                    }
+                    pushed += bottleneck;
+                    TGC_STATS_ONLY(work.paths++);
+
+                    if (capSource[start] == 0) break;
+                    path.resize(firstSaturated + 1);
+                    continue;
+                }
+
+                bool advanced = false;
+                while (currentArc[u] < directions) {
+                    int d = currentArc[u];
+                    if (caps[d][u] > 0 && (whole || staysInside(region, u, d))
+                        && level[u + offsets[d]] == level[u] + 1) {
+                        path.push_back(u + offsets[d]);
+                        advanced = true;
+                        break;
+                    }
+                    currentArc[u]++;
+                }
+
+                if (!advanced) {
+                    level[u] = -1;
+                    path.pop_back();
+                    if (!path.empty()) currentArc[path.back()]++;
+                }
+            }
+        }
+        return pushed;
+    }
 
-/**
- * @brief Classe para leitura de arquivos de imagem no formato PPM.
- */
-class ImageReader {
-public:
     /**
-     * @brief Lê uma imagem no formato PPM e retorna os pixels e as dimensões.
+     * @brief Encontra um fluxo bloqueante no grafo de níveis da região.
      * 
-     * @param filename Caminho do arquivo de imagem.
-     * @return Par contendo os pixels da imagem e as dimensões (largura e altura).
-     * @throws std::runtime_error Se o arquivo não puder ser aberto ou lido.
+     * @return Fluxo enviado nesta fase.
      */
-    static std::pair<std::vector<Pixel>, std::pair<int, int> > readPPM(const std::string& filename) {
-        std::ifstream file(filename.c_str(), std::ios::binary);
-        if (!file.is_open()) {
-            throw std::runtime_error("Cannot open file: " + filename);
+    long long blockingFlow(const Region& region, std::vector<int>& path, WorkCounters& work) {
+        bool whole = isWhole(region);
+        long long pushed = 0;
+        for (int row = 0; row < depth * height; ++row) {
+            int y = row % height;
+            if (y < region.y0 || y >= region.y1) continue;
+            for (int start = row * width + region.x0; start < row * width + region.x1; ++start) {
+                pushed += augmentFrom(start, region, whole, path, work);
+            }
         }
+        return pushed;
+    }
 
-        std::string magic;
-        int width, height, maxVal;
-        file >> magic >> width >> height >> maxVal;
-        file.ignore(1); 
+    /**
+     * @brief Executa Dinic até esgotar os caminhos aumentantes contidos na região.
+     */
+    long long solveRegion(const Region& region, std::vector<int>& queue, std::vector<int>& path,
+                          WorkCounters& work) {
+        long long pushed = 0;
+        while (buildLevels(region, queue)) {
+            TGC_STATS_ONLY(work.visits += queue.size());
+            pushed += blockingFlow(region, path, work);
+        }
+        TGC_STATS_ONLY(work.visits += queue.size());
+        return pushed;
+    }
 
-        std::vector<Pixel> pixels;
-        pixels.reserve(width * height);
+    /**
+     * @brief Envia diretamente fonte -> p -> sumidouro o que couber nas duas arestas terminais do pixel.
+     */
+    void saturateTerminals(int p) {
+        int direct = std::min(capSource[p], capSink[p]);
+        capSource[p] -= direct;
+        capSink[p] -= direct;
+        totalFlow += direct;
+    }
 
-        for (int i = 0; i < width * height; ++i) {
-            unsigned char r = 0, g = 0, b = 0;
-            file.read(reinterpret_cast<char*>(&r), 1);
-            file.read(reinterpret_cast<char*>(&g), 1);
-            file.read(reinterpret_cast<char*>(&b), 1);
-            pixels.push_back(Pixel(r, g, b));
+    /**
+     * @brief Propaga pelo grafo residual a marcação dos pixels já na fila.
+     */
+    void expandReachable(std::vector<char>& reachable) {
+        for (size_t head = 0; head < queue.size(); ++head) {
+            int u = queue[head];
+            for (int d = 0; d < directions; ++d) {
+                int v = u + offset(d);
+                if (residuals(d)[u] > 0 && !reachable[v]) {
+                    reachable[v] = 1;
+                    queue.push_back(v);
+                }
+            }
         }
+        TGC_STATS_COUNT("cut_bfs_visits", queue.size());
+    }
 
-        return std::make_pair(pixels, std::make_pair(width, height));
+    int blocksPerRow() const {
+        return (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
     }
-};
-/**
- * @brief Classe para salvar imagens segmentadas no formato PPM.
- */
-class ImageWriter {
-public:
+
     /**
-     * @function ImageWriter::saveSegmentationImage
-     * @brief Salva a segmentação de uma imagem no formato PPM.
+     * @brief Marca o bloco de BLOCK_SIZE x BLOCK_SIZE pixels que contém p como alterado desde o último maxFlow.
+     */
+    void markDirty(int p) {
+        int x = p % width;
+        int y = (p / width) % height;
+        dirtyBlocks[(y / BLOCK_SIZE) * blocksPerRow() + x / BLOCK_SIZE] = 1;
+    }
+
+    /**
+     * @brief Resolve em paralelo (com até threads threads) só os blocos marcados por markDirty, com caminhos
+     * internos a cada bloco, e desmarca todos. Depois de poucas alterações numa rede já resolvida, quase todo o
+     * fluxo novo é local e fica resolvido aqui, e a passada na grade inteira que vem depois termina em poucas fases.
      * 
-     * @param segmentation Segmentação resultante (conjuntos de índices de pixels).
-     * @param vertices Vetor de pixels do grafo.
-     * @param width Largura da imagem.
-     * @param height Altura da imagem.
-     * @param outputPath Caminho do arquivo de saída.
-     * @throws std::runtime_error Se o arquivo de saída não puder ser criado.
+     * @return Fluxo enviado pelos blocos.
      */
-    static void saveSegmentationImage(
-        const std::vector<std::vector<int> >& segmentation, 
-        const std::vector<Pixel>& vertices,
-        int width, int height,
-        const std::string& outputPath
-    ) {
-        std::vector<Pixel> outputPixels(width * height, Pixel());
-        
-        std::vector<Pixel> componentColors;
-        std::srand(static_cast<unsigned int>(std::time(NULL))); 
-        
-        for (size_t i = 0; i < segmentation.size(); ++i) {
-            componentColors.push_back(Pixel(
-                static_cast<unsigned char>(std::rand() % 256),
-                static_cast<unsigned char>(std::rand() % 256),
-                static_cast<unsigned char>(std::rand() % 256)
-            ));
+    long long solveDirtyBlocks(int threads) {
+        std::vector<Region> regions;
+        for (size_t b = 0; b < dirtyBlocks.size(); ++b) {
+            if (!dirtyBlocks[b]) continue;
+            int bx = static_cast<int>(b % blocksPerRow()) * BLOCK_SIZE;
+            int by = static_cast<int>(b / blocksPerRow()) * BLOCK_SIZE;
+            Region region = {bx, by, std::min(width, bx + BLOCK_SIZE), std::min(height, by + BLOCK_SIZE)};
+            regions.push_back(region);
+            dirtyBlocks[b] = 0;
         }
-        
-        for (size_t colorIndex = 0; colorIndex < segmentation.size(); ++colorIndex) {
-            for (size_t j = 0; j < segmentation[colorIndex].size(); ++j) {
-                int pixel = segmentation[colorIndex][j];
-                outputPixels[pixel] = componentColors[colorIndex];
+
+        std::atomic<long long> total(0);
+        parallel::sharedPool().parallelFor(0, regions.size(), 1, [this, &regions, &total](size_t from, size_t to) {
+            std::vector<int> localQueue, localPath;
+            WorkCounters work;
+            for (size_t i = from; i < to; ++i) {
+                total += solveRegion(regions[i], localQueue, localPath, work);
             }
+            work.report();
+        }, threads);
+        return total;
+    }
+
+    /**
+     * @brief Vetores de trabalho de uma thread nas descargas de região.
+     */
+    struct DischargeBuffers {
+        std::vector<int> active;
+        std::vector<int> seeds;
+        std::vector<int> queue;
+    };
+
+    /**
+     * @brief Contadores de trabalho das descargas de região (um por thread), somados às estatísticas de --stats.
+     *
+     * @param pushes Envios de excesso para um vizinho ou para o sumidouro.
+     * @param relabels Aumentos de rótulo durante a descarga (contados mesmo sem --stats: decidem quando os rótulos
+     * da grade inteira são recalculados).
+     */
+    struct DischargeCounters {
+        long long pushes;
+        long long relabels;
+
+        DischargeCounters() : pushes(0), relabels(0) {}
+
+        void report() const {
+            TGC_STATS_COUNT("pushes", pushes);
+            TGC_STATS_COUNT("relabels", relabels);
         }
-        
-        std::ofstream outputFile(outputPath.c_str(), std::ios::binary);
-        if (!outputFile.is_open()) {
-            throw std::runtime_error("Error creating output file.");
+    };
+
+    /**
+     * @brief Recalcula o rótulo de todos os pixels como a distância exata até o sumidouro no grafo residual
+     * (busca em largura reversa a partir dos pixels com capacidade para o sumidouro). Quem não alcança o sumidouro
+     * recebe dead: o excesso desses pixels não tem mais para onde ir.
+     */
+    void relabelAll(int dead) {
+        int* caps[6] = {residuals(RIGHT), residuals(LEFT), residuals(DOWN), residuals(UP), residuals(FRONT),
+                        residuals(BACK)};
+        int n = width * height * depth;
+        queue.clear();
+        for (int p = 0; p < n; ++p) {
+            level[p] = capSink[p] > 0 ? 1 : dead;
+            if (capSink[p] > 0) queue.push_back(p);
         }
-        
-        outputFile << "P6\n" << width << " " << height << "\n255\n";
-        
-        for (size_t i = 0; i < outputPixels.size(); ++i) {
-            outputFile.put(outputPixels[i].r);
-            outputFile.put(outputPixels[i].g);
-            outputFile.put(outputPixels[i].b);
+        for (size_t head = 0; head < queue.size(); ++head) {
+            int u = queue[head];
+            for (int d = 0; d < directions; ++d) {
+                int w = u + offset(d);
+                if (w >= 0 && w < n && caps[d ^ 1][w] > 0 && level[w] == dead) {
+                    level[w] = level[u] + 1;
+                    queue.push_back(w);
+                }
+            }
         }
-        
-        outputFile.close();
     }
-};
-/**
- * @brief Classe para realizar segmentação de imagem utilizando um grafo de fluxo.
- * 
- * @param flowNetwork Grafo de fluxo associado à imagem.
- * @param width Largura da imagem.
- * @param height Altura da imagem.
- * @param pixels Vetor de pixels da imagem.
- */
-class ImageSegmentation {
-private:
-    Graph flowNetwork;
-    int width, height;
-    std::vector<Pixel> pixels;
 
-public:
     /**
-     * @brief Construtor que inicializa o grafo de fluxo e armazena os pixels da imagem.
-     * 
-     * @param w Largura da imagem.
-     * @param h Altura da imagem.
-     * @param imgPixels Vetor de pixels da imagem.
+     * @brief Recalcula os rótulos dos pixels da região como a distância exata até o sumidouro, com os rótulos dos
+     * vizinhos de fora da região fixos. Cada pixel começa com o menor rótulo que consegue direto (1 se tem
+     * capacidade para o sumidouro, rótulo do vizinho de fora + 1 se tem aresta residual para ele); essas sementes
+     * entram em ordem crescente, intercaladas com a fila da busca em largura reversa, para que cada pixel seja
+     * rotulado pela primeira vez já com a menor distância.
      */
-    ImageSegmentation(int w, int h, const std::vector<Pixel>& imgPixels) 
-        : flowNetwork(w * h + 2), width(w), height(h), pixels(imgPixels) {
-        
-        
-        for (int i = 0; i < w * h; ++i) {
-            flowNetwork.addVertex(i, imgPixels[i]);
+    void relabelRegion(const Region& region, int dead, DischargeBuffers& buffers) {
+        int* caps[6] = {residuals(RIGHT), residuals(LEFT), residuals(DOWN), residuals(UP), residuals(FRONT),
+                        residuals(BACK)};
+        const int offsets[6] = {offset(RIGHT), offset(LEFT), offset(DOWN), offset(UP), offset(FRONT), offset(BACK)};
+        int n = width * height * depth;
+        std::vector<int>& seeds = buffers.seeds;
+        std::vector<int>& pending = buffers.queue;
+
+        seeds.clear();
+        for (int row = 0; row < depth * height; ++row) {
+            int y = row % height;
+            if (y < region.y0 || y >= region.y1) continue;
+            for (int p = row * width + region.x0; p < row * width + region.x1; ++p) {
+                int label = capSink[p] > 0 ? 1 : dead;
+                for (int d = 0; d < directions; ++d) {
+                    if (caps[d][p] > 0 && !staysInside(region, p, d)) {
+                        label = std::min(label, level[p + offsets[d]] + 1);
+                    }
+                }
+                level[p] = label;
+                if (label < dead) seeds.push_back(p);
+            }
+        }
+        std::sort(seeds.begin(), seeds.end(), [this](int a, int b) { return level[a] < level[b]; });
+
+        pending.clear();
+        size_t next = 0;
+        for (size_t head = 0; head < pending.size() || next < seeds.size();) {
+            int u = head < pending.size() && (next == seeds.size() || level[pending[head]] <= level[seeds[next]])
+                ? pending[head++]
+                : seeds[next++];
+            for (int d = 0; d < directions; ++d) {
+                int w = u + offsets[d];
+                if (w >= 0 && w < n && caps[d ^ 1][w] > 0 && level[w] > level[u] + 1 && staysInside(region, u, d)) {
+                    level[w] = level[u] + 1;
+                    pending.push_back(w);
+                }
+            }
         }
     }
+
     /**
-     * @brief Configura a rede de fluxo com base nos pixels da imagem e nos limiares de intensidade.
-     * 
-     * @param foregroundThreshold Limiar para determinar pixels do primeiro plano.
-     * @param backgroundThreshold Limiar para determinar pixels do fundo.
+     * @brief Descarrega a região com push-relabel: cada pixel ativo (com excesso e rótulo abaixo de dead) envia o
+     * excesso ao sumidouro ou a vizinhos de rótulo uma unidade menor, inclusive vizinhos de fora da região, que guardam
+     * o excesso recebido até a vez da região deles; sem para onde enviar, o rótulo sobe. Os rótulos de fora da região
+     * só são lidos. A cada tantos aumentos de rótulo quanto pixels da região os rótulos são recalculados por
+     * relabelRegion.
+     *
+     * @return Fluxo enviado ao sumidouro, ou -1 se a região não tinha pixel ativo.
      */
-    void setupFlowNetwork(double foregroundThreshold, double backgroundThreshold) {
-        int source = width * height;
-        int sink = width * height + 1;
+    long long dischargeRegion(const Region& region, int dead, DischargeBuffers& buffers, DischargeCounters& work) {
+        int* caps[6] = {residuals(RIGHT), residuals(LEFT), residuals(DOWN), residuals(UP), residuals(FRONT),
+                        residuals(BACK)};
+        const int offsets[6] = {offset(RIGHT), offset(LEFT), offset(DOWN), offset(UP), offset(FRONT), offset(BACK)};
+        const long long area = static_cast<long long>(region.x1 - region.x0) * (region.y1 - region.y0) * depth;
+        std::vector<int>& active = buffers.active;
+        long long sent = -1;
 
-        
-        for (int y = 0; y < height; y++) {
-            for (int x = 0; x < width; x++) {
-                int pixelNode = y * width + x;
-                Pixel pixel = pixels[pixelNode];
-                
-                
-                double intensity = (pixel.r + pixel.g + pixel.b) / 3.0;
-
-                
-                if (intensity >= foregroundThreshold) {
-                    flowNetwork.addEdge(source, pixelNode, 1000);
-                } else if (intensity <= backgroundThreshold) {
-                    flowNetwork.addEdge(pixelNode, sink, 1000);
+        for (bool finished = false; !finished;) {
+            active.clear();
+            for (int row = 0; row < depth * height; ++row) {
+                int y = row % height;
+                if (y < region.y0 || y >= region.y1) continue;
+                for (int p = row * width + region.x0; p < row * width + region.x1; ++p) {
+                    if (excess[p] > 0 && level[p] < dead) active.push_back(p);
                 }
+            }
+            if (active.empty()) break;
+            sent = std::max(sent, 0LL);
+            relabelRegion(region, dead, buffers);
 
-                
-                if (x > 0) {
-                    int leftPixel = y * width + (x - 1);
-                    double weight = calculatePixelDifference(pixel, pixels[leftPixel]);
-                    flowNetwork.addEdge(pixelNode, leftPixel, static_cast<int>(100 - weight));
+            long long budget = area;
+            finished = true;
+            for (size_t head = 0; head < active.size(); ++head) {
+                if (budget <= 0) {
+                    finished = false;
+                    break;
                 }
+                int u = active[head];
+                while (excess[u] > 0 && level[u] < dead) {
+                    if (capSink[u] > 0) {
+                        int amount = std::min(excess[u], capSink[u]);
+                        capSink[u] -= amount;
+                        excess[u] -= amount;
+                        sent += amount;
+                        TGC_STATS_ONLY(work.pushes++);
+                        continue;
+                    }
 
-                if (y > 0) {
-                    int topPixel = (y - 1) * width + x;
-                    double weight = calculatePixelDifference(pixel, pixels[topPixel]);
-                    flowNetwork.addEdge(pixelNode, topPixel, static_cast<int>(100 - weight));
+                    int lowest = dead;
+                    for (int d = 0; d < directions && excess[u] > 0; ++d) {
+                        if (caps[d][u] == 0) continue;
+                        int v = u + offsets[d];
+                        if (level[v] != level[u] - 1) {
+                            lowest = std::min(lowest, level[v]);
+                            continue;
+                        }
+                        int amount = std::min(excess[u], caps[d][u]);
+                        caps[d][u] -= amount;
+                        caps[d ^ 1][v] += amount;
+                        if (excess[v] == 0 && staysInside(region, u, d)) active.push_back(v);
+                        excess[v] += amount;
+                        excess[u] -= amount;
+                        TGC_STATS_ONLY(work.pushes++);
+                        if (caps[d][u] > 0) lowest = std::min(lowest, level[v]);
+                    }
+                    if (excess[u] > 0) {
+                        level[u] = std::min(dead, lowest + 1);
+                        budget--;
+                        work.relabels++;
+                    }
                 }
             }
         }
+        return sent;
     }
+
     /**
-     * @brief Realiza a segmentação da imagem utilizando corte mínimo.
-     * 
-     * @param foregroundThreshold Limiar para pixels do primeiro plano.
-     * @param backgroundThreshold Limiar para pixels do fundo.
-     * @return Segmentação resultante como dois conjuntos de pixels.
+     * @brief Fluxo máximo em paralelo por descarga de regiões (push-relabel em blocos).
+     *
+     * Toda a capacidade residual vinda da fonte vira excesso nos pixels. Cada rodada divide a grade em blocos de
+     * BLOCK_SIZE x BLOCK_SIZE (deslocados de meio bloco nas rodadas ímpares) e descarrega os blocos em quatro fases,
+     * uma por cor de um xadrez 2 x 2: blocos da mesma cor não se tocam, então os que rodam juntos só escrevem em
+     * pixels e arestas próprios ou do lado de fora da fronteira com um vizinho que está parado. O excesso que
+     * atravessa uma fronteira é descarregado pelo bloco vizinho na fase seguinte. As rodadas se repetem até nenhum
+     * bloco ter pixel ativo. Os rótulos de toda a grade são recalculados (relabelAll) no início, sempre que os aumentos
+     * de rótulo somarem o número de pixels e depois de uma rodada que não enviou nada ao sumidouro: o excesso parado
+     * costuma estar preso entre dois blocos, subindo o rótulo aos poucos, e a busca global o marca como dead de uma
+     * vez.
+     *
+     * O excesso que sobra está em pixels que não alcançam o sumidouro. Ele é devolvido como em updateTerminal: o
+     * pixel passa a mandar o excesso ao sumidouro por uma aresta terminal acrescida do mesmo valor que a aresta
+     * fonte -> pixel, o que soma uma constante ao custo de todo corte; o resultado é um fluxo (não só um pré-fluxo)
+     * máximo com o mesmo corte mínimo.
+     *
+     * @return Fluxo enviado ao sumidouro pelas rodadas.
      */
-    std::vector<std::vector<int> > segment(double foregroundThreshold, double backgroundThreshold) {
-        setupFlowNetwork(foregroundThreshold, backgroundThreshold);
-        
-        int source = width * height;
-        int sink = width * height + 1;
-        
-        return flowNetwork.minCutSegmentation(source, sink);
-    }
+    long long dischargeBlocks(int threads) {
+        int n = width * height * depth;
+        int dead = n;
+        if (excess.size() != static_cast<size_t>(n)) excess.assign(n, 0);
+        for (int p = 0; p < n; ++p) {
+            excess[p] = capSource[p];
+            capSource[p] = 0;
+        }
+        relabelAll(dead);
 
-    const Graph& getGraph() const {
-        return flowNetwork;
-    }
-};
+        long long total = 0;
+        long long relabels = 0;
+        int rounds = 0;
+        for (bool busy = true; busy; ++rounds) {
+            int shift = rounds % 2 ? BLOCK_SIZE / 2 : 0;
+            std::vector<Region> colours[4];
+            for (int by = shift > 0 ? shift - BLOCK_SIZE : 0, j = 0; by < height; by += BLOCK_SIZE, ++j) {
+                for (int bx = shift > 0 ? shift - BLOCK_SIZE : 0, i = 0; bx < width; bx += BLOCK_SIZE, ++i) {
+                    Region region = {std::max(0, bx), std::max(0, by),
+                                     std::min(width, bx + BLOCK_SIZE), std::min(height, by + BLOCK_SIZE)};
+                    if (region.x0 < region.x1 && region.y0 < region.y1) colours[(j % 2) * 2 + i % 2].push_back(region);
+                }
+            }
 
-int main() {
-    try {
-        std::pair<std::vector<Pixel>, std::pair<int, int> > imageData 
-            = ImageReader::readPPM("imagem.ppm");
+            std::atomic<long long> sent(0), raised(0);
+            std::atomic<bool> anyActive(false);
+            for (int c = 0; c < 4; ++c) {
+                const std::vector<Region>& regions = colours[c];
+                parallel::sharedPool().parallelFor(0, regions.size(), 1,
+                    [this, &regions, dead, &sent, &raised, &anyActive](size_t from, size_t to) {
+                        DischargeBuffers buffers;
+                        DischargeCounters work;
+                        for (size_t i = from; i < to; ++i) {
+                            long long pushed = dischargeRegion(regions[i], dead, buffers, work);
+                            if (pushed < 0) continue;
+                            sent += pushed;
+                            anyActive = true;
+                        }
+                        raised += work.relabels;
+                        work.report();
+                    }, threads);
+            }
+            total += sent;
+            busy = anyActive;
+            relabels += raised;
+            if (busy && (relabels >= n || sent == 0)) {
+                relabelAll(dead);
+                relabels = 0;
+            }
+        }
+        TGC_STATS_COUNT("discharge_rounds", rounds);
+
+        for (int p = 0; p < n; ++p) {
+            capSource[p] += excess[p];
+            total += excess[p];
+            excess[p] = 0;
+        }
+        return total;
+    }
+
+public:
+    GridFlowNetwork(int w, int h, int d = 1) : width(w), height(h), depth(d), directions(d > 1 ? 6 : 4), totalFlow(0) {
+        size_t n = static_cast<size_t>(w) * h * d;
+        capRight.assign(n, 0);
+        capLeft.assign(n, 0);
+        capDown.assign(n, 0);
+        capUp.assign(n, 0);
+        if (d > 1) {
+            capFront.assign(n, 0);
+            capBack.assign(n, 0);
+        }
+        capSource.assign(n, 0);
+        capSink.assign(n, 0);
+        termSource.assign(n, 0);
+        termSink.assign(n, 0);
+        level.assign(n, -1);
+        currentArc.assign(n, 0);
+        dirtyBlocks.assign(static_cast<size_t>(blocksPerRow()) * ((h + BLOCK_SIZE - 1) / BLOCK_SIZE), 0);
+    }
+
+    /**
+     * @brief Zera todas as capacidades e o fluxo acumulado.
+     */
+    void reset() {
+        std::fill(capRight.begin(), capRight.end(), 0);
+        std::fill(capLeft.begin(), capLeft.end(), 0);
+        std::fill(capDown.begin(), capDown.end(), 0);
+        std::fill(capUp.begin(), capUp.end(), 0);
+        std::fill(capFront.begin(), capFront.end(), 0);
+        std::fill(capBack.begin(), capBack.end(), 0);
+        std::fill(capSource.begin(), capSource.end(), 0);
+        std::fill(capSink.begin(), capSink.end(), 0);
+        std::fill(termSource.begin(), termSource.end(), 0);
+        std::fill(termSink.begin(), termSink.end(), 0);
+        totalFlow = 0;
+    }
+
+    /**
+     * @brief Define as capacidades das arestas terminais de um pixel numa rede ainda sem fluxo.
+     * 
+     * @param p Índice do pixel.
+     * @param source Capacidade da aresta fonte -> p.
+     * @param sink Capacidade da aresta p -> sumidouro.
+     */
+    void setTerminal(int p, int source, int sink) {
+        capSource[p] = termSource[p] = source;
+        capSink[p] = termSink[p] = sink;
+    }
+
+    /**
+     * @brief Monta a rede sem fluxo a partir dos planos de atributos, escrevendo cada vetor de capacidade uma
+     * única vez (no lugar de reset seguido de setTerminal/setEdge pixel a pixel).
+     * 
+     * Como na matriz residual original, cada pixel só tem aresta para os vizinhos de índice menor (LEFT, UP e,
+     * em volumes, BACK); as direções opostas começam com capacidade residual zero.
+     * 
+     * @param features Atributos da imagem (ou do volume), com as mesmas dimensões da grade.
+     * @param cutoffs Faixas de intensidade das arestas terminais.
+     */
+    void build(const PixelFeatures& features, const IntensityCutoffs& cutoffs) {
+        std::fill(capRight.begin(), capRight.end(), 0);
+        std::fill(capDown.begin(), capDown.end(), 0);
+        std::fill(capFront.begin(), capFront.end(), 0);
+
+        features.terminalCapacities(cutoffs, termSource.data(), termSink.data());
+        capSource = termSource;
+        capSink = termSink;
+
+        const int slice = width * height;
+        for (int z = 0; z < depth; ++z) {
+            std::fill(capUp.begin() + z * slice, capUp.begin() + z * slice + width, 0);
+            for (int y = 0; y < height; ++y) {
+                int row = z * height + y;
+                features.horizontalCapacities(row, &capLeft[row * width]);
+                if (y > 0) features.verticalCapacities(row, &capUp[row * width]);
+            }
+            if (z > 0) {
+                features.depthCapacities(z, &capBack[z * slice]);
+            } else if (depth > 1) {
+                std::fill(capBack.begin(), capBack.begin() + slice, 0);
+            }
+        }
+        totalFlow = 0;
+    }
+
+    /**
+     * @brief Altera as capacidades terminais de um pixel mantendo o fluxo já enviado (corte dinâmico).
+     * 
+     * As residuais recebem a diferença entre a capacidade nova e a antiga. Se alguma ficar negativa (capacidade
+     * abaixo do fluxo que já passa pela aresta), soma-se a mesma constante às duas arestas terminais do pixel: isso
+     * acrescenta a mesma constante ao custo de todo corte e portanto não muda o corte mínimo. O próximo maxFlow
+     * continua a partir do fluxo atual.
+     * 
+     * @param p Índice do pixel.
+     * @param source Nova capacidade da aresta fonte -> p.
+     * @param sink Nova capacidade da aresta p -> sumidouro.
+     */
+    void updateTerminal(int p, int source, int sink) {
+        capSource[p] += source - termSource[p];
+        capSink[p] += sink - termSink[p];
+        termSource[p] = source;
+        termSink[p] = sink;
+
+        int deficit = std::max(-capSource[p], -capSink[p]);
+        if (deficit > 0) {
+            capSource[p] += deficit;
+            capSink[p] += deficit;
+        }
+        markDirty(p);
+    }
+
+    /**
+     * @brief Altera a capacidade da aresta de p para o vizinho na direção dada mantendo o fluxo já enviado (corte
+     * dinâmico, como updateTerminal). Vale para as arestas montadas por build ou setEdge, cuja aresta oposta começa
+     * com capacidade zero: o fluxo atual é então a residual da aresta oposta.
+     * 
+     * Se a nova capacidade c ficar abaixo do fluxo f, o excesso d = f - c é desviado: p, que recebia d a mais do
+     * que agora pode enviar, manda d direto ao sumidouro, e o vizinho recebe d direto da fonte. Para que isso não
+     * mude o corte mínimo, as arestas terminais opostas (fonte -> p e vizinho -> sumidouro) também ganham d: cada
+     * pixel passa a pagar d em qualquer lado do corte, uma constante.
+     * 
+     * @param p Índice do pixel.
+     * @param direction Direção do vizinho (deve existir dentro da grade).
+     * @param capacity Nova capacidade da aresta (negativas contam como zero).
+     */
+    void updateEdge(int p, Direction direction, int capacity) {
+        int q = p + offset(direction);
+        int* forward = residuals(direction);
+        int* backward = residuals(direction ^ 1);
+        int flow = backward[q];
+        capacity = std::max(0, capacity);
+        markDirty(p);
+
+        if (capacity >= flow) {
+            forward[p] = capacity - flow;
+            return;
+        }
+        int excess = flow - capacity;
+        forward[p] = 0;
+        backward[q] = capacity;
+        capSource[p] += excess;
+        capSink[q] += excess;
+        totalFlow += excess;
+    }
+
+    /**
+     * @brief Define a capacidade da aresta de p para o vizinho na direção dada. Capacidades negativas contam como
+     * zero, como na matriz residual original.
+     * 
+     * @param p Índice do pixel.
+     * @param direction Direção do vizinho (deve existir dentro da imagem).
+     * @param capacity Capacidade da aresta.
+     */
+    void setEdge(int p, Direction direction, int capacity) {
+        residuals(direction)[p] = std::max(0, capacity);
+    }
+
+    /**
+     * @brief Calcula o fluxo máximo da fonte ao sumidouro a partir do estado residual atual.
+     * 
+     * Com mais de uma thread o fluxo é enviado por dischargeBlocks, que repete rodadas de blocos em paralelo até
+     * não sobrar excesso que alcance o sumidouro; a passada de Dinic na grade inteira que vem depois só confirma
+     * que não há caminho aumentante (uma busca em largura). Com uma thread essa passada faz todo o trabalho. O
+     * corte retornado por sourceSide é o mesmo nos dois casos.
+     * 
+     * @param threads Número de threads.
+     * @return Fluxo total enviado desde o último reset.
+     */
+    long long maxFlow(int threads = 1) {
+        TGC_STATS_PHASE("flow");
+        int n = width * height * depth;
+        for (int p = 0; p < n; ++p) {
+            saturateTerminals(p);
+        }
+
+        totalFlow += solveDirtyBlocks(threads);
+        if (threads > 1) {
+            totalFlow += dischargeBlocks(threads);
+        }
+
+        Region whole = {0, 0, width, height};
+        WorkCounters work;
+        totalFlow += solveRegion(whole, queue, path, work);
+        work.report();
+        return totalFlow;
+    }
+
+    /**
+     * @brief Marca os pixels alcançáveis a partir da fonte no grafo residual (lado da fonte do corte mínimo).
+     * 
+     * @param reachable Recebe 1 para pixels do lado da fonte e 0 para os demais.
+     */
+    void sourceSide(std::vector<char>& reachable) {
+        TGC_STATS_PHASE("cut_bfs");
+        int n = width * height * depth;
+        reachable.assign(n, 0);
+        queue.clear();
+
+        for (int p = 0; p < n; ++p) {
+            if (capSource[p] > 0) {
+                reachable[p] = 1;
+                queue.push_back(p);
+            }
+        }
+        expandReachable(reachable);
+    }
+
+    int getWidth() const { return width; }
+
+    int getHeight() const { return height; }
+
+    int getDepth() const { return depth; }
+};
+
+/**
+ * @brief Rede de fluxo restrita a uma faixa de pixels de uma grade 4-conexa, com o mesmo Dinic de GridFlowNetwork.
+ * 
+ * Serve ao refinamento da pirâmide, em que só uma faixa estreita em torno da fronteira herdada entra na rede. Os
+ * pixels da faixa são numerados em ordem crescente de índice na grade, e todos os vetores têm o tamanho da faixa,
+ * não da grade: memória e tempo são proporcionais ao número de pixels da faixa. Como a aritmética de índices da
+ * grade não vale na numeração compacta, o vizinho de cada pixel em cada direção é guardado (-1 fora da faixa); ele
+ * é achado uma vez, na construção, por busca binária na lista ordenada de pixels.
+ * 
+ * @param pixels Índice na grade de cada pixel da faixa, em ordem crescente.
+ * @param neighbours Pixel da faixa vizinho em cada direção (RIGHT, LEFT, DOWN, UP de GridFlowNetwork), ou -1.
+ * @param caps Capacidade residual para o vizinho em cada direção.
+ * @param capSource Capacidade residual da fonte para o pixel (idem capSink).
+ */
+class BandFlowNetwork {
+private:
+    std::vector<int> pixels;
+    std::vector<int> neighbours[4];
+    std::vector<int> caps[4];
+    std::vector<int> capSource, capSink;
+    std::vector<int> level;
+    std::vector<unsigned char> currentArc;
+    std::vector<int> queue;
+    std::vector<int> path;
+
+    int find(int pixel) const {
+        std::vector<int>::const_iterator it = std::lower_bound(pixels.begin(), pixels.end(), pixel);
+        return it != pixels.end() && *it == pixel ? static_cast<int>(it - pixels.begin()) : -1;
+    }
+
+    bool buildLevels() {
+        queue.clear();
+        for (int u = 0; u < size(); ++u) {
+            level[u] = -1;
+            currentArc[u] = 0;
+            if (capSource[u] > 0) {
+                level[u] = 1;
+                queue.push_back(u);
+            }
+        }
+
+        bool reachesSink = false;
+        for (size_t head = 0; head < queue.size(); ++head) {
+            int u = queue[head];
+            if (capSink[u] > 0) reachesSink = true;
+            for (int d = 0; d < 4; ++d) {
+                int v = neighbours[d][u];
+                if (caps[d][u] > 0 && level[v] < 0) {
+                    level[v] = level[u] + 1;
+                    queue.push_back(v);
+                }
+            }
+        }
+        return reachesSink;
+    }
+
+    /**
+     * @brief Como GridFlowNetwork::augmentFrom: busca em profundidade iterativa com arco atual a partir de um
+     * pixel de nível 1.
+     */
+    long long augmentFrom(int start, long long& paths) {
+        long long pushed = 0;
+        while (level[start] == 1 && capSource[start] > 0) {
+            path.clear();
+            path.push_back(start);
+
+            while (!path.empty()) {
+                int u = path.back();
+
+                if (capSink[u] > 0) {
+                    int bottleneck = std::min(capSource[start], capSink[u]);
+                    for (size_t i = 0; i + 1 < path.size(); ++i) {
+                        bottleneck = std::min(bottleneck, caps[currentArc[path[i]]][path[i]]);
+                    }
+
+                    capSource[start] -= bottleneck;
+                    capSink[u] -= bottleneck;
+                    size_t firstSaturated = path.size() - 1;
+                    for (size_t i = 0; i + 1 < path.size(); ++i) {
+                        int v = path[i];
+                        int d = currentArc[v];
+                        caps[d][v] -= bottleneck;
+                        caps[d ^ 1][neighbours[d][v]] += bottleneck;
+                        if (caps[d][v] == 0 && firstSaturated == path.size() - 1) {
+                            firstSaturated = i;
+                        }
+                    }
+                    pushed += bottleneck;
+                    TGC_STATS_ONLY(paths++);
+
+                    if (capSource[start] == 0) break;
+                    path.resize(firstSaturated + 1);
+                    continue;
+                }
+
+                bool advanced = false;
+                while (currentArc[u] < 4) {
+                    int d = currentArc[u];
+                    if (caps[d][u] > 0 && level[neighbours[d][u]] == level[u] + 1) {
+                        path.push_back(neighbours[d][u]);
+                        advanced = true;
+                        break;
+                    }
+                    currentArc[u]++;
+                }
+
+                if (!advanced) {
+                    level[u] = -1;
+                    path.pop_back();
+                    if (!path.empty()) currentArc[path.back()]++;
+                }
+            }
+        }
+        return pushed;
+    }
+
+public:
+    /**
+     * @param bandPixels Índices na grade dos pixels da faixa, em ordem crescente.
+     * @param width Largura da grade.
+     * @param height Altura da grade.
+     */
+    BandFlowNetwork(const std::vector<int>& bandPixels, int width, int height) : pixels(bandPixels) {
+        size_t n = pixels.size();
+        for (int d = 0; d < 4; ++d) {
+            neighbours[d].assign(n, -1);
+            caps[d].assign(n, 0);
+        }
+        capSource.assign(n, 0);
+        capSink.assign(n, 0);
+        level.assign(n, -1);
+        currentArc.assign(n, 0);
+
+        for (size_t u = 0; u < n; ++u) {
+            int x = pixels[u] % width, y = pixels[u] / width;
+            if (x + 1 < width && u + 1 < n && pixels[u + 1] == pixels[u] + 1) {
+                neighbours[GridFlowNetwork::RIGHT][u] = static_cast<int>(u + 1);
+                neighbours[GridFlowNetwork::LEFT][u + 1] = static_cast<int>(u);
+            }
+            if (y + 1 < height) {
+                int below = find(pixels[u] + width);
+                if (below >= 0) {
+                    neighbours[GridFlowNetwork::DOWN][u] = below;
+                    neighbours[GridFlowNetwork::UP][below] = static_cast<int>(u);
+                }
+            }
+        }
+    }
+
+    int size() const { return static_cast<int>(pixels.size()); }
+
+    /**
+     * @brief Índice na grade do pixel u da faixa.
+     */
+    int pixel(int u) const { return pixels[u]; }
+
+    /**
+     * @brief Verifica se o pixel u tem vizinho dentro da faixa na direção dada.
+     */
+    bool hasNeighbour(int u, GridFlowNetwork::Direction direction) const { return neighbours[direction][u] >= 0; }
+
+    /**
+     * @brief Define as capacidades das arestas terminais do pixel u da faixa.
+     */
+    void setTerminal(int u, int source, int sink) {
+        capSource[u] = source;
+        capSink[u] = sink;
+    }
+
+    /**
+     * @brief Define a capacidade da aresta de u para o vizinho da faixa na direção dada (que deve existir).
+     * Capacidades negativas contam como zero.
+     */
+    void setEdge(int u, GridFlowNetwork::Direction direction, int capacity) {
+        caps[direction][u] = std::max(0, capacity);
+    }
+
+    /**
+     * @brief Calcula o fluxo máximo da rede, a partir do fluxo zero.
+     * 
+     * @return Fluxo total enviado.
+     */
+    long long maxFlow() {
+        TGC_STATS_PHASE("flow");
+        long long total = 0, paths = 0, visits = 0;
+        for (int u = 0; u < size(); ++u) {
+            int direct = std::min(capSource[u], capSink[u]);
+            capSource[u] -= direct;
+            capSink[u] -= direct;
+            total += direct;
+        }
+        while (buildLevels()) {
+            TGC_STATS_ONLY(visits += queue.size());
+            for (int u = 0; u < size(); ++u) {
+                total += augmentFrom(u, paths);
+            }
+        }
+        TGC_STATS_ONLY(visits += queue.size());
+        TGC_STATS_COUNT("augmenting_paths", paths);
+        TGC_STATS_COUNT("bfs_visits", visits);
+        return total;
+    }
+
+    /**
+     * @brief Marca os pixels da faixa alcançáveis a partir da fonte no grafo residual (lado da fonte do corte).
+     * 
+     * @param reachable Recebe, na posição u, 1 para pixels do lado da fonte e 0 para os demais.
+     */
+    void sourceSide(std::vector<char>& reachable) {
+        TGC_STATS_PHASE("cut_bfs");
+        reachable.assign(size(), 0);
+        queue.clear();
+        for (int u = 0; u < size(); ++u) {
+            if (capSource[u] > 0) {
+                reachable[u] = 1;
+                queue.push_back(u);
+            }
+        }
+        for (size_t head = 0; head < queue.size(); ++head) {
+            int u = queue[head];
+            for (int d = 0; d < 4; ++d) {
+                int v = neighbours[d][u];
+                if (caps[d][u] > 0 && !reachable[v]) {
+                    reachable[v] = 1;
+                    queue.push_back(v);
+                }
+            }
+        }
+        TGC_STATS_COUNT("cut_bfs_visits", queue.size());
+    }
+};
+
+/**
+ * @brief Classe para leitura de arquivos de imagem (PPM, PNG ou JPEG).
+ */
+class ImageReader {
+public:
+    /**
+     * @brief Lê uma imagem no formato PPM e retorna os pixels e as dimensões.
+     * 
+     * @param filename Caminho do arquivo de imagem.
+     * @return Par contendo os pixels da imagem e as dimensões (largura e altura).
+     * @throws std::runtime_error Se o arquivo não puder ser aberto ou lido.
+     */
+    static std::pair<std::vector<Pixel>, std::pair<int, int> > readPPM(const std::string& filename) {
+        TGC_STATS_PHASE("read");
+        std::ifstream file(filename.c_str(), std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Cannot open file: " + filename);
+        }
+
+        std::string magic;
+        int width, height, maxVal;
+        file >> magic >> width >> height >> maxVal;
+        file.ignore(1); 
+        if (magic != "P6" || !file) {
+            throw std::runtime_error("Unsupported PPM file: " + filename);
+        }
+
+        std::vector<unsigned char> data(static_cast<size_t>(width) * height * 3, 0);
+        file.read(reinterpret_cast<char*>(data.data()), data.size());
+
+        std::vector<Pixel> pixels;
+        pixels.reserve(width * height);
+        for (size_t i = 0; i < data.size(); i += 3) {
+            pixels.push_back(Pixel(data[i], data[i + 1], data[i + 2]));
+        }
+
+        return std::make_pair(pixels, std::make_pair(width, height));
+    }
+
+    /**
+     * @brief Lê uma imagem PNG, JPEG ou PPM (o formato é reconhecido pelo conteúdo) e retorna os pixels e as
+     * dimensões, como readPPM.
+     * 
+     * @param filename Caminho do arquivo de imagem.
+     * @return Par contendo os pixels da imagem e as dimensões (largura e altura).
+     * @throws std::runtime_error Se o arquivo não puder ser lido ou o formato não for suportado.
+     */
+    static std::pair<std::vector<Pixel>, std::pair<int, int> > readImage(const std::string& filename) {
+        TGC_STATS_PHASE("read");
+        imageio::Image image = imageio::read(filename);
+
+        std::vector<Pixel> pixels;
+        pixels.reserve(static_cast<size_t>(image.width) * image.height);
+        for (size_t i = 0; i < image.rgb.size(); i += 3) {
+            pixels.push_back(Pixel(image.rgb[i], image.rgb[i + 1], image.rgb[i + 2]));
+        }
+
+        return std::make_pair(pixels, std::make_pair(image.width, image.height));
+    }
+};
+
+/**
+ * @brief Leitura de volumes 3-D por intervalos de fatias, sem carregar o volume inteiro.
+ * 
+ * Aceita dois formatos: um arquivo bruto (.raw, sem cabeçalho) de voxels de 8 bits em tons de cinza, fatia após
+ * fatia, com as dimensões informadas à parte, do qual só o trecho das fatias pedidas é mapeado na memória; ou uma
+ * pilha de imagens (PPM, PNG ou JPEG) do mesmo tamanho, um arquivo por fatia. Um voxel cinza v vira o pixel (v, v, v), de modo que
+ * capacidades e limiares são os mesmos das imagens.
+ * 
+ * @param slicePaths Arquivos das fatias, na ordem (vazio para volume bruto).
+ */
+class VolumeReader {
+private:
+    int width, height, depth;
+    std::vector<std::string> slicePaths;
+#ifdef _WIN32
+    std::ifstream file;
+    std::vector<unsigned char> buffer;
+#else
+    int fd;
+    void* mapping;
+    size_t mappingLength;
+
+    void unmap() {
+        if (mapping != NULL) {
+            munmap(mapping, mappingLength);
+            mapping = NULL;
+        }
+    }
+#endif
+
+    /**
+     * @brief Dá acesso aos bytes das fatias [z0, z1) do volume bruto.
+     * 
+     * @return Ponteiro válido até a próxima chamada.
+     */
+    const unsigned char* rawSlices(int z0, int z1) {
+        size_t slice = static_cast<size_t>(width) * height;
+        size_t length = (z1 - z0) * slice;
+        std::streamoff offset = static_cast<std::streamoff>(z0 * slice);
+#ifdef _WIN32
+        buffer.resize(length);
+        file.seekg(offset);
+        if (!file.read(reinterpret_cast<char*>(buffer.data()), length)) {
+            throw std::runtime_error("Unexpected end of volume data.");
+        }
+        return buffer.data();
+#else
+        unmap();
+        static const long pageSize = sysconf(_SC_PAGESIZE);
+        std::streamoff aligned = offset - offset % pageSize;
+        size_t delta = static_cast<size_t>(offset - aligned);
+
+        mappingLength = length + delta;
+        mapping = mmap(NULL, mappingLength, PROT_READ, MAP_PRIVATE, fd, aligned);
+        if (mapping == MAP_FAILED) {
+            mapping = NULL;
+            throw std::runtime_error("Cannot map volume data.");
+        }
+        return static_cast<const unsigned char*>(mapping) + delta;
+#endif
+    }
+
+public:
+    /**
+     * @brief Abre um volume bruto de largura x altura x profundidade voxels de 8 bits.
+     * 
+     * @throws std::runtime_error Se o arquivo não puder ser aberto ou for menor que o volume.
+     */
+    VolumeReader(const std::string& rawPath, int w, int h, int d) : width(w), height(h), depth(d) {
+        std::ifstream probe(rawPath.c_str(), std::ios::binary | std::ios::ate);
+        if (!probe.is_open()) {
+            throw std::runtime_error("Cannot open file: " + rawPath);
+        }
+        if (w <= 0 || h <= 0 || d <= 0
+            || static_cast<long long>(probe.tellg()) < static_cast<long long>(w) * h * d) {
+            throw std::runtime_error("Volume file smaller than " + std::to_string(w) + "x" + std::to_string(h) + "x"
+                                     + std::to_string(d) + " voxels: " + rawPath);
+        }
+#ifdef _WIN32
+        file.open(rawPath.c_str(), std::ios::binary);
+#else
+        mapping = NULL;
+        mappingLength = 0;
+        fd = open(rawPath.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open file: " + rawPath);
+        }
+#endif
+    }
+
+    /**
+     * @brief Usa uma pilha de imagens como volume; as dimensões das fatias saem da primeira.
+     * 
+     * @throws std::runtime_error Se a lista estiver vazia ou a primeira fatia não puder ser lida.
+     */
+    explicit VolumeReader(const std::vector<std::string>& slices)
+        : width(0), height(0), depth(static_cast<int>(slices.size())), slicePaths(slices) {
+        if (slices.empty()) {
+            throw std::runtime_error("No slices given for the volume.");
+        }
+        std::pair<std::vector<Pixel>, std::pair<int, int> > first = ImageReader::readImage(slices[0]);
+        width = first.second.first;
+        height = first.second.second;
+#ifndef _WIN32
+        fd = -1;
+        mapping = NULL;
+        mappingLength = 0;
+#endif
+    }
+
+    ~VolumeReader() {
+#ifndef _WIN32
+        unmap();
+        if (fd >= 0) close(fd);
+#endif
+    }
+
+    VolumeReader(const VolumeReader&) = delete;
+    VolumeReader& operator=(const VolumeReader&) = delete;
+
+    /**
+     * @brief Lê as fatias [z0, z1), uma após a outra.
+     * 
+     * @throws std::runtime_error Se alguma fatia não puder ser lida ou tiver outro tamanho.
+     */
+    std::vector<Pixel> readSlices(int z0, int z1) {
+        TGC_STATS_PHASE("read");
+        size_t slice = static_cast<size_t>(width) * height;
+        std::vector<Pixel> voxels;
+        voxels.reserve((z1 - z0) * slice);
+
+        if (slicePaths.empty()) {
+            const unsigned char* gray = rawSlices(z0, z1);
+            for (size_t i = 0; i < (z1 - z0) * slice; ++i) {
+                voxels.push_back(Pixel(gray[i], gray[i], gray[i]));
+            }
+            return voxels;
+        }
+
+        for (int z = z0; z < z1; ++z) {
+            std::pair<std::vector<Pixel>, std::pair<int, int> > image = ImageReader::readImage(slicePaths[z]);
+            if (image.second.first != width || image.second.second != height) {
+                throw std::runtime_error("Slice with a different size: " + slicePaths[z]);
+            }
+            voxels.insert(voxels.end(), image.first.begin(), image.first.end());
+        }
+        return voxels;
+    }
+
+    int getWidth() const { return width; }
+
+    int getHeight() const { return height; }
+
+    int getDepth() const { return depth; }
+};
+/**
+ * @brief Classe para salvar imagens segmentadas em PNG ou PPM.
+ */
+class ImageWriter {
+public:
+    /**
+     * @function ImageWriter::saveSegmentationImage
+     * @brief Salva a segmentação de uma imagem em PNG, ou em PPM se o caminho terminar em ".ppm".
+     * 
+     * @param segmentation Segmentação resultante (conjuntos de índices de pixels).
+     * @param vertices Vetor de pixels do grafo.
+     * @param width Largura da imagem.
+     * @param height Altura da imagem.
+     * @param outputPath Caminho do arquivo de saída.
+     * @throws std::runtime_error Se o arquivo de saída não puder ser criado.
+     */
+    static void saveSegmentationImage(
+        const std::vector<std::vector<int> >& segmentation, 
+        const std::vector<Pixel>& vertices,
+        int width, int height,
+        const std::string& outputPath
+    ) {
+        TGC_STATS_PHASE("write");
+        std::vector<unsigned char> outputPixels(static_cast<size_t>(width) * height * 3, 0);
+        
+        std::vector<Pixel> componentColors;
+        std::srand(static_cast<unsigned int>(std::time(NULL))); 
+        
+        for (size_t i = 0; i < segmentation.size(); ++i) {
+            componentColors.push_back(Pixel(
+                static_cast<unsigned char>(std::rand() % 256),
+                static_cast<unsigned char>(std::rand() % 256),
+                static_cast<unsigned char>(std::rand() % 256)
+            ));
+        }
+        
+        for (size_t colorIndex = 0; colorIndex < segmentation.size(); ++colorIndex) {
+            for (size_t j = 0; j < segmentation[colorIndex].size(); ++j) {
+                size_t pixel = static_cast<size_t>(segmentation[colorIndex][j]) * 3;
+                outputPixels[pixel] = componentColors[colorIndex].r;
+                outputPixels[pixel + 1] = componentColors[colorIndex].g;
+                outputPixels[pixel + 2] = componentColors[colorIndex].b;
+            }
+        }
+        
+        imageio::write(outputPath, width, height, outputPixels.data());
+    }
+};
+/**
+ * @brief Classe para realizar segmentação de imagem utilizando um grafo de fluxo.
+ * 
+ * @param flowNetwork Rede de fluxo em grade associada à imagem.
+ * @param width Largura da imagem.
+ * @param height Altura da imagem.
+ * @param pixels Vetor de pixels da imagem.
+ * @param features Planos de atributos dos pixels, de onde saem as capacidades.
+ * @param threads Número de threads usadas no fluxo máximo.
+ * @param networkReady Indica se a rede já foi montada e guarda o fluxo de uma segmentação anterior.
+ * @param currentForeground Limiar de primeiro plano com que a rede está configurada (idem currentBackground).
+ */
+class ImageSegmentation {
+private:
+    GridFlowNetwork flowNetwork;
+    int width, height;
+    std::vector<Pixel> pixels;
+    PixelFeatures features;
+    int threads;
+    bool networkReady;
+    double currentForeground, currentBackground;
+
+    /**
+     * @brief Capacidades das arestas terminais de um pixel para os limiares dados.
+     */
+    static void terminalCapacities(const Pixel& pixel, const IntensityCutoffs& cutoffs, int& source, int& sink) {
+        int sum = pixel.r + pixel.g + pixel.b;
+        source = cutoffs.source(sum);
+        sink = cutoffs.sink(sum);
+    }
+
+    static const int MIN_PYRAMID_SIDE = 32;
+
+    /**
+     * @brief Capacidade da aresta entre dois pixels vizinhos (zero quando a diferença passa de 100).
+     */
+    static int neighbourCapacity(const Pixel& a, const Pixel& b) {
+        return PixelFeatures::capacityBetween(a, b);
+    }
+
+    /**
+     * @brief Reduz a imagem à metade em cada dimensão, com a média de cada bloco 2x2 (na borda o bloco pode ter
+     * menos pixels).
+     */
+    static std::vector<Pixel> downsample(const std::vector<Pixel>& image, int w, int h, int& halfWidth,
+                                         int& halfHeight) {
+        halfWidth = (w + 1) / 2;
+        halfHeight = (h + 1) / 2;
+        std::vector<Pixel> half(halfWidth * halfHeight);
+
+        for (int y = 0; y < halfHeight; ++y) {
+            for (int x = 0; x < halfWidth; ++x) {
+                int r = 0, g = 0, b = 0, count = 0;
+                for (int yy = 2 * y; yy < std::min(h, 2 * y + 2); ++yy) {
+                    for (int xx = 2 * x; xx < std::min(w, 2 * x + 2); ++xx) {
+                        const Pixel& pixel = image[yy * w + xx];
+                        r += pixel.r;
+                        g += pixel.g;
+                        b += pixel.b;
+                        count++;
+                    }
+                }
+                half[y * halfWidth + x] = Pixel(static_cast<unsigned char>((r + count / 2) / count),
+                                                static_cast<unsigned char>((g + count / 2) / count),
+                                                static_cast<unsigned char>((b + count / 2) / count));
+            }
+        }
+        return half;
+    }
+
+    /**
+     * @brief Refina num nível mais fino o corte obtido no nível de baixo.
+     * 
+     * Cada pixel herda o rótulo do pixel grosso correspondente; só os pixels a até bandWidth passos (4-conexos)
+     * de uma fronteira entre rótulos entram na rede. Os demais ficam fixos: uma aresta de um pixel fixo do lado
+     * da fonte para um pixel da faixa vira aresta fonte -> pixel, e uma aresta de um pixel da faixa para um fixo
+     * do lado do sumidouro vira aresta pixel -> sumidouro, o que preserva o custo de cada corte.
+     * 
+     * A rede é uma BandFlowNetwork só com os pixels da faixa. O que ainda cobre o nível inteiro são os rótulos e a
+     * distância de cada pixel à fronteira, um byte por pixel cada.
+     * 
+     * @param image Pixels do nível fino.
+     * @param w Largura do nível fino.
+     * @param h Altura do nível fino.
+     * @param coarseLabels Rótulos do nível grosso (1 = primeiro plano).
+     * @param coarseWidth Largura do nível grosso.
+     * @return Rótulos do nível fino.
+     */
+    static std::vector<char> refineBand(const std::vector<Pixel>& image, int w, int h,
+                                        const std::vector<char>& coarseLabels, int coarseWidth,
+                                        double foregroundThreshold, double backgroundThreshold, int bandWidth) {
+        std::vector<char> labels(w * h);
+        for (int y = 0; y < h; ++y) {
+            for (int x = 0; x < w; ++x) {
+                labels[y * w + x] = coarseLabels[(y / 2) * coarseWidth + x / 2];
+            }
+        }
+
+        const int dx[4] = {1, -1, 0, 0};
+        const int dy[4] = {0, 0, 1, -1};
+        std::vector<unsigned char> distance(w * h, 255);
+        std::vector<int> nodes;
+        for (int y = 0; y < h; ++y) {
+            for (int x = 0; x < w; ++x) {
+                int p = y * w + x;
+                bool boundary = (x + 1 < w && labels[p + 1] != labels[p]) || (x > 0 && labels[p - 1] != labels[p])
+                                || (y + 1 < h && labels[p + w] != labels[p]) || (y > 0 && labels[p - w] != labels[p]);
+                if (boundary) {
+                    distance[p] = 0;
+                    nodes.push_back(p);
+                }
+            }
+        }
+        for (size_t head = 0; head < nodes.size(); ++head) {
+            int p = nodes[head];
+            if (distance[p] >= bandWidth) continue;
+            for (int d = 0; d < 4; ++d) {
+                int x = p % w + dx[d], y = p / w + dy[d];
+                if (x < 0 || x >= w || y < 0 || y >= h || distance[y * w + x] != 255) continue;
+                distance[y * w + x] = distance[p] + 1;
+                nodes.push_back(y * w + x);
+            }
+        }
+        if (nodes.empty()) return labels;
+
+        std::sort(nodes.begin(), nodes.end());
+        BandFlowNetwork network(nodes, w, h);
+        IntensityCutoffs cutoffs(foregroundThreshold, backgroundThreshold);
+        for (int u = 0; u < network.size(); ++u) {
+            int p = network.pixel(u);
+            int source, sink;
+            terminalCapacities(image[p], cutoffs, source, sink);
+
+            for (int d = 0; d < 4; ++d) {
+                int x = p % w + dx[d], y = p / w + dy[d];
+                if (x < 0 || x >= w || y < 0 || y >= h) continue;
+
+                GridFlowNetwork::Direction direction = static_cast<GridFlowNetwork::Direction>(d);
+                int capacity = neighbourCapacity(image[p], image[y * w + x]);
+                bool outgoing = d == GridFlowNetwork::LEFT || d == GridFlowNetwork::UP;
+                if (network.hasNeighbour(u, direction)) {
+                    if (outgoing) network.setEdge(u, direction, capacity);
+                } else if (labels[y * w + x] && !outgoing) {
+                    source += capacity;
+                } else if (!labels[y * w + x] && outgoing) {
+                    sink += capacity;
+                }
+            }
+            network.setTerminal(u, source, sink);
+        }
+
+        network.maxFlow();
+        std::vector<char> reachable;
+        network.sourceSide(reachable);
+        for (int u = 0; u < network.size(); ++u) {
+            labels[network.pixel(u)] = reachable[u];
+        }
+        return labels;
+    }
+
+public:
+    /**
+     * @brief Construtor que inicializa o grafo de fluxo e armazena os pixels da imagem.
+     * 
+     * @param w Largura da imagem.
+     * @param h Altura da imagem.
+     * @param imgPixels Vetor de pixels da imagem.
+     */
+    ImageSegmentation(int w, int h, const std::vector<Pixel>& imgPixels) 
+        : flowNetwork(w, h), width(w), height(h), pixels(imgPixels), features(imgPixels, w, h), threads(1),
+          networkReady(false), currentForeground(0), currentBackground(0) {}
+
+    /**
+     * @brief Define quantas threads o fluxo máximo usa (1 = sequencial). O corte resultante não depende disso.
+     */
+    void setThreads(int n) {
+        threads = std::max(1, n);
+    }
+
+    /**
+     * @brief Configura a rede de fluxo com base nos pixels da imagem e nos limiares de intensidade.
+     * 
+     * As capacidades saem dos planos de atributos, direto para os vetores da rede.
+     * 
+     * @param foregroundThreshold Limiar para determinar pixels do primeiro plano.
+     * @param backgroundThreshold Limiar para determinar pixels do fundo.
+     */
+    void setupFlowNetwork(double foregroundThreshold, double backgroundThreshold) {
+        TGC_STATS_PHASE("graph_build");
+        flowNetwork.build(features, IntensityCutoffs(foregroundThreshold, backgroundThreshold));
+        TGC_STATS_COUNT("edges", 2 * (2 * width * height - width - height) + 2 * width * height);
+
+        networkReady = true;
+        currentForeground = foregroundThreshold;
+        currentBackground = backgroundThreshold;
+    }
+
+    /**
+     * @brief Troca os limiares de uma rede já resolvida, alterando só as arestas terminais dos pixels cuja
+     * classificação mudou. As arestas entre vizinhos não dependem dos limiares e o fluxo anterior é mantido.
+     * 
+     * @param foregroundThreshold Novo limiar de primeiro plano.
+     * @param backgroundThreshold Novo limiar de fundo.
+     * @return Número de pixels cujas arestas terminais mudaram.
+     */
+    int updateThresholds(double foregroundThreshold, double backgroundThreshold) {
+        TGC_STATS_PHASE("graph_update");
+        IntensityCutoffs before(currentForeground, currentBackground);
+        IntensityCutoffs after(foregroundThreshold, backgroundThreshold);
+        int changed = 0;
+        for (int i = 0; i < width * height; ++i) {
+            int sum = features.intensitySum(i);
+            int source = after.source(sum), sink = after.sink(sum);
+            if (source != before.source(sum) || sink != before.sink(sum)) {
+                flowNetwork.updateTerminal(i, source, sink);
+                changed++;
+            }
+        }
+
+        currentForeground = foregroundThreshold;
+        currentBackground = backgroundThreshold;
+        TGC_STATS_COUNT("terminals_updated", changed);
+        return changed;
+    }
+    /**
+     * @brief Troca a imagem por outro quadro do mesmo tamanho (modo sequência). Numa rede já resolvida, só as
+     * arestas cuja capacidade mudou são alteradas (updateEdge/updateTerminal) e o fluxo do quadro anterior é
+     * mantido, de modo que o próximo segment parte dele; entre quadros quase iguais isso custa bem menos que montar
+     * e resolver a rede de novo. O corte é o mesmo de uma segmentação nova do quadro.
+     * 
+     * @param frame Pixels do novo quadro.
+     * @return Número de arestas (terminais ou entre vizinhos) alteradas.
+     * @throws std::runtime_error Se o quadro tiver outro tamanho.
+     */
+    long long updateFrame(const std::vector<Pixel>& frame) {
+        if (frame.size() != pixels.size()) {
+            throw std::runtime_error("Frame with a different size.");
+        }
+        PixelFeatures next(frame, width, height);
+        pixels = frame;
+        if (!networkReady) {
+            features = next;
+            return 0;
+        }
+
+        TGC_STATS_PHASE("graph_update");
+        IntensityCutoffs cutoffs(currentForeground, currentBackground);
+        std::vector<int> before(width), after(width);
+        long long changed = 0;
+        for (int y = 0; y < height; ++y) {
+            int row = y * width;
+            for (int x = 0; x < width; ++x) {
+                int sum = next.intensitySum(row + x);
+                if (sum != features.intensitySum(row + x)) {
+                    flowNetwork.updateTerminal(row + x, cutoffs.source(sum), cutoffs.sink(sum));
+                    changed++;
+                }
+            }
+
+            for (int pass = 0; pass < 2; ++pass) {
+                if (pass == 1 && y == 0) break;
+                GridFlowNetwork::Direction direction = pass == 0 ? GridFlowNetwork::LEFT : GridFlowNetwork::UP;
+                if (pass == 0) {
+                    features.horizontalCapacities(y, before.data());
+                    next.horizontalCapacities(y, after.data());
+                } else {
+                    features.verticalCapacities(y, before.data());
+                    next.verticalCapacities(y, after.data());
+                }
+                for (int x = 0; x < width; ++x) {
+                    if (after[x] != before[x]) {
+                        flowNetwork.updateEdge(row + x, direction, after[x]);
+                        changed++;
+                    }
+                }
+            }
+        }
+        features = next;
+        TGC_STATS_COUNT("edges_updated", changed);
+        return changed;
+    }
+
+    /**
+     * @brief Realiza a segmentação da imagem utilizando corte mínimo.
+     * 
+     * A primeira chamada monta a rede; as seguintes só atualizam as arestas terminais e continuam a partir do
+     * fluxo anterior, o que torna barato reajustar os limiares.
+     * 
+     * @param foregroundThreshold Limiar para pixels do primeiro plano.
+     * @param backgroundThreshold Limiar para pixels do fundo.
+     * @return Segmentação resultante como dois conjuntos de pixels.
+     */
+    std::vector<std::vector<int> > segment(double foregroundThreshold, double backgroundThreshold) {
+        if (networkReady) {
+            updateThresholds(foregroundThreshold, backgroundThreshold);
+        } else {
+            setupFlowNetwork(foregroundThreshold, backgroundThreshold);
+        }
+        flowNetwork.maxFlow(threads);
+        return cutSegmentation();
+    }
+
+    /**
+     * @brief Segmentação do grosso para o fino: resolve o corte numa versão reduzida da imagem e, a cada nível
+     * mais fino, só refaz o corte numa faixa estreita em torno da fronteira herdada. O tamanho da rede em cada
+     * nível passa a ser proporcional ao comprimento da fronteira, não à área.
+     * 
+     * O resultado é uma aproximação: detalhes menores que o nível mais grosso podem se perder.
+     * 
+     * @param foregroundThreshold Limiar para pixels do primeiro plano.
+     * @param backgroundThreshold Limiar para pixels do fundo.
+     * @param levels Número de níveis da pirâmide, contando a resolução original.
+     * @param bandWidth Largura da faixa refinada em cada nível, em pixels.
+     * @return Segmentação resultante como dois conjuntos de pixels.
+     */
+    std::vector<std::vector<int> > segmentMultiresolution(double foregroundThreshold, double backgroundThreshold,
+                                                          int levels, int bandWidth = 2) {
+        std::vector<std::vector<Pixel> > pyramid(1, pixels);
+        std::vector<int> widths(1, width), heights(1, height);
+        while (static_cast<int>(pyramid.size()) < levels
+               && widths.back() >= 2 * MIN_PYRAMID_SIDE && heights.back() >= 2 * MIN_PYRAMID_SIDE) {
+            int w, h;
+            pyramid.push_back(downsample(pyramid.back(), widths.back(), heights.back(), w, h));
+            widths.push_back(w);
+            heights.push_back(h);
+        }
+
+        ImageSegmentation coarse(widths.back(), heights.back(), pyramid.back());
+        coarse.setThreads(threads);
+        std::vector<std::vector<int> > coarseCut = coarse.segment(foregroundThreshold, backgroundThreshold);
+        std::vector<char> labels(widths.back() * heights.back(), 0);
+        for (size_t i = 0; i < coarseCut[0].size(); ++i) {
+            labels[coarseCut[0][i]] = 1;
+        }
+
+        for (int level = static_cast<int>(pyramid.size()) - 2; level >= 0; --level) {
+            labels = refineBand(pyramid[level], widths[level], heights[level], labels, widths[level + 1],
+                                foregroundThreshold, backgroundThreshold, bandWidth);
+        }
+
+        std::vector<std::vector<int> > segmentation(2);
+        for (int i = 0; i < width * height; ++i) {
+            segmentation[labels[i] ? 0 : 1].push_back(i);
+        }
+        return segmentation;
+    }
+
+    /**
+     * @brief Separa os pixels pelo corte mínimo da rede já resolvida.
+     * 
+     * @return Dois conjuntos de pixels: lado da fonte (primeiro plano) e lado do sumidouro (fundo).
+     */
+    std::vector<std::vector<int> > cutSegmentation() {
+        std::vector<char> reachable;
+        flowNetwork.sourceSide(reachable);
+
+        std::vector<std::vector<int> > segmentation(2);
+        for (int i = 0; i < width * height; ++i) {
+            segmentation[reachable[i] ? 0 : 1].push_back(i);
+        }
+        return segmentation;
+    }
+
+    const GridFlowNetwork& getFlowNetwork() const {
+        return flowNetwork;
+    }
+
+    const std::vector<Pixel>& getPixels() const {
+        return pixels;
+    }
+};
+
+/**
+ * @brief Segmentação de volumes por corte mínimo, um bloco de fatias (slab) por vez.
+ * 
+ * O volume é percorrido em blocos de slabDepth fatias. Cada bloco é resolvido numa rede 6-conexa própria, com halo
+ * fatias a mais de cada lado; só os rótulos das fatias do bloco são escritos, e a rede é descartada antes do bloco
+ * seguinte. A memória fica limitada a slabDepth + 2 * halo fatias (cerca de 60 bytes por voxel), qualquer que seja
+ * a profundidade do volume.
+ * 
+ * As fatias do halo fazem o papel do resto do volume. O corte de um bloco só difere do corte do volume inteiro
+ * quando fluxo relevante precisaria atravessar mais de halo fatias; com slabDepth igual à profundidade o resultado
+ * é o corte exato.
+ * 
+ * @param volume Fonte das fatias.
+ * @param slabDepth Fatias escritas por bloco.
+ * @param halo Fatias de contexto acrescentadas antes e depois de cada bloco.
+ * @param threads Número de threads usadas no fluxo máximo de cada bloco.
+ */
+class VolumeSegmentation {
+private:
+    VolumeReader& volume;
+    int slabDepth, halo;
+    int threads;
+
+public:
+    VolumeSegmentation(VolumeReader& source, int slab = 16, int haloSlices = 4)
+        : volume(source), slabDepth(std::max(1, slab)), halo(std::max(0, haloSlices)), threads(1) {}
+
+    /**
+     * @brief Define quantas threads o fluxo máximo de cada bloco usa (1 = sequencial).
+     */
+    void setThreads(int n) {
+        threads = std::max(1, n);
+    }
+
+    /**
+     * @brief Segmenta o volume e grava os rótulos como volume bruto de 8 bits (255 = primeiro plano, 0 = fundo),
+     * fatia após fatia, com as mesmas dimensões da entrada.
+     * 
+     * @param foregroundThreshold Limiar para voxels do primeiro plano.
+     * @param backgroundThreshold Limiar para voxels do fundo.
+     * @param outputPath Caminho do volume de rótulos.
+     * @return Número de voxels do primeiro plano.
+     * @throws std::runtime_error Se o volume não puder ser lido ou a saída não puder ser criada.
+     */
+    long long segment(double foregroundThreshold, double backgroundThreshold, const std::string& outputPath) {
+        std::ofstream output(outputPath.c_str(), std::ios::binary);
+        if (!output.is_open()) {
+            throw std::runtime_error("Error creating output file.");
+        }
+
+        const int width = volume.getWidth(), height = volume.getHeight(), depth = volume.getDepth();
+        const int slice = width * height;
+        IntensityCutoffs cutoffs(foregroundThreshold, backgroundThreshold);
+        std::vector<char> reachable;
+        std::vector<char> labels(slice);
+        long long foreground = 0;
+
+        for (int z0 = 0; z0 < depth; z0 += slabDepth) {
+            int z1 = std::min(depth, z0 + slabDepth);
+            int first = std::max(0, z0 - halo), last = std::min(depth, z1 + halo);
+            int slices = last - first;
+
+            GridFlowNetwork network(width, height, slices);
+            {
+                std::vector<Pixel> voxels = volume.readSlices(first, last);
+                TGC_STATS_PHASE("graph_build");
+                network.build(PixelFeatures(voxels, width, height, slices), cutoffs);
+                TGC_STATS_COUNT("edges", 2 * (3LL * slice * slices - slice - width * slices - height * slices)
+                                             + 2LL * slice * slices);
+            }
+            network.maxFlow(threads);
+            network.sourceSide(reachable);
+
+            TGC_STATS_PHASE("write");
+            for (int z = z0; z < z1; ++z) {
+                const char* side = &reachable[static_cast<size_t>(z - first) * slice];
+                for (int i = 0; i < slice; ++i) {
+                    labels[i] = side[i] ? static_cast<char>(255) : 0;
+                    foreground += side[i] != 0;
+                }
+                output.write(labels.data(), slice);
+            }
+            TGC_STATS_COUNT("slabs", 1);
+        }
+
+        if (!output) {
+            throw std::runtime_error("Error writing output file.");
+        }
+        return foreground;
+    }
+};
+
+/**
+ * @brief Deve mudar quando uma alteração mudar os cortes produzidos, para que entradas antigas do cache deixem de valer.
+ */
+const char* const CACHE_VERSION = "FordFulkerson/1";
+
+/**
+ * @brief Chave de cache de um corte: pixels, limiares, níveis da pirâmide e versão do programa.
+ */
+uint64_t cutKey(const std::vector<Pixel>& pixels, int width, int height, double foregroundThreshold,
+                double backgroundThreshold, int levels) {
+    cache::Hasher hasher;
+    hasher.add(CACHE_VERSION).add(width).add(height);
+    for (size_t i = 0; i < pixels.size(); ++i) {
+        unsigned char rgb[3] = {pixels[i].r, pixels[i].g, pixels[i].b};
+        hasher.update(rgb, 3);
+    }
+    hasher.add(foregroundThreshold).add(backgroundThreshold).add(levels);
+    return hasher.digest();
+}
+
+/**
+ * @brief Procura um corte no cache (se houver um). Num acerto a rede de fluxo nem chega a ser montada.
+ * 
+ * @param segmentation Recebe os dois conjuntos de pixels (primeiro plano e fundo) em caso de acerto.
+ * @return true se o corte estava no cache.
+ */
+bool findCachedCut(const cache::ResultCache* results, uint64_t key, int width, int height,
+                   std::vector<std::vector<int> >& segmentation) {
+    if (results == NULL) return false;
+    TGC_STATS_PHASE("cache");
+    std::optional<cache::Labels> rotulos = results->find(key);
+    if (!rotulos || rotulos->width() != width || rotulos->height() != height) return false;
+    TGC_STATS_COUNT("cache_hits", 1);
+    segmentation.assign(2, std::vector<int>());
+    for (size_t i = 0; i < rotulos->size(); ++i) {
+        segmentation[rotulos->at(i) == 1 ? 0 : 1].push_back(static_cast<int>(i));
+    }
+    return true;
+}
+
+/**
+ * @brief Guarda um corte no cache (se houver um), com rótulo 1 no primeiro plano e 0 no fundo.
+ */
+void storeCut(const cache::ResultCache* results, uint64_t key, int width, int height,
+              const std::vector<std::vector<int> >& segmentation) {
+    if (results == NULL) return;
+    TGC_STATS_PHASE("cache");
+    std::vector<uint32_t> rotulos(static_cast<size_t>(width) * height, 0);
+    for (size_t i = 0; i < segmentation[0].size(); ++i) {
+        rotulos[segmentation[0][i]] = 1;
+    }
+    results->store(key, width, height, rotulos.data());
+}
+
+/**
+ * @brief Uma imagem em trânsito pelo pipeline do modo em lote.
+ */
+struct BatchJob {
+    std::string inputPath;
+    int width;
+    int height;
+    std::vector<Pixel> pixels;
+    uint64_t cacheKey;
+    bool cached;
+    std::vector<std::vector<int> > segmentation;
+};
+
+/**
+ * @brief Modo em lote ("--batch diretorioSaida entrada..."): segmenta todos os PPMs informados (arquivos ou
+ * diretórios) num pipeline limitado de estágios leitura -> corte mínimo -> escrita. Cada estágio tem suas threads
+ * e as filas entre eles têm duas posições, então a leitura da imagem N+1 se sobrepõe ao corte da imagem N sem
+ * acumular imagens na memória.
+ * 
+ * Com um cache, a leitura já procura o corte de cada imagem; as que estão no cache passam direto para a escrita.
+ * 
+ * @return 0 se todas as imagens foram segmentadas; 1 caso contrário.
+ */
+int runBatch(int argc, char* argv[], const std::string& extensao, const cache::ResultCache* results) {
+    if (argc < 4) {
+        std::cerr << "Uso: " << argv[0] << " --batch <diretorioSaida> <imagem|diretorio>... [--format png|ppm]\n";
+        return 1;
+    }
+    std::string diretorioSaida = argv[2];
+    std::vector<std::string> entradas =
+        pipeline::collectInputs(std::vector<std::string>(argv + 3, argv + argc), imageio::inputExtensions());
+
+    const size_t posicoesFila = 2;
+    int trabalhadoresCorte = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 2);
+
+    typedef std::unique_ptr<BatchJob> Job;
+    pipeline::BoundedQueue<std::string> caminhos(entradas.size() + 1);
+    pipeline::BoundedQueue<Job> lidas(posicoesFila), segmentadas(posicoesFila);
+
+    std::mutex saidaMutex;
+    std::atomic<int> falhas(0);
+    auto aoFalhar = [&](const std::string& mensagem) {
+        std::lock_guard<std::mutex> lock(saidaMutex);
+        std::cerr << "Erro: " << mensagem << std::endl;
+        falhas++;
+    };
+
+    std::vector<std::vector<std::thread> > estagios;
+    estagios.push_back(pipeline::startStage(1, caminhos, lidas, [results](std::string caminho) {
+        std::pair<std::vector<Pixel>, std::pair<int, int> > imageData = ImageReader::readImage(caminho);
+        Job job(new BatchJob());
+        job->inputPath = caminho;
+        job->width = imageData.second.first;
+        job->height = imageData.second.second;
+        job->pixels.swap(imageData.first);
+        job->cacheKey = results != NULL ? cutKey(job->pixels, job->width, job->height, 180, 150, 1) : 0;
+        job->cached = findCachedCut(results, job->cacheKey, job->width, job->height, job->segmentation);
+        return job;
+    }, aoFalhar));
+    estagios.push_back(pipeline::startStage(trabalhadoresCorte, lidas, segmentadas, [results](Job job) {
+        if (job->cached) return job;
+        ImageSegmentation segmenter(job->width, job->height, job->pixels);
+        job->segmentation = segmenter.segment(180, 150);
+        storeCut(results, job->cacheKey, job->width, job->height, job->segmentation);
+        return job;
+    }, aoFalhar));
+    estagios.push_back(pipeline::startSink(1, segmentadas, [&](Job job) {
+        std::string caminhoSaida = pipeline::outputPathFor(diretorioSaida, job->inputPath, "_segmented" + extensao);
+        ImageWriter::saveSegmentationImage(job->segmentation, job->pixels, job->width, job->height, caminhoSaida);
+
+        std::lock_guard<std::mutex> lock(saidaMutex);
+        std::cout << job->inputPath << " -> " << caminhoSaida << (job->cached ? " (cache)" : "") << std::endl;
+    }, aoFalhar));
+
+    for (size_t i = 0; i < entradas.size(); ++i) {
+        caminhos.push(entradas[i]);
+    }
+    caminhos.close();
+    pipeline::joinAll(estagios);
+
+    return falhas == 0 ? 0 : 1;
+}
+
+/**
+ * @brief Modo volume ("--volume saida.raw (entrada.raw largura altura profundidade | fatia|diretorio...)"):
+ * segmenta um volume 3-D bruto de 8 bits ou uma pilha de imagens (uma por fatia, em ordem alfabética quando vier um
+ * diretório) e grava os rótulos como volume bruto. Opções: --slab n (fatias por bloco, padrão 16), --halo n (fatias
+ * de contexto, padrão 4) e --threads n.
+ * 
+ * @return 0 em caso de sucesso; 1 caso contrário.
+ */
+int runVolume(int argc, char* argv[]) {
+    int slab = 16, halo = 4, threads = 1;
+    std::vector<std::string> argumentos;
+    for (int i = 2; i < argc; ++i) {
+        std::string argumento = argv[i];
+        if ((argumento == "--slab" || argumento == "--halo" || argumento == "--threads") && i + 1 < argc) {
+            int valor = std::atoi(argv[++i]);
+            if (argumento == "--slab") slab = valor;
+            else if (argumento == "--halo") halo = valor;
+            else threads = valor;
+        } else {
+            argumentos.push_back(argumento);
+        }
+    }
+
+    bool bruto = argumentos.size() == 5 && std::filesystem::path(argumentos[1]).extension() == ".raw";
+    if (argumentos.size() < 2 || (std::filesystem::path(argumentos[1]).extension() == ".raw" && !bruto)) {
+        std::cerr << "Uso: " << argv[0] << " --volume <saida.raw> <entrada.raw> <largura> <altura> <profundidade>\n"
+                  << "       " << argv[0] << " --volume <saida.raw> <fatia|diretorio>...\n"
+                  << "Opções: --slab <fatias> --halo <fatias> --threads <n>\n";
+        return 1;
+    }
+
+    try {
+        std::unique_ptr<VolumeReader> volume;
+        if (bruto) {
+            volume.reset(new VolumeReader(argumentos[1], std::atoi(argumentos[2].c_str()),
+                                          std::atoi(argumentos[3].c_str()), std::atoi(argumentos[4].c_str())));
+        } else {
+            volume.reset(new VolumeReader(
+                pipeline::collectInputs(std::vector<std::string>(argumentos.begin() + 1, argumentos.end()),
+                                        imageio::inputExtensions())));
+        }
+
+        VolumeSegmentation segmenter(*volume, slab, halo);
+        segmenter.setThreads(threads);
+        long long primeiroPlano = segmenter.segment(180, 150, argumentos[0]);
+
+        std::cout << "Volume " << volume->getWidth() << "x" << volume->getHeight() << "x" << volume->getDepth()
+                  << ": " << primeiroPlano << " voxels no primeiro plano -> " << argumentos[0] << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Erro: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Modo sequência ("--sequence diretorioSaida quadro|diretorio... [--threads n] [--cold]"): segmenta
+ * quadros numerados de um vídeo (em ordem alfabética quando vier um diretório) reaproveitando a rede de um quadro
+ * para o seguinte: só as arestas que mudaram são alteradas e o fluxo máximo parte do fluxo do quadro anterior. Com
+ * --cold cada quadro monta e resolve uma rede nova, para comparação. Imprime em stdout uma linha CSV por quadro
+ * com a latência de cada etapa em milissegundos.
+ * 
+ * @return 0 se todos os quadros foram segmentados; 1 caso contrário.
+ */
+int runSequence(int argc, char* argv[], const std::string& extensao) {
+    int threads = 1;
+    bool frio = false;
+    std::vector<std::string> argumentos;
+    for (int i = 2; i < argc; ++i) {
+        std::string argumento = argv[i];
+        if (argumento == "--threads" && i + 1 < argc) {
+            threads = std::atoi(argv[++i]);
+        } else if (argumento == "--cold") {
+            frio = true;
+        } else {
+            argumentos.push_back(argumento);
+        }
+    }
+    if (argumentos.size() < 2) {
+        std::cerr << "Uso: " << argv[0] << " --sequence <diretorioSaida> <quadro|diretorio>... [--threads n]"
+                  << " [--cold] [--format png|ppm]\n";
+        return 1;
+    }
+    std::string diretorioSaida = argumentos[0];
+    std::vector<std::string> quadros =
+        pipeline::collectInputs(std::vector<std::string>(argumentos.begin() + 1, argumentos.end()),
+                                imageio::inputExtensions());
+
+    try {
+        std::unique_ptr<ImageSegmentation> segmenter;
+        std::cout << "frame,input,read_ms,update_ms,segment_ms,write_ms,edges_updated,foreground" << std::endl;
+        for (size_t i = 0; i < quadros.size(); ++i) {
+            std::pair<std::vector<Pixel>, std::pair<int, int> > imageData;
+            double leitura = bench::measure([&]() { imageData = ImageReader::readImage(quadros[i]); });
+
+            long long alteradas = 0;
+            double atualizacao = bench::measure([&]() {
+                if (frio || !segmenter) {
+                    segmenter.reset(new ImageSegmentation(imageData.second.first, imageData.second.second,
+                                                          imageData.first));
+                    segmenter->setThreads(threads);
+                } else {
+                    alteradas = segmenter->updateFrame(imageData.first);
+                }
+            });
+
+            std::vector<std::vector<int> > segmentation;
+            double corte = bench::measure([&]() { segmentation = segmenter->segment(180, 150); });
+
+            std::string caminhoSaida = pipeline::outputPathFor(diretorioSaida, quadros[i], "_segmented" + extensao);
+            double escrita = bench::measure([&]() {
+                ImageWriter::saveSegmentationImage(segmentation, segmenter->getPixels(), imageData.second.first,
+                                                   imageData.second.second, caminhoSaida);
+            });
+
+            std::cout << i << "," << quadros[i] << "," << leitura * 1000 << "," << atualizacao * 1000 << ","
+                      << corte * 1000 << "," << escrita * 1000 << "," << alteradas << "," << segmentation[0].size()
+                      << std::endl;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Erro: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Modo benchmark ("--bench [lado...]"): segmenta PPMs sintéticos de
+ * lado x lado pixels e imprime uma linha CSV por fase (leitura, atributos dos
+ * pixels, montagem das capacidades, corte mínimo com 1, 2, 4... threads, novo corte após ajustar os
+ * limiares, corte em pirâmide de 3 níveis e escrita, com leitura e escrita em PPM e em PNG), o tempo médio por quadro de uma sequência de 8 quadros com
+ * um quadrado que se move 2 pixels por quadro (rede nova a cada quadro e rede reaproveitada), e o corte de um volume
+ * de min(lado, 96)³ voxels inteiro e em blocos de 16 fatias.
+ * 
+ * @param lados Lados das imagens medidas.
+ */
+void benchmark(const std::vector<long>& lados) {
+    const std::string entrada = "bench_input.ppm";
+    const std::string saida = "bench_output.ppm";
+    const std::string entradaPng = "bench_input.png";
+    const std::string saidaPng = "bench_output.png";
+    const std::string volumeEntrada = "bench_volume.raw";
+    const std::string volumeSaida = "bench_labels.raw";
+
+    std::vector<int> threadCounts(1, 1);
+    int hardware = static_cast<int>(parallel::sharedPool().size()) + 1;
+    for (int t = 2; t <= std::max(hardware, 4); t *= 2) threadCounts.push_back(t);
+
+    bench::csvHeader();
+    for (size_t i = 0; i < lados.size(); ++i) {
+        long lado = lados[i];
+        long pixels = lado * lado;
+        bench::writeSyntheticPPM(entrada, lado, lado, static_cast<unsigned>(lado));
+
+        std::pair<std::vector<Pixel>, std::pair<int, int> > imageData;
+        double segundos = bench::measure([&]() { imageData = ImageReader::readPPM(entrada); });
+        bench::csvRow("FordFulkerson", "read", lado, segundos, pixels);
+
+        imageio::Image bruta = imageio::read(entrada);
+        imageio::write(entradaPng, bruta.width, bruta.height, bruta.rgb.data());
+        segundos = bench::measure([&]() { ImageReader::readImage(entradaPng); });
+        bench::csvRow("FordFulkerson", "read/png", lado, segundos, pixels);
+
+        int width = imageData.second.first;
+        int height = imageData.second.second;
+        ImageSegmentation* segmenter = NULL;
+        segundos = bench::measure([&]() {
+            segmenter = new ImageSegmentation(width, height, imageData.first);
+        });
+        bench::csvRow("FordFulkerson", "graph", lado, segundos, pixels);
+
+        segundos = bench::measure([&]() { segmenter->setupFlowNetwork(180, 150); });
+        bench::csvRow("FordFulkerson", "setup", lado, segundos, pixels);
+
+        std::vector<std::vector<int> > segmentation;
+        for (size_t t = 0; t < threadCounts.size(); ++t) {
+            segmenter->setThreads(threadCounts[t]);
+            segundos = bench::measure([&]() {
+                segmenter->setupFlowNetwork(180, 150);
+                segmentation = segmenter->segment(180, 150);
+            });
+            bench::csvRow("FordFulkerson", "segment/" + std::to_string(threadCounts[t]) + "threads",
+                          lado, segundos, pixels);
+        }
+
+        segmenter->setThreads(1);
+        segundos = bench::measure([&]() { segmentation = segmenter->segment(182, 148); });
+        bench::csvRow("FordFulkerson", "resegment", lado, segundos, pixels);
+
+        segundos = bench::measure([&]() { segmentation = segmenter->segmentMultiresolution(180, 150, 3); });
+        bench::csvRow("FordFulkerson", "segment/pyramid3", lado, segundos, pixels);
+
+        segundos = bench::measure([&]() {
+            ImageWriter::saveSegmentationImage(segmentation, segmenter->getPixels(),
+                                               width, height, saida);
+        });
+        bench::csvRow("FordFulkerson", "write", lado, segundos, pixels);
+
+        segundos = bench::measure([&]() {
+            ImageWriter::saveSegmentationImage(segmentation, segmenter->getPixels(),
+                                               width, height, saidaPng);
+        });
+        bench::csvRow("FordFulkerson", "write/png", lado, segundos, pixels);
+        delete segmenter;
+
+        const int quadros = 8;
+        std::vector<std::vector<Pixel> > sequencia(quadros, imageData.first);
+        for (int q = 0; q < quadros; ++q) {
+            for (int y = height / 4; y < height / 2; ++y) {
+                for (int x = width / 4 + 2 * q; x < std::min(width, width / 2 + 2 * q); ++x) {
+                    sequencia[q][y * width + x] = Pixel(230, 230, 230);
+                }
+            }
+        }
+        segundos = bench::measure([&]() {
+            for (int q = 0; q < quadros; ++q) {
+                ImageSegmentation novo(width, height, sequencia[q]);
+                segmentation = novo.segment(180, 150);
+            }
+        });
+        bench::csvRow("FordFulkerson", "sequence/cold", lado, segundos / quadros, pixels);
+
+        segundos = bench::measure([&]() {
+            ImageSegmentation reaproveitado(width, height, sequencia[0]);
+            segmentation = reaproveitado.segment(180, 150);
+            for (int q = 1; q < quadros; ++q) {
+                reaproveitado.updateFrame(sequencia[q]);
+                segmentation = reaproveitado.segment(180, 150);
+            }
+        });
+        bench::csvRow("FordFulkerson", "sequence/warm", lado, segundos / quadros, pixels);
+
+        int aresta = static_cast<int>(std::min(lado, 96L));
+        long voxels = static_cast<long>(aresta) * aresta * aresta;
+        {
+            std::ofstream volumeFile(volumeEntrada.c_str(), std::ios::binary);
+            std::srand(static_cast<unsigned>(lado));
+            for (int z = 0; z < aresta; ++z) {
+                for (int y = 0; y < aresta; ++y) {
+                    for (int x = 0; x < aresta; ++x) {
+                        int dx = x - aresta / 2, dy = y - aresta / 2, dz = z - aresta / 2;
+                        bool dentro = 4 * (dx * dx + dy * dy + dz * dz) < aresta * aresta;
+                        volumeFile.put(static_cast<char>((dentro ? 190 : 140) + std::rand() % 30));
+                    }
+                }
+            }
+        }
+        VolumeReader volume(volumeEntrada, aresta, aresta, aresta);
+        VolumeSegmentation inteiro(volume, aresta, 0), emBlocos(volume, 16, 4);
+        segundos = bench::measure([&]() { inteiro.segment(180, 150, volumeSaida); });
+        bench::csvRow("FordFulkerson", "volume/whole", lado, segundos, voxels);
+        segundos = bench::measure([&]() { emBlocos.segment(180, 150, volumeSaida); });
+        bench::csvRow("FordFulkerson", "volume/slab16", lado, segundos, voxels);
+    }
+    std::remove(entrada.c_str());
+    std::remove(saida.c_str());
+    std::remove(entradaPng.c_str());
+    std::remove(saidaPng.c_str());
+    std::remove(volumeEntrada.c_str());
+    std::remove(volumeSaida.c_str());
+}
+
+int main(int argc, char* argv[]) {
+    stats::Report relatorio("FordFulkerson");
+    if (stats::takeFlag(argc, argv, "--stats")) {
+        relatorio.request();
+    }
+    std::string extensao;
+    std::unique_ptr<cache::ResultCache> results;
+    try {
+        extensao = imageio::takeFormat(argc, argv);
+        results = cache::takeOptions(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << "Erro: " << e.what() << std::endl;
+        return 1;
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--bench") {
+        benchmark(bench::sweepFromArgs(argc, argv, {64, 256, 512, 1024}));
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--batch") {
+        return runBatch(argc, argv, extensao, results.get());
+    }
+    if (argc > 1 && std::string(argv[1]) == "--volume") {
+        return runVolume(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--sequence") {
+        return runSequence(argc, argv, extensao);
+    }
+
+    try {
+        std::string entrada = "imagem.ppm";
+        for (int i = 1; i + 1 < argc; i += 2) {
+            if (std::string(argv[i]) == "--input") {
+                entrada = argv[i + 1];
+            }
+        }
+        std::pair<std::vector<Pixel>, std::pair<int, int> > imageData 
+            = ImageReader::readImage(entrada);
         
         std::vector<Pixel> pixels = imageData.first;
         int width = imageData.second.first;
         int height = imageData.second.second;
         
-        ImageSegmentation segmenter(width, height, pixels);
+        int threads = 1;
+        int levels = 1;
+        for (int i = 1; i + 1 < argc; i += 2) {
+            std::string option = argv[i];
+            if (option == "--threads") {
+                threads = std::atoi(argv[i + 1]);
+            } else if (option == "--pyramid") {
+                levels = std::atoi(argv[i + 1]);
+            }
+        }
 
-        std::vector<std::vector<int>> segmentation = segmenter.segment(180, 150);
+        uint64_t chave = results ? cutKey(pixels, width, height, 180, 150, std::max(1, levels)) : 0;
+        std::vector<std::vector<int>> segmentation;
+        if (!findCachedCut(results.get(), chave, width, height, segmentation)) {
+            ImageSegmentation segmenter(width, height, pixels);
+            segmenter.setThreads(threads);
+            segmentation = levels > 1
+                ? segmenter.segmentMultiresolution(180, 150, levels)
+                : segmenter.segment(180, 150);
+            storeCut(results.get(), chave, width, height, segmentation);
+        }
         
         ImageWriter::saveSegmentationImage(
             segmentation, 
-            segmenter.getGraph().getVertices(), 
+            pixels, 
             width, 
             height, 
-            "./segments/output_segmented.ppm"
+            "./segments/output_segmented" + extensao
         );
 
         std::cout << "Segmentação concluída com sucesso!" << std::endl;
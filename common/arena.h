@@ -0,0 +1,101 @@
+#ifndef TGC_ARENA_H
+#define TGC_ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+
+/**
+ * @brief Monotonic arenas for per-run structures: containers built with arena.resource() (through std::pmr) take
+ * their memory by bumping a pointer, and everything is released at once by reset() between images or iterations.
+ */
+namespace arena {
+
+/**
+ * @brief Forwards to another resource and counts the bytes requested, so an arena knows how far it overflowed.
+ */
+class CountingResource : public std::pmr::memory_resource {
+private:
+    std::pmr::memory_resource* upstream;
+    size_t bytes;
+
+    void* do_allocate(size_t size, size_t alignment) override {
+        bytes += size;
+        return upstream->allocate(size, alignment);
+    }
+
+    void do_deallocate(void* pointer, size_t size, size_t alignment) override {
+        upstream->deallocate(pointer, size, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+public:
+    explicit CountingResource(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+        : upstream(upstream), bytes(0) {}
+
+    /**
+     * @brief Bytes requested since the last call.
+     */
+    size_t takeBytes() {
+        size_t taken = bytes;
+        bytes = 0;
+        return taken;
+    }
+};
+
+/**
+ * @brief A std::pmr::monotonic_buffer_resource over a buffer the arena keeps between runs. Deallocation is a no-op;
+ * reset() frees everything. When a run overflows the buffer, the next reset() grows the buffer by the overflow, so
+ * after the first image of a batch the following ones of similar size are served from one block without touching
+ * malloc. The memory stays reserved at the largest run seen.
+ *
+ * Containers built in the arena must be destroyed before reset().
+ */
+class Arena {
+private:
+    std::unique_ptr<unsigned char[]> buffer;
+    size_t bufferSize;
+    CountingResource overflow;
+    std::optional<std::pmr::monotonic_buffer_resource> monotonic;
+
+public:
+    explicit Arena(size_t initialBytes = 64 * 1024)
+        : buffer(new unsigned char[initialBytes > 0 ? initialBytes : 1]), bufferSize(initialBytes > 0 ? initialBytes : 1) {
+        monotonic.emplace(buffer.get(), bufferSize, &overflow);
+    }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    std::pmr::memory_resource* resource() {
+        return &*monotonic;
+    }
+
+    /**
+     * @brief Releases everything allocated since the last reset.
+     */
+    void reset() {
+        monotonic.reset();
+        size_t overflowBytes = overflow.takeBytes();
+        if (overflowBytes > 0) {
+            bufferSize += overflowBytes;
+            buffer.reset(new unsigned char[bufferSize]);
+        }
+        monotonic.emplace(buffer.get(), bufferSize, &overflow);
+    }
+
+    /**
+     * @brief Size of the retained buffer, in bytes.
+     */
+    size_t capacity() const {
+        return bufferSize;
+    }
+};
+
+} // namespace arena
+
+#endif
@@ -0,0 +1,218 @@
+#ifndef TGC_BENCHMARK_H
+#define TGC_BENCHMARK_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+/**
+ * @brief Small helpers shared by the '--bench' mode of every program in the
+ * repository: a wall clock, peak memory, CSV output and input generators.
+ *
+ * Every benchmark prints rows in the same CSV layout:
+ * program,case,n,seconds,items_per_second,peak_rss_kb
+ */
+namespace bench {
+
+/**
+ * @brief Wall-clock stopwatch started on construction.
+ */
+class Stopwatch {
+private:
+    std::chrono::steady_clock::time_point start;
+
+public:
+    Stopwatch() : start(std::chrono::steady_clock::now()) {}
+
+    void restart() { start = std::chrono::steady_clock::now(); }
+
+    double seconds() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+/**
+ * @brief Peak resident set size of the process so far, in KiB.
+ * @return The peak RSS, or 0 where the platform does not report it.
+ */
+inline long peakRssKb() {
+#if defined(_WIN32)
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#if defined(__APPLE__)
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+/**
+ * @brief Prints the CSV header line.
+ */
+inline void csvHeader(std::ostream& out = std::cout) {
+    out << "program,case,n,seconds,items_per_second,peak_rss_kb\n";
+}
+
+/**
+ * @brief Prints one CSV row.
+ * @param program Name of the executable being measured.
+ * @param caseName What was measured (structure, operation, input kind).
+ * @param n Size parameter of the case.
+ * @param seconds Wall time of the case.
+ * @param items Number of items processed, used for the throughput column.
+ */
+inline void csvRow(const std::string& program, const std::string& caseName, long long n,
+                   double seconds, double items, std::ostream& out = std::cout) {
+    out << program << "," << caseName << "," << n << "," << seconds << ","
+        << (seconds > 0 ? items / seconds : 0) << "," << peakRssKb() << "\n";
+    out.flush();
+}
+
+/**
+ * @brief Runs a function and returns its wall time in seconds.
+ */
+template <typename Function>
+double measure(Function function) {
+    Stopwatch stopwatch;
+    function();
+    return stopwatch.seconds();
+}
+
+/**
+ * @brief Discards everything written to std::cout while alive, so that
+ * algorithms that print their results can be timed without the terminal.
+ */
+class SilenceCout {
+private:
+    std::streambuf* original;
+
+public:
+    SilenceCout() : original(std::cout.rdbuf(nullptr)) {}
+
+    ~SilenceCout() {
+        std::cout.rdbuf(original);
+        std::cout.clear();
+    }
+};
+
+/**
+ * @brief Reads the size sweep from the command line ("--bench 10 20 40").
+ * @param argc Argument count of main.
+ * @param argv Argument vector of main; sizes start after "--bench".
+ * @param defaults Sweep used when no size is given.
+ */
+inline std::vector<long> sweepFromArgs(int argc, char* argv[], const std::vector<long>& defaults) {
+    std::vector<long> sweep;
+    for (int i = 2; i < argc; ++i) {
+        sweep.push_back(std::stol(argv[i]));
+    }
+    return sweep.empty() ? defaults : sweep;
+}
+
+/**
+ * @brief Weight matrix of a random directed graph (0 means no edge).
+ * @param n Number of vertices.
+ * @param degree Outgoing edges per vertex.
+ * @param seed Seed of the generator.
+ */
+inline std::vector<std::vector<float>> randomWeightMatrix(int n, int degree, unsigned seed) {
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<int> vertex(0, n - 1);
+    std::uniform_int_distribution<int> weight(1, 100);
+
+    std::vector<std::vector<float>> matrix(n, std::vector<float>(n, 0.0f));
+    for (int u = 0; u < n; ++u) {
+        for (int d = 0; d < degree; ++d) {
+            int v = vertex(generator);
+            if (v != u) matrix[u][v] = static_cast<float>(weight(generator));
+        }
+    }
+    return matrix;
+}
+
+/**
+ * @brief Weight matrix of a side x side 4-connected grid, with edges in both
+ * directions (0 means no edge).
+ */
+inline std::vector<std::vector<float>> gridWeightMatrix(int side, unsigned seed) {
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<int> weight(1, 10);
+
+    int n = side * side;
+    std::vector<std::vector<float>> matrix(n, std::vector<float>(n, 0.0f));
+    for (int y = 0; y < side; ++y) {
+        for (int x = 0; x < side; ++x) {
+            int u = y * side + x;
+            if (x + 1 < side) matrix[u][u + 1] = matrix[u + 1][u] = static_cast<float>(weight(generator));
+            if (y + 1 < side) matrix[u][u + side] = matrix[u + side][u] = static_cast<float>(weight(generator));
+        }
+    }
+    return matrix;
+}
+
+/**
+ * @brief Writes a synthetic binary PPM (P6): a few flat coloured discs over a
+ * gradient background, plus uniform noise, so segmenters see real regions.
+ * @param path Output file.
+ * @param width Image width.
+ * @param height Image height.
+ * @param seed Seed of the generator.
+ */
+inline void writeSyntheticPPM(const std::string& path, int width, int height, unsigned seed) {
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<int> noise(-8, 8);
+    std::uniform_int_distribution<int> channel(0, 255);
+
+    struct Disc { int cx, cy, radius; unsigned char r, g, b; };
+    std::vector<Disc> discs;
+    for (int i = 0; i < 6; ++i) {
+        std::uniform_int_distribution<int> x(0, width - 1), y(0, height - 1);
+        int maxRadius = std::max(2, std::min(width, height) / 4);
+        std::uniform_int_distribution<int> radius(1, maxRadius);
+        discs.push_back({x(generator), y(generator), radius(generator),
+                         static_cast<unsigned char>(channel(generator)),
+                         static_cast<unsigned char>(channel(generator)),
+                         static_cast<unsigned char>(channel(generator))});
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Cannot create file: " + path);
+    }
+    file << "P6\n" << width << " " << height << "\n255\n";
+
+    std::vector<unsigned char> row(static_cast<size_t>(width) * 3);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            int rgb[3] = {x * 255 / std::max(1, width - 1), y * 255 / std::max(1, height - 1), 128};
+            for (const Disc& disc : discs) {
+                int dx = x - disc.cx, dy = y - disc.cy;
+                if (dx * dx + dy * dy <= disc.radius * disc.radius) {
+                    rgb[0] = disc.r; rgb[1] = disc.g; rgb[2] = disc.b;
+                }
+            }
+            for (int c = 0; c < 3; ++c) {
+                int value = rgb[c] + noise(generator);
+                row[x * 3 + c] = static_cast<unsigned char>(value < 0 ? 0 : (value > 255 ? 255 : value));
+            }
+        }
+        file.write(reinterpret_cast<const char*>(row.data()), row.size());
+    }
+}
+
+} // namespace bench
+
+#endif
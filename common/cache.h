@@ -0,0 +1,459 @@
+#ifndef TGC_CACHE_H
+#define TGC_CACHE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#include <process.h>
+#endif
+
+/**
+ * @brief Content-addressed on-disk cache of segmentation results, so re-segmenting the same image with the same
+ * parameters costs a hash and a file mapping instead of a graph build and a segmentation.
+ *
+ *   cache::Hasher hasher;
+ *   hasher.update(rgb.data(), rgb.size()).add("ImageSegmentation/adaptive/1").add(k).add(minSize);
+ *   if (std::optional<cache::Labels> hit = results.find(hasher.digest())) { ... hit->at(i) ... }
+ *   else results.store(key, width, height, labels.data());
+ *
+ * The key is a 64-bit XXH64 digest of whatever the caller feeds in: the pixels, the algorithm, its parameters and a
+ * version string to bump when the output of the algorithm changes. Each entry is one file, <key>.labels, holding a
+ * small header and the label image packed in 1, 2 or 4 bytes per label, whichever fits the largest label. Hits map
+ * the file read-only. Entries are written to a temporary file and renamed, so concurrent jobs sharing the directory
+ * never see a partial entry.
+ *
+ * Eviction is least recently used by file modification time: a hit touches its file, and after every store the
+ * oldest entries are removed until the directory fits the size limit again.
+ */
+namespace cache {
+
+/**
+ * @brief Streaming XXH64 (Yann Collet's xxHash, 64-bit variant, seed 0 by default).
+ */
+class Hasher {
+private:
+    static constexpr uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+    static constexpr uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+    static constexpr uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+    static constexpr uint64_t PRIME4 = 0x85EBCA77C2B2AE63ULL;
+    static constexpr uint64_t PRIME5 = 0x27D4EB2F165667C5ULL;
+
+    uint64_t seed;
+    uint64_t lanes[4];
+    unsigned char buffer[32];
+    size_t buffered = 0;
+    uint64_t total = 0;
+
+    static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+    static uint64_t read64(const unsigned char* p) {
+        uint64_t value;
+        std::memcpy(&value, p, 8);
+        return value;
+    }
+
+    static uint32_t read32(const unsigned char* p) {
+        uint32_t value;
+        std::memcpy(&value, p, 4);
+        return value;
+    }
+
+    static uint64_t round(uint64_t accumulator, uint64_t input) {
+        accumulator += input * PRIME2;
+        return rotl(accumulator, 31) * PRIME1;
+    }
+
+    static uint64_t mergeRound(uint64_t accumulator, uint64_t lane) {
+        accumulator ^= round(0, lane);
+        return accumulator * PRIME1 + PRIME4;
+    }
+
+    void consume(const unsigned char* stripe) {
+        for (int i = 0; i < 4; ++i) lanes[i] = round(lanes[i], read64(stripe + 8 * i));
+    }
+
+public:
+    explicit Hasher(uint64_t seed = 0) : seed(seed) {
+        lanes[0] = seed + PRIME1 + PRIME2;
+        lanes[1] = seed + PRIME2;
+        lanes[2] = seed;
+        lanes[3] = seed - PRIME1;
+    }
+
+    Hasher& update(const void* data, size_t length) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        total += length;
+        if (buffered + length < 32) {
+            std::memcpy(buffer + buffered, p, length);
+            buffered += length;
+            return *this;
+        }
+        if (buffered > 0) {
+            size_t fill = 32 - buffered;
+            std::memcpy(buffer + buffered, p, fill);
+            consume(buffer);
+            p += fill;
+            length -= fill;
+            buffered = 0;
+        }
+        for (; length >= 32; p += 32, length -= 32) consume(p);
+        std::memcpy(buffer, p, length);
+        buffered = length;
+        return *this;
+    }
+
+    /**
+     * @brief Adds a parameter: the bytes of a trivially copyable value, or a string with its length.
+     */
+    template <typename T>
+    Hasher& add(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "hash raw bytes only of plain values");
+        return update(&value, sizeof(value));
+    }
+
+    Hasher& add(const std::string& text) {
+        add(static_cast<uint64_t>(text.size()));
+        return update(text.data(), text.size());
+    }
+
+    Hasher& add(const char* text) { return add(std::string(text)); }
+
+    uint64_t digest() const {
+        uint64_t h;
+        if (total >= 32) {
+            h = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18);
+            for (int i = 0; i < 4; ++i) h = mergeRound(h, lanes[i]);
+        } else {
+            h = seed + PRIME5;
+        }
+        h += total;
+
+        const unsigned char* p = buffer;
+        size_t length = buffered;
+        for (; length >= 8; p += 8, length -= 8) h = rotl(h ^ round(0, read64(p)), 27) * PRIME1 + PRIME4;
+        if (length >= 4) {
+            h = rotl(h ^ (read32(p) * PRIME1), 23) * PRIME2 + PRIME3;
+            p += 4;
+            length -= 4;
+        }
+        for (; length > 0; ++p, --length) h = rotl(h ^ (*p * PRIME5), 11) * PRIME1;
+
+        h ^= h >> 33;
+        h *= PRIME2;
+        h ^= h >> 29;
+        h *= PRIME3;
+        h ^= h >> 32;
+        return h;
+    }
+};
+
+/**
+ * @brief Header of a cache entry file, followed by width * height labels of bytesPerLabel bytes each.
+ */
+struct EntryHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint32_t width;
+    uint32_t height;
+    uint32_t bytesPerLabel;
+    uint32_t labelCount;  // number of distinct labels (labels are 0..labelCount-1)
+};
+
+static const uint32_t FORMAT_VERSION = 1;
+
+/**
+ * @brief The labels of a cache hit, read straight from the mapped entry file. Move-only; unmaps on destruction.
+ */
+class Labels {
+private:
+    const unsigned char* base = nullptr;
+    size_t length = 0;
+    std::vector<unsigned char> copy;  // used where mmap is not available
+    EntryHeader header{};
+
+    void release() {
+#ifndef _WIN32
+        if (base != nullptr && copy.empty()) munmap(const_cast<unsigned char*>(base), length);
+#endif
+        base = nullptr;
+    }
+
+    const unsigned char* data() const { return base + sizeof(EntryHeader); }
+
+public:
+    Labels() = default;
+
+    Labels(Labels&& other) noexcept { *this = std::move(other); }
+
+    Labels& operator=(Labels&& other) noexcept {
+        if (this != &other) {
+            release();
+            copy = std::move(other.copy);
+            base = copy.empty() ? other.base : copy.data();
+            length = other.length;
+            header = other.header;
+            other.base = nullptr;
+            other.length = 0;
+        }
+        return *this;
+    }
+
+    Labels(const Labels&) = delete;
+    Labels& operator=(const Labels&) = delete;
+
+    ~Labels() { release(); }
+
+    /**
+     * @brief Opens and checks an entry file.
+     * @return The labels, or nothing if the file is missing, truncated or belongs to another key.
+     */
+    static std::optional<Labels> open(const std::string& path, uint64_t key) {
+        Labels labels;
+#ifndef _WIN32
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return std::nullopt;
+        off_t size = lseek(fd, 0, SEEK_END);
+        void* mapping = size > 0 ? mmap(nullptr, static_cast<size_t>(size), PROT_READ, MAP_SHARED, fd, 0)
+                                 : MAP_FAILED;
+        close(fd);
+        if (mapping == MAP_FAILED) return std::nullopt;
+        labels.base = static_cast<const unsigned char*>(mapping);
+        labels.length = static_cast<size_t>(size);
+#else
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file.is_open()) return std::nullopt;
+        labels.copy.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(labels.copy.data()), labels.copy.size());
+        labels.base = labels.copy.data();
+        labels.length = labels.copy.size();
+#endif
+        if (labels.length < sizeof(EntryHeader)) return std::nullopt;
+        std::memcpy(&labels.header, labels.base, sizeof(EntryHeader));
+        const EntryHeader& h = labels.header;
+        uint64_t expected = sizeof(EntryHeader) + uint64_t(h.width) * h.height * h.bytesPerLabel;
+        if (std::memcmp(h.magic, "TGCL", 4) != 0 || h.version != FORMAT_VERSION || h.key != key
+            || (h.bytesPerLabel != 1 && h.bytesPerLabel != 2 && h.bytesPerLabel != 4) || labels.length != expected) {
+            return std::nullopt;
+        }
+        return labels;
+    }
+
+    int width() const { return static_cast<int>(header.width); }
+
+    int height() const { return static_cast<int>(header.height); }
+
+    size_t size() const { return size_t(header.width) * header.height; }
+
+    /**
+     * @brief Number of distinct labels; every label is below it.
+     */
+    uint32_t labelCount() const { return header.labelCount; }
+
+    uint32_t at(size_t i) const {
+        switch (header.bytesPerLabel) {
+            case 1: return data()[i];
+            case 2: {
+                uint16_t value;
+                std::memcpy(&value, data() + 2 * i, 2);
+                return value;
+            }
+            default: {
+                uint32_t value;
+                std::memcpy(&value, data() + 4 * i, 4);
+                return value;
+            }
+        }
+    }
+
+    void copyTo(std::vector<uint32_t>& out) const {
+        out.resize(size());
+        if (header.bytesPerLabel == 4) {
+            std::memcpy(out.data(), data(), out.size() * 4);
+        } else {
+            for (size_t i = 0; i < out.size(); ++i) out[i] = at(i);
+        }
+    }
+};
+
+/**
+ * @brief A directory of cached label images, bounded in total size.
+ */
+class ResultCache {
+private:
+    std::filesystem::path directory;
+    uint64_t maxBytes;
+
+    std::filesystem::path pathFor(uint64_t key) const {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.labels", static_cast<unsigned long long>(key));
+        return directory / name;
+    }
+
+    /**
+     * @brief Suffix of a temporary entry name unique to this store call: process id, thread and a per-process
+     * counter, so jobs sharing the directory never write the same temporary file.
+     */
+    static std::string temporarySuffix() {
+        static std::atomic<unsigned long long> counter(0);
+#ifndef _WIN32
+        long long process = static_cast<long long>(getpid());
+#else
+        long long process = static_cast<long long>(_getpid());
+#endif
+        size_t thread = std::hash<std::thread::id>()(std::this_thread::get_id());
+        return ".tmp" + std::to_string(process) + "." + std::to_string(thread) + "." + std::to_string(counter++);
+    }
+
+    /**
+     * @brief Removes the least recently used entries until the directory fits in maxBytes.
+     */
+    void evict() const {
+        struct Entry {
+            std::filesystem::file_time_type used;
+            uint64_t bytes;
+            std::filesystem::path path;
+        };
+        std::vector<Entry> entries;
+        uint64_t total = 0;
+        std::error_code error;
+        for (const auto& file : std::filesystem::directory_iterator(directory, error)) {
+            if (file.path().extension() != ".labels") continue;
+            std::error_code fileError;
+            Entry entry{file.last_write_time(fileError), file.file_size(fileError), file.path()};
+            if (fileError) continue;
+            total += entry.bytes;
+            entries.push_back(entry);
+        }
+        if (total <= maxBytes) return;
+
+        std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.used < b.used; });
+        for (const Entry& entry : entries) {
+            if (total <= maxBytes) break;
+            std::error_code removeError;
+            if (std::filesystem::remove(entry.path, removeError)) total -= entry.bytes;
+        }
+    }
+
+public:
+    /**
+     * @param directory Where the entries live; created if missing.
+     * @param maxBytes Size limit of all entries together. A directory left larger by an earlier run is trimmed
+     * right away.
+     */
+    ResultCache(const std::string& directory, uint64_t maxBytes) : directory(directory), maxBytes(maxBytes) {
+        std::filesystem::create_directories(this->directory);
+        evict();
+    }
+
+    /**
+     * @brief Looks a key up. A hit is marked as the most recently used entry.
+     */
+    std::optional<Labels> find(uint64_t key) const {
+        std::filesystem::path path = pathFor(key);
+        std::optional<Labels> labels = Labels::open(path.string(), key);
+        if (labels) {
+            std::error_code error;
+            std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+        }
+        return labels;
+    }
+
+    /**
+     * @brief Stores the labels of a width x height image under a key, packed in the narrowest width that fits,
+     * then evicts old entries if the cache grew past its limit. An entry larger than the whole limit is not
+     * stored. Failing to write is not an error: the result simply stays uncached.
+     */
+    void store(uint64_t key, int width, int height, const uint32_t* labels) const {
+        size_t count = static_cast<size_t>(width) * height;
+        uint32_t largest = count > 0 ? *std::max_element(labels, labels + count) : 0;
+        EntryHeader header{};
+        std::memcpy(header.magic, "TGCL", 4);
+        header.version = FORMAT_VERSION;
+        header.key = key;
+        header.width = static_cast<uint32_t>(width);
+        header.height = static_cast<uint32_t>(height);
+        header.bytesPerLabel = largest < 256 ? 1 : largest < 65536 ? 2 : 4;
+        header.labelCount = count > 0 ? largest + 1 : 0;
+
+        if (sizeof(header) + count * header.bytesPerLabel > maxBytes) return;
+
+        std::vector<unsigned char> packed(count * header.bytesPerLabel);
+        for (size_t i = 0; i < count; ++i) {
+            if (header.bytesPerLabel == 1) {
+                packed[i] = static_cast<unsigned char>(labels[i]);
+            } else if (header.bytesPerLabel == 2) {
+                uint16_t value = static_cast<uint16_t>(labels[i]);
+                std::memcpy(&packed[2 * i], &value, 2);
+            } else {
+                std::memcpy(&packed[4 * i], &labels[i], 4);
+            }
+        }
+
+        std::filesystem::path path = pathFor(key);
+        std::filesystem::path temporary = path;
+        temporary += temporarySuffix();
+        {
+            std::ofstream file(temporary, std::ios::binary);
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(packed.data()), packed.size());
+            if (!file) {
+                std::error_code error;
+                std::filesystem::remove(temporary, error);
+                return;
+            }
+        }
+        std::error_code error;
+        std::filesystem::rename(temporary, path, error);
+        if (error) {
+            std::filesystem::remove(temporary, error);
+            return;
+        }
+        evict();
+    }
+};
+
+/**
+ * @brief Removes "--cache dir" and "--cache-mb n" from argv.
+ * @return The cache to use (256 MiB unless --cache-mb is given), or null when no --cache was given.
+ */
+inline std::unique_ptr<ResultCache> takeOptions(int& argc, char* argv[]) {
+    std::string directory;
+    uint64_t megabytes = 256;
+    for (int i = 1; i + 1 < argc;) {
+        bool isDirectory = std::strcmp(argv[i], "--cache") == 0;
+        if (isDirectory || std::strcmp(argv[i], "--cache-mb") == 0) {
+            if (isDirectory) directory = argv[i + 1];
+            else megabytes = std::strtoull(argv[i + 1], nullptr, 10);
+            for (int j = i; j + 2 < argc; ++j) argv[j] = argv[j + 2];
+            argc -= 2;
+        } else {
+            ++i;
+        }
+    }
+    if (directory.empty()) return nullptr;
+    return std::unique_ptr<ResultCache>(new ResultCache(directory, megabytes << 20));
+}
+
+} // namespace cache
+
+#endif
@@ -0,0 +1,1210 @@
+#ifndef TGC_IMAGEIO_H
+#define TGC_IMAGEIO_H
+
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Self-contained image codecs, so the programs read and write PNG and JPEG themselves instead of going
+ * through PPM files converted by the Python scripts.
+ *
+ *   imageio::Image image = imageio::read("foto.jpg");        // PNG, JPEG or PPM, recognised by content
+ *   imageio::write("saida.png", width, height, rgb);         // PNG or PPM, chosen by the extension
+ *
+ * Reading covers PNG of every colour type and bit depth (interlaced or not; alpha is dropped), baseline JPEG
+ * (sequential Huffman, grey or YCbCr, any sampling factors, restart markers) and binary PPM (P6, maxval up to 255).
+ * Progressive and arithmetic-coded JPEGs are rejected. Everything is decoded to interleaved 8-bit RGB.
+ *
+ * The PNG writer compresses with LZ77 and the fixed Huffman codes of deflate. That is far from optimal for photos,
+ * but segmentation outputs are made of flat regions and shrink by one or two orders of magnitude.
+ */
+namespace imageio {
+
+/**
+ * @brief An 8-bit RGB image, interleaved and row-major.
+ */
+struct Image {
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> rgb;
+};
+
+namespace detail {
+
+inline uint32_t crc32(const unsigned char* data, size_t length, uint32_t crc = 0) {
+    static const std::vector<uint32_t> table = []() {
+        std::vector<uint32_t> values(256);
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            values[n] = c;
+        }
+        return values;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < length; ++i) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+inline uint32_t adler32(const unsigned char* data, size_t length) {
+    uint32_t a = 1, b = 0;
+    while (length > 0) {
+        size_t block = std::min<size_t>(length, 5552);
+        length -= block;
+        for (size_t i = 0; i < block; ++i) {
+            a += data[i];
+            b += a;
+        }
+        data += block;
+        a %= 65521;
+        b %= 65521;
+    }
+    return (b << 16) | a;
+}
+
+inline uint32_t readBigEndian(const unsigned char* p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+}
+
+inline void appendBigEndian(std::vector<unsigned char>& out, uint32_t value) {
+    out.push_back(static_cast<unsigned char>(value >> 24));
+    out.push_back(static_cast<unsigned char>(value >> 16));
+    out.push_back(static_cast<unsigned char>(value >> 8));
+    out.push_back(static_cast<unsigned char>(value));
+}
+
+inline std::vector<unsigned char> readFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        throw std::runtime_error("Cannot open file: " + path);
+    }
+    std::vector<unsigned char> data(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(data.data()), data.size());
+    return data;
+}
+
+/**
+ * @brief zlib/deflate decompressor (RFC 1950/1951). Huffman codes are decoded through one table indexed by the
+ * next maxLength bits of the stream.
+ */
+class Inflater {
+private:
+    struct Huffman {
+        std::vector<uint16_t> table;  // symbol << 4 | code length; length 0 marks an unused code
+        int maxLength = 0;
+    };
+
+    const unsigned char* data;
+    size_t size;
+    size_t position = 0;
+    uint64_t bitBuffer = 0;
+    int bitCount = 0;
+
+    void refill() {
+        while (bitCount <= 56) {
+            uint64_t byte = position < size ? data[position] : 0;
+            position++;
+            bitBuffer |= byte << bitCount;
+            bitCount += 8;
+        }
+    }
+
+    uint32_t bits(int count) {
+        if (count == 0) return 0;
+        if (bitCount < count) refill();
+        uint32_t value = static_cast<uint32_t>(bitBuffer & ((uint64_t(1) << count) - 1));
+        bitBuffer >>= count;
+        bitCount -= count;
+        return value;
+    }
+
+    static Huffman build(const unsigned char* lengths, int count) {
+        Huffman huffman;
+        int lengthCount[16] = {0};
+        for (int i = 0; i < count; ++i) {
+            lengthCount[lengths[i]]++;
+            huffman.maxLength = std::max<int>(huffman.maxLength, lengths[i]);
+        }
+        huffman.table.assign(size_t(1) << std::max(huffman.maxLength, 1), 0);
+
+        int nextCode[16] = {0};
+        int code = 0;
+        lengthCount[0] = 0;
+        for (int length = 1; length < 16; ++length) {
+            code = (code + lengthCount[length - 1]) << 1;
+            nextCode[length] = code;
+        }
+        for (int symbol = 0; symbol < count; ++symbol) {
+            int length = lengths[symbol];
+            if (length == 0) continue;
+            int value = nextCode[length]++;
+            int reversed = 0;
+            for (int i = 0; i < length; ++i) reversed |= ((value >> i) & 1) << (length - 1 - i);
+            for (size_t slot = reversed; slot < huffman.table.size(); slot += size_t(1) << length) {
+                huffman.table[slot] = static_cast<uint16_t>(symbol << 4 | length);
+            }
+        }
+        return huffman;
+    }
+
+    int decode(const Huffman& huffman) {
+        if (bitCount < huffman.maxLength) refill();
+        uint16_t entry = huffman.table[bitBuffer & ((uint64_t(1) << huffman.maxLength) - 1)];
+        int length = entry & 15;
+        if (length == 0) throw std::runtime_error("Corrupt deflate data.");
+        bitBuffer >>= length;
+        bitCount -= length;
+        return entry >> 4;
+    }
+
+    void inflateBlock(const Huffman& literals, const Huffman& distances, std::vector<unsigned char>& out) {
+        static const uint16_t lengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27,
+                                                31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+        static const uint8_t lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                                2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+        static const uint16_t distanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129,
+                                                  193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097,
+                                                  6145, 8193, 12289, 16385, 24577};
+        static const uint8_t distanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+                                                  6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+        while (true) {
+            int symbol = decode(literals);
+            if (symbol < 256) {
+                out.push_back(static_cast<unsigned char>(symbol));
+            } else if (symbol == 256) {
+                return;
+            } else {
+                symbol -= 257;
+                if (symbol >= 29) throw std::runtime_error("Corrupt deflate data.");
+                size_t length = lengthBase[symbol] + bits(lengthExtra[symbol]);
+                int distanceSymbol = decode(distances);
+                if (distanceSymbol >= 30) throw std::runtime_error("Corrupt deflate data.");
+                size_t distance = distanceBase[distanceSymbol] + bits(distanceExtra[distanceSymbol]);
+                if (distance > out.size()) throw std::runtime_error("Corrupt deflate data.");
+                size_t start = out.size();
+                out.resize(start + length);
+                unsigned char* to = &out[start];
+                for (size_t i = 0; i < length; ++i) to[i] = to[i - distance];
+            }
+        }
+    }
+
+public:
+    Inflater(const unsigned char* data, size_t size) : data(data), size(size) {}
+
+    /**
+     * @brief Decompresses a zlib stream.
+     * @param expectedSize Size hint for the output.
+     * @throws std::runtime_error If the stream is corrupt or truncated.
+     */
+    std::vector<unsigned char> inflateZlib(size_t expectedSize = 0) {
+        if (size < 6 || (data[0] & 0x0F) != 8 || ((data[0] << 8) | data[1]) % 31 != 0 || (data[1] & 0x20)) {
+            throw std::runtime_error("Unsupported zlib stream.");
+        }
+        position = 2;
+        std::vector<unsigned char> out;
+        out.reserve(expectedSize);
+
+        bool last = false;
+        while (!last) {
+            last = bits(1) != 0;
+            int type = static_cast<int>(bits(2));
+            if (type == 0) {
+                bits(bitCount % 8);
+                uint32_t length = bits(16);
+                uint32_t complement = bits(16);
+                if ((length ^ 0xFFFF) != complement) throw std::runtime_error("Corrupt deflate data.");
+                for (uint32_t i = 0; i < length; ++i) out.push_back(static_cast<unsigned char>(bits(8)));
+            } else if (type == 1) {
+                static const Huffman fixedLiterals = []() {
+                    unsigned char lengths[288];
+                    std::fill(lengths, lengths + 144, 8);
+                    std::fill(lengths + 144, lengths + 256, 9);
+                    std::fill(lengths + 256, lengths + 280, 7);
+                    std::fill(lengths + 280, lengths + 288, 8);
+                    return build(lengths, 288);
+                }();
+                static const Huffman fixedDistances = []() {
+                    unsigned char lengths[30];
+                    std::fill(lengths, lengths + 30, 5);
+                    return build(lengths, 30);
+                }();
+                inflateBlock(fixedLiterals, fixedDistances, out);
+            } else if (type == 2) {
+                static const uint8_t order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+                int literalCount = static_cast<int>(bits(5)) + 257;
+                int distanceCount = static_cast<int>(bits(5)) + 1;
+                int codeLengthCount = static_cast<int>(bits(4)) + 4;
+                unsigned char codeLengths[19] = {0};
+                for (int i = 0; i < codeLengthCount; ++i) codeLengths[order[i]] = static_cast<unsigned char>(bits(3));
+                Huffman codeLengthCode = build(codeLengths, 19);
+
+                unsigned char lengths[320] = {0};
+                int count = 0;
+                while (count < literalCount + distanceCount) {
+                    int symbol = decode(codeLengthCode);
+                    int repeat = 0;
+                    unsigned char value = 0;
+                    if (symbol < 16) {
+                        lengths[count++] = static_cast<unsigned char>(symbol);
+                        continue;
+                    } else if (symbol == 16) {
+                        if (count == 0) throw std::runtime_error("Corrupt deflate data.");
+                        value = lengths[count - 1];
+                        repeat = 3 + static_cast<int>(bits(2));
+                    } else if (symbol == 17) {
+                        repeat = 3 + static_cast<int>(bits(3));
+                    } else {
+                        repeat = 11 + static_cast<int>(bits(7));
+                    }
+                    if (count + repeat > literalCount + distanceCount) {
+                        throw std::runtime_error("Corrupt deflate data.");
+                    }
+                    std::fill(lengths + count, lengths + count + repeat, value);
+                    count += repeat;
+                }
+                Huffman literals = build(lengths, literalCount);
+                Huffman distances = build(lengths + literalCount, distanceCount);
+                inflateBlock(literals, distances, out);
+            } else {
+                throw std::runtime_error("Corrupt deflate data.");
+            }
+            if (position > size + 8) throw std::runtime_error("Truncated deflate data.");
+        }
+
+        bits(bitCount % 8);
+        unsigned char trailer[4];
+        for (unsigned char& byte : trailer) byte = static_cast<unsigned char>(bits(8));
+        if (position > size + 8 || readBigEndian(trailer) != adler32(out.data(), out.size())) {
+            throw std::runtime_error("Corrupt zlib stream (checksum mismatch).");
+        }
+        return out;
+    }
+};
+
+/**
+ * @brief zlib compressor: greedy LZ77 over a 32 KiB window with hash chains, written as one deflate block with the
+ * fixed Huffman codes.
+ */
+class Deflater {
+private:
+    std::vector<unsigned char>& out;
+    uint64_t bitBuffer = 0;
+    int bitCount = 0;
+
+    void put(uint32_t value, int count) {
+        bitBuffer |= uint64_t(value) << bitCount;
+        bitCount += count;
+        while (bitCount >= 8) {
+            out.push_back(static_cast<unsigned char>(bitBuffer));
+            bitBuffer >>= 8;
+            bitCount -= 8;
+        }
+    }
+
+    // Huffman codes go out most significant bit first, so the fixed codes are kept bit-reversed
+    static uint32_t reverse(uint32_t code, int length) {
+        uint32_t reversed = 0;
+        for (int i = 0; i < length; ++i) reversed |= ((code >> i) & 1) << (length - 1 - i);
+        return reversed;
+    }
+
+    void putLiteral(int symbol) {
+        static const std::vector<uint32_t> codes = []() {
+            std::vector<uint32_t> values(288);
+            for (int s = 0; s < 288; ++s) {
+                if (s < 144) values[s] = reverse(0x30 + s, 8) << 4 | 8;
+                else if (s < 256) values[s] = reverse(0x190 + s - 144, 9) << 4 | 9;
+                else if (s < 280) values[s] = reverse(s - 256, 7) << 4 | 7;
+                else values[s] = reverse(0xC0 + s - 280, 8) << 4 | 8;
+            }
+            return values;
+        }();
+        put(codes[symbol] >> 4, codes[symbol] & 15);
+    }
+
+    void putMatch(int length, int distance) {
+        static const uint16_t lengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27,
+                                                31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+        static const uint8_t lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                                2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+        static const uint16_t distanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129,
+                                                  193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097,
+                                                  6145, 8193, 12289, 16385, 24577};
+        static const uint8_t distanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+                                                  6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+        int l = static_cast<int>(std::upper_bound(lengthBase, lengthBase + 29, length) - lengthBase) - 1;
+        putLiteral(257 + l);
+        put(length - lengthBase[l], lengthExtra[l]);
+        int d = static_cast<int>(std::upper_bound(distanceBase, distanceBase + 30, distance) - distanceBase) - 1;
+        put(reverse(d, 5), 5);
+        put(distance - distanceBase[d], distanceExtra[d]);
+    }
+
+public:
+    explicit Deflater(std::vector<unsigned char>& out) : out(out) {}
+
+    void compressZlib(const unsigned char* data, size_t size) {
+        const int WINDOW = 32768, HASH_BITS = 15, MAX_CHAIN = 16, NICE_MATCH = 64, MIN_MATCH = 3, MAX_MATCH = 258;
+        out.push_back(0x78);
+        out.push_back(0x01);
+        put(1, 1);
+        put(1, 2);
+
+        std::vector<int> head(size_t(1) << HASH_BITS, -1);
+        std::vector<int> previous(WINDOW, -1);
+        auto hashAt = [&](size_t i) {
+            uint32_t value = (uint32_t(data[i]) << 16) | (uint32_t(data[i + 1]) << 8) | data[i + 2];
+            return (value * 2654435761u) >> (32 - HASH_BITS);
+        };
+        auto insert = [&](size_t i) {
+            if (i + MIN_MATCH > size) return;
+            uint32_t hash = hashAt(i);
+            previous[i % WINDOW] = head[hash];
+            head[hash] = static_cast<int>(i);
+        };
+
+        size_t i = 0;
+        while (i < size) {
+            int bestLength = 0, bestDistance = 0;
+            if (i + MIN_MATCH <= size) {
+                int candidate = head[hashAt(i)];
+                size_t limit = std::min<size_t>(MAX_MATCH, size - i);
+                for (int chain = 0; candidate >= 0 && chain < MAX_CHAIN; ++chain) {
+                    size_t distance = i - candidate;
+                    if (distance == 0 || distance > static_cast<size_t>(WINDOW)) break;
+                    if (data[candidate + bestLength] != data[i + bestLength] && bestLength > 0) {
+                        int next = previous[candidate % WINDOW];
+                        if (next >= candidate) break;
+                        candidate = next;
+                        continue;
+                    }
+                    size_t length = 0;
+                    while (length < limit && data[candidate + length] == data[i + length]) length++;
+                    if (static_cast<int>(length) > bestLength) {
+                        bestLength = static_cast<int>(length);
+                        bestDistance = static_cast<int>(distance);
+                        if (length == limit || bestLength >= NICE_MATCH) break;
+                    }
+                    int next = previous[candidate % WINDOW];
+                    if (next >= candidate) break;
+                    candidate = next;
+                }
+            }
+
+            if (bestLength >= MIN_MATCH) {
+                putMatch(bestLength, bestDistance);
+                for (int k = 0; k < bestLength; ++k) insert(i + k);
+                i += bestLength;
+            } else {
+                putLiteral(data[i]);
+                insert(i);
+                i++;
+            }
+        }
+        putLiteral(256);
+        if (bitCount > 0) put(0, 8 - bitCount);
+        appendBigEndian(out, adler32(data, size));
+    }
+};
+
+inline unsigned char paeth(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc) return static_cast<unsigned char>(a);
+    return static_cast<unsigned char>(pb <= pc ? b : c);
+}
+
+/**
+ * @brief Decodes a PNG file held in memory.
+ */
+inline Image decodePNG(const unsigned char* data, size_t size) {
+    size_t position = 8;
+    uint32_t width = 0, height = 0;
+    int bitDepth = 0, colorType = -1, interlace = 0;
+    std::vector<unsigned char> palette, compressed;
+
+    while (position + 12 <= size) {
+        uint32_t length = readBigEndian(data + position);
+        const unsigned char* type = data + position + 4;
+        const unsigned char* body = type + 4;
+        if (length > size - position - 12) throw std::runtime_error("Truncated PNG chunk.");
+        if (crc32(type, length + 4) != readBigEndian(body + length)) throw std::runtime_error("PNG CRC mismatch.");
+
+        if (std::memcmp(type, "IHDR", 4) == 0 && length >= 13) {
+            width = readBigEndian(body);
+            height = readBigEndian(body + 4);
+            bitDepth = body[8];
+            colorType = body[9];
+            interlace = body[12];
+        } else if (std::memcmp(type, "PLTE", 4) == 0) {
+            palette.assign(body, body + length);
+        } else if (std::memcmp(type, "IDAT", 4) == 0) {
+            compressed.insert(compressed.end(), body, body + length);
+        } else if (std::memcmp(type, "IEND", 4) == 0) {
+            break;
+        }
+        position += length + 12;
+    }
+
+    static const int channelsOf[7] = {1, 0, 3, 1, 2, 0, 4};
+    if (colorType < 0 || colorType > 6 || channelsOf[colorType] == 0 || width == 0 || height == 0
+        || width > (1u << 24) || height > (1u << 24)
+        || (bitDepth != 1 && bitDepth != 2 && bitDepth != 4 && bitDepth != 8 && bitDepth != 16)
+        || (colorType == 3 && palette.empty())) {
+        throw std::runtime_error("Unsupported PNG header.");
+    }
+    int channels = channelsOf[colorType];
+    int bitsPerPixel = channels * bitDepth;
+    size_t bytesPerPixel = std::max(1, bitsPerPixel / 8);
+
+    // passes of Adam7 (x0, y0, dx, dy); a plain image is one pass over everything
+    static const int adam7[7][4] = {{0, 0, 8, 8}, {4, 0, 8, 8}, {0, 4, 4, 8}, {2, 0, 4, 4},
+                                    {0, 2, 2, 4}, {1, 0, 2, 2}, {0, 1, 1, 2}};
+    static const int single[1][4] = {{0, 0, 1, 1}};
+    const int (*passes)[4] = interlace ? adam7 : single;
+    int passCount = interlace ? 7 : 1;
+
+    size_t expected = 0;
+    for (int p = 0; p < passCount; ++p) {
+        size_t pw = (width - passes[p][0] + passes[p][2] - 1) / passes[p][2];
+        size_t ph = (height - passes[p][1] + passes[p][3] - 1) / passes[p][3];
+        if (pw > 0 && ph > 0) expected += ph * ((pw * bitsPerPixel + 7) / 8 + 1);
+    }
+    std::vector<unsigned char> raw = Inflater(compressed.data(), compressed.size()).inflateZlib(expected);
+    if (raw.size() < expected) throw std::runtime_error("Truncated PNG image data.");
+
+    Image image;
+    image.width = static_cast<int>(width);
+    image.height = static_cast<int>(height);
+    image.rgb.resize(size_t(width) * height * 3);
+    int maxValue = (1 << bitDepth) - 1;
+
+    unsigned char* cursor = raw.data();
+    for (int p = 0; p < passCount; ++p) {
+        size_t pw = (width - passes[p][0] + passes[p][2] - 1) / passes[p][2];
+        size_t ph = (height - passes[p][1] + passes[p][3] - 1) / passes[p][3];
+        if (pw == 0 || ph == 0) continue;
+        size_t stride = (pw * bitsPerPixel + 7) / 8;
+        std::vector<unsigned char> zeros(stride, 0);
+
+        for (size_t y = 0; y < ph; ++y) {
+            int filter = *cursor++;
+            unsigned char* row = cursor;
+            const unsigned char* up = y > 0 ? row - stride - 1 : zeros.data();
+            cursor += stride;
+            size_t b = bytesPerPixel;
+            switch (filter) {
+                case 0:
+                    break;
+                case 1:
+                    for (size_t i = b; i < stride; ++i) row[i] = static_cast<unsigned char>(row[i] + row[i - b]);
+                    break;
+                case 2:
+                    for (size_t i = 0; i < stride; ++i) row[i] = static_cast<unsigned char>(row[i] + up[i]);
+                    break;
+                case 3:
+                    for (size_t i = 0; i < b && i < stride; ++i) row[i] = static_cast<unsigned char>(row[i] + up[i] / 2);
+                    for (size_t i = b; i < stride; ++i) {
+                        row[i] = static_cast<unsigned char>(row[i] + (row[i - b] + up[i]) / 2);
+                    }
+                    break;
+                case 4:
+                    for (size_t i = 0; i < b && i < stride; ++i) row[i] = static_cast<unsigned char>(row[i] + up[i]);
+                    for (size_t i = b; i < stride; ++i) {
+                        row[i] = static_cast<unsigned char>(row[i] + paeth(row[i - b], up[i], up[i - b]));
+                    }
+                    break;
+                default:
+                    throw std::runtime_error("Unsupported PNG filter.");
+            }
+
+            size_t outY = passes[p][1] + y * passes[p][3];
+            if (colorType == 2 && bitDepth == 8 && !interlace) {
+                std::memcpy(&image.rgb[outY * width * 3], row, stride);
+                continue;
+            }
+            for (size_t x = 0; x < pw; ++x) {
+                int sample[4];
+                for (int c = 0; c < channels; ++c) {
+                    if (bitDepth == 8) {
+                        sample[c] = row[x * channels + c];
+                    } else if (bitDepth == 16) {
+                        sample[c] = row[(x * channels + c) * 2];
+                    } else {
+                        size_t bit = x * bitDepth;
+                        int value = (row[bit / 8] >> (8 - bitDepth - bit % 8)) & maxValue;
+                        sample[c] = colorType == 3 ? value : value * 255 / maxValue;
+                    }
+                }
+                unsigned char* pixel = &image.rgb[(outY * width + passes[p][0] + x * passes[p][2]) * 3];
+                if (colorType == 3) {
+                    size_t index = static_cast<size_t>(sample[0]) * 3;
+                    if (index + 2 >= palette.size()) throw std::runtime_error("PNG palette index out of range.");
+                    pixel[0] = palette[index];
+                    pixel[1] = palette[index + 1];
+                    pixel[2] = palette[index + 2];
+                } else if (channels <= 2) {
+                    pixel[0] = pixel[1] = pixel[2] = static_cast<unsigned char>(sample[0]);
+                } else {
+                    pixel[0] = static_cast<unsigned char>(sample[0]);
+                    pixel[1] = static_cast<unsigned char>(sample[1]);
+                    pixel[2] = static_cast<unsigned char>(sample[2]);
+                }
+            }
+        }
+    }
+    return image;
+}
+
+/**
+ * @brief Encodes RGB pixels as an 8-bit PNG. Each row takes the filter with the smallest sum of absolute
+ * differences, the usual libpng heuristic.
+ */
+inline std::vector<unsigned char> encodePNG(int width, int height, const unsigned char* rgb) {
+    size_t stride = static_cast<size_t>(width) * 3;
+    std::vector<unsigned char> filtered;
+    filtered.reserve((stride + 1) * height);
+    std::vector<unsigned char> zeros(stride, 0), candidate(stride), best(stride);
+
+    for (int y = 0; y < height; ++y) {
+        const unsigned char* row = rgb + y * stride;
+        const unsigned char* up = y > 0 ? row - stride : zeros.data();
+        long bestScore = -1;
+        int bestFilter = 0;
+        for (int filter = 0; filter < 5; ++filter) {
+            long score = 0;
+            for (size_t i = 0; i < stride; ++i) {
+                int left = i >= 3 ? row[i - 3] : 0;
+                int predictor;
+                switch (filter) {
+                    case 0: predictor = 0; break;
+                    case 1: predictor = left; break;
+                    case 2: predictor = up[i]; break;
+                    case 3: predictor = (left + up[i]) / 2; break;
+                    default: predictor = paeth(left, up[i], i >= 3 ? up[i - 3] : 0); break;
+                }
+                candidate[i] = static_cast<unsigned char>(row[i] - predictor);
+                score += std::abs(static_cast<signed char>(candidate[i]));
+            }
+            if (bestScore < 0 || score < bestScore) {
+                bestScore = score;
+                bestFilter = filter;
+                best.swap(candidate);
+            }
+        }
+        filtered.push_back(static_cast<unsigned char>(bestFilter));
+        filtered.insert(filtered.end(), best.begin(), best.end());
+    }
+
+    std::vector<unsigned char> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    auto chunk = [&png](const char* type, const std::vector<unsigned char>& body) {
+        appendBigEndian(png, static_cast<uint32_t>(body.size()));
+        size_t start = png.size();
+        png.insert(png.end(), type, type + 4);
+        png.insert(png.end(), body.begin(), body.end());
+        appendBigEndian(png, crc32(&png[start], body.size() + 4));
+    };
+
+    std::vector<unsigned char> header;
+    appendBigEndian(header, static_cast<uint32_t>(width));
+    appendBigEndian(header, static_cast<uint32_t>(height));
+    header.insert(header.end(), {8, 2, 0, 0, 0});
+    chunk("IHDR", header);
+
+    std::vector<unsigned char> compressed;
+    Deflater(compressed).compressZlib(filtered.data(), filtered.size());
+    chunk("IDAT", compressed);
+    chunk("IEND", std::vector<unsigned char>());
+    return png;
+}
+
+/**
+ * @brief Baseline JPEG decoder (ITU T.81 sequential DCT with Huffman coding).
+ */
+class JpegDecoder {
+private:
+    static const int FAST_BITS = 9;
+
+    struct HuffmanTable {
+        int maxCode[18];
+        int valueOffset[17];
+        std::vector<unsigned char> values;
+        uint16_t fast[1 << FAST_BITS];  // length << 8 | value for codes of up to FAST_BITS bits, else 0
+        bool defined = false;
+    };
+
+    struct Component {
+        int id = 0, h = 1, v = 1, quantTable = 0;
+        int dcTable = 0, acTable = 0;
+        int blocksWide = 0, blocksHigh = 0;
+        int dcPredictor = 0;
+        std::vector<unsigned char> plane;
+    };
+
+    const unsigned char* data;
+    size_t size;
+    size_t position = 0;
+    uint16_t quant[4][64] = {};
+    HuffmanTable dcTables[4], acTables[4];
+    std::vector<Component> components;
+    int width = 0, height = 0, hMax = 1, vMax = 1;
+    int restartInterval = 0;
+    uint32_t bitBuffer = 0;
+    int bitCount = 0;
+    bool hitMarker = false;
+
+    uint16_t read16() {
+        if (position + 2 > size) throw std::runtime_error("Truncated JPEG.");
+        uint16_t value = static_cast<uint16_t>(data[position] << 8 | data[position + 1]);
+        position += 2;
+        return value;
+    }
+
+    // the next bits of the entropy-coded segment sit at the top of bitBuffer; stuffed zero bytes are skipped and
+    // a marker ends the data, after which zeros are fed
+    void fill() {
+        while (bitCount <= 24) {
+            uint32_t byte = 0;
+            if (!hitMarker && position < size) {
+                byte = data[position];
+                if (byte == 0xFF) {
+                    int next = position + 1 < size ? data[position + 1] : 0;
+                    if (next == 0) {
+                        position += 2;
+                    } else {
+                        hitMarker = true;
+                        byte = 0;
+                    }
+                } else {
+                    position++;
+                }
+            }
+            bitBuffer |= byte << (24 - bitCount);
+            bitCount += 8;
+        }
+    }
+
+    int receive(int count) {
+        if (count == 0) return 0;
+        if (bitCount < count) fill();
+        int value = static_cast<int>(bitBuffer >> (32 - count));
+        bitBuffer <<= count;
+        bitCount -= count;
+        return value;
+    }
+
+    static int extend(int value, int count) {
+        return count == 0 ? 0 : value < (1 << (count - 1)) ? value - (1 << count) + 1 : value;
+    }
+
+    int decode(const HuffmanTable& table) {
+        if (!table.defined) throw std::runtime_error("JPEG uses an undefined Huffman table.");
+        if (bitCount < 16) fill();
+        uint16_t entry = table.fast[bitBuffer >> (32 - FAST_BITS)];
+        if (entry != 0) {
+            bitBuffer <<= entry >> 8;
+            bitCount -= entry >> 8;
+            return entry & 0xFF;
+        }
+        for (int length = FAST_BITS + 1; length <= 16; ++length) {
+            int code = static_cast<int>(bitBuffer >> (32 - length));
+            if (code <= table.maxCode[length]) {
+                bitBuffer <<= length;
+                bitCount -= length;
+                return table.values[table.valueOffset[length] + code];
+            }
+        }
+        throw std::runtime_error("Corrupt JPEG Huffman data.");
+    }
+
+    void readHuffmanTables(size_t end) {
+        while (position < end) {
+            if (position + 17 > end) throw std::runtime_error("Truncated JPEG Huffman table.");
+            int info = data[position++];
+            if ((info >> 4) > 1 || (info & 15) > 3) throw std::runtime_error("Invalid JPEG Huffman table id.");
+            HuffmanTable& table = (info >> 4 ? acTables : dcTables)[info & 3];
+            const unsigned char* counts = data + position;
+            position += 16;
+            table.values.clear();
+            table.defined = false;
+            int code = 0, index = 0;
+            for (int length = 1; length <= 16; ++length) {
+                int count = counts[length - 1];
+                table.valueOffset[length] = index - code;
+                code += count;
+                index += count;
+                // the codes of this length are code - count .. code - 1 and must fit in length bits
+                if (code > (1 << length)) throw std::runtime_error("Oversubscribed JPEG Huffman table.");
+                table.maxCode[length] = count > 0 ? code - 1 : -1;
+                code <<= 1;
+            }
+            table.maxCode[17] = INT_MAX;
+            if (position + index > end) throw std::runtime_error("Truncated JPEG Huffman table.");
+            table.values.assign(data + position, data + position + index);
+            position += index;
+
+            std::fill(table.fast, table.fast + (1 << FAST_BITS), 0);
+            code = 0;
+            index = 0;
+            for (int length = 1; length <= FAST_BITS; ++length) {
+                for (int i = 0; i < counts[length - 1]; ++i, ++code, ++index) {
+                    int first = code << (FAST_BITS - length);
+                    for (int slot = 0; slot < (1 << (FAST_BITS - length)); ++slot) {
+                        table.fast[first + slot] = static_cast<uint16_t>(length << 8 | table.values[index]);
+                    }
+                }
+                code <<= 1;
+            }
+            table.defined = true;
+        }
+    }
+
+    void readQuantTables(size_t end) {
+        while (position < end) {
+            int info = data[position++];
+            if ((info >> 4) > 1 || (info & 15) > 3) throw std::runtime_error("Invalid JPEG quantisation table id.");
+            bool wide = (info >> 4) != 0;
+            if (position + (wide ? 128 : 64) > end) throw std::runtime_error("Truncated JPEG quantisation table.");
+            for (int k = 0; k < 64; ++k) {
+                quant[info & 3][k] = wide ? static_cast<uint16_t>(data[position] << 8 | data[position + 1])
+                                          : data[position];
+                position += wide ? 2 : 1;
+            }
+        }
+    }
+
+    void readFrame(size_t end) {
+        if (position + 6 > end) throw std::runtime_error("Truncated JPEG frame header.");
+        if (data[position] != 8) throw std::runtime_error("Only 8-bit JPEGs are supported.");
+        height = data[position + 1] << 8 | data[position + 2];
+        width = data[position + 3] << 8 | data[position + 4];
+        int count = data[position + 5];
+        if (width == 0 || height == 0 || (count != 1 && count != 3)) {
+            throw std::runtime_error("Unsupported JPEG frame (grey or YCbCr only).");
+        }
+        if (position + 6 + 3 * count > end) throw std::runtime_error("Truncated JPEG frame header.");
+        components.assign(count, Component());
+        hMax = vMax = 1;
+        for (int c = 0; c < count; ++c) {
+            const unsigned char* p = data + position + 6 + c * 3;
+            if ((p[1] >> 4) < 1 || (p[1] >> 4) > 4 || (p[1] & 15) < 1 || (p[1] & 15) > 4 || p[2] > 3) {
+                throw std::runtime_error("Invalid JPEG frame component.");
+            }
+            components[c].id = p[0];
+            components[c].h = p[1] >> 4;
+            components[c].v = p[1] & 15;
+            components[c].quantTable = p[2];
+            hMax = std::max(hMax, components[c].h);
+            vMax = std::max(vMax, components[c].v);
+        }
+        int mcusWide = (width + 8 * hMax - 1) / (8 * hMax);
+        int mcusHigh = (height + 8 * vMax - 1) / (8 * vMax);
+        for (Component& component : components) {
+            component.blocksWide = mcusWide * component.h;
+            component.blocksHigh = mcusHigh * component.v;
+            component.plane.assign(size_t(component.blocksWide) * component.blocksHigh * 64, 0);
+        }
+    }
+
+    static void inverseDct(const int* coefficients, unsigned char* out, int outStride) {
+        static const std::vector<float> cosines = []() {
+            std::vector<float> values(64);
+            for (int x = 0; x < 8; ++x) {
+                for (int u = 0; u < 8; ++u) {
+                    double scale = u == 0 ? std::sqrt(0.5) : 1.0;
+                    values[x * 8 + u] = static_cast<float>(scale * std::cos((2 * x + 1) * u * 3.14159265358979 / 16) / 2);
+                }
+            }
+            return values;
+        }();
+        float rows[64];
+        for (int v = 0; v < 8; ++v) {
+            for (int x = 0; x < 8; ++x) {
+                float sum = 0;
+                for (int u = 0; u < 8; ++u) sum += cosines[x * 8 + u] * coefficients[v * 8 + u];
+                rows[v * 8 + x] = sum;
+            }
+        }
+        for (int x = 0; x < 8; ++x) {
+            for (int y = 0; y < 8; ++y) {
+                float sum = 0;
+                for (int v = 0; v < 8; ++v) sum += cosines[y * 8 + v] * rows[v * 8 + x];
+                out[y * outStride + x] = static_cast<unsigned char>(std::min(255.0f, std::max(0.0f, sum + 128)) + 0.5f);
+            }
+        }
+    }
+
+    void decodeBlock(Component& component, int blockX, int blockY) {
+        static const unsigned char zigzag[64] = {0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+                                                 12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+                                                 35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+                                                 58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+        int coefficients[64] = {0};
+        const uint16_t* q = quant[component.quantTable];
+
+        int length = decode(dcTables[component.dcTable]);
+        if (length > 16) throw std::runtime_error("Corrupt JPEG block.");
+        component.dcPredictor += extend(receive(length), length);
+        coefficients[0] = component.dcPredictor * q[0];
+
+        bool hasAc = false;
+        for (int k = 1; k < 64;) {
+            int symbol = decode(acTables[component.acTable]);
+            int run = symbol >> 4, bits = symbol & 15;
+            if (bits == 0) {
+                if (run != 15) break;
+                k += 16;
+                continue;
+            }
+            k += run;
+            if (k > 63) throw std::runtime_error("Corrupt JPEG block.");
+            coefficients[zigzag[k]] = extend(receive(bits), bits) * q[k];
+            hasAc = true;
+            k++;
+        }
+
+        int stride = component.blocksWide * 8;
+        unsigned char* out = &component.plane[(size_t(blockY) * 8 * stride) + blockX * 8];
+        if (!hasAc) {
+            // flat block: the transform of a lone DC coefficient is DC / 8 everywhere
+            int value = std::min(255, std::max(0, static_cast<int>(std::lround(coefficients[0] / 8.0 + 128))));
+            for (int y = 0; y < 8; ++y) std::memset(out + y * stride, value, 8);
+            return;
+        }
+        inverseDct(coefficients, out, stride);
+    }
+
+    void restart() {
+        bitBuffer = 0;
+        bitCount = 0;
+        hitMarker = false;
+        while (position + 1 < size && !(data[position] == 0xFF && data[position + 1] >= 0xD0
+                                        && data[position + 1] <= 0xD7)) {
+            position++;
+        }
+        position += 2;
+        for (Component& component : components) component.dcPredictor = 0;
+    }
+
+    void readScan() {
+        size_t length = read16();
+        size_t end = position + length - 2;
+        if (length < 3 || end > size) throw std::runtime_error("Truncated JPEG scan header.");
+        int count = data[position++];
+        if (count < 1 || count > 4 || position + 2 * count > end) {
+            throw std::runtime_error("Invalid JPEG scan header.");
+        }
+        std::vector<Component*> scanned;
+        for (int i = 0; i < count; ++i) {
+            int id = data[position++];
+            int tables = data[position++];
+            if ((tables >> 4) > 3 || (tables & 15) > 3) throw std::runtime_error("Invalid JPEG scan table id.");
+            for (Component& component : components) {
+                if (component.id == id) {
+                    component.dcTable = tables >> 4;
+                    component.acTable = tables & 15;
+                    scanned.push_back(&component);
+                }
+            }
+        }
+        position = end;
+        if (scanned.empty()) throw std::runtime_error("JPEG scan without known components.");
+
+        bitBuffer = 0;
+        bitCount = 0;
+        hitMarker = false;
+        for (Component& component : components) component.dcPredictor = 0;
+
+        int unitsWide, unitsHigh;
+        if (scanned.size() == 1) {
+            // a non-interleaved scan covers only the blocks inside the component's own size
+            Component& component = *scanned[0];
+            unitsWide = ((width * component.h + hMax - 1) / hMax + 7) / 8;
+            unitsHigh = ((height * component.v + vMax - 1) / vMax + 7) / 8;
+        } else {
+            unitsWide = (width + 8 * hMax - 1) / (8 * hMax);
+            unitsHigh = (height + 8 * vMax - 1) / (8 * vMax);
+        }
+
+        int decoded = 0;
+        for (int uy = 0; uy < unitsHigh; ++uy) {
+            for (int ux = 0; ux < unitsWide; ++ux) {
+                if (restartInterval > 0 && decoded > 0 && decoded % restartInterval == 0) restart();
+                if (scanned.size() == 1) {
+                    decodeBlock(*scanned[0], ux, uy);
+                } else {
+                    for (Component* component : scanned) {
+                        for (int by = 0; by < component->v; ++by) {
+                            for (int bx = 0; bx < component->h; ++bx) {
+                                decodeBlock(*component, ux * component->h + bx, uy * component->v + by);
+                            }
+                        }
+                    }
+                }
+                decoded++;
+            }
+        }
+
+        // skip to the next marker
+        while (position + 1 < size && !(data[position] == 0xFF && data[position + 1] != 0
+                                        && !(data[position + 1] >= 0xD0 && data[position + 1] <= 0xD7))) {
+            position++;
+        }
+    }
+
+    // one output row of a component at full resolution. Planes subsampled by 2 horizontally, vertically or both
+    // (4:2:2, 4:4:0, 4:2:0) are interpolated like libjpeg's default "fancy" upsampling: a triangle filter weighting
+    // the nearer sample 3/4 and the further one 1/4, with libjpeg's rounding, samples past the component's edge
+    // clamped to it. Other factors, and planes of at most two columns subsampled horizontally, repeat samples as
+    // libjpeg does
+    void upsampleRow(const Component& component, int y, unsigned char* out) const {
+        const int stride = component.blocksWide * 8;
+        const int columns = (width * component.h + hMax - 1) / hMax;
+        const int rows = (height * component.v + vMax - 1) / vMax;
+        const bool twiceX = hMax == 2 * component.h, twiceY = vMax == 2 * component.v;
+        const bool fancyX = twiceX && (twiceY || vMax == component.v) && columns > 2;
+        const bool fancyY = twiceY && (fancyX || hMax == component.h);
+        const unsigned char* nearer = &component.plane[size_t(y * component.v / vMax) * stride];
+
+        if (!fancyY) {
+            if (component.h == hMax) {
+                std::memcpy(out, nearer, width);
+                return;
+            }
+            if (!fancyX) {
+                for (int x = 0; x < width; ++x) out[x] = nearer[x * component.h / hMax];
+                return;
+            }
+            for (int x = 0, i = 0; x < width; ++i) {
+                int before = nearer[std::max(i - 1, 0)], after = nearer[std::min(i + 1, columns - 1)];
+                out[x++] = static_cast<unsigned char>((3 * nearer[i] + before + 1) >> 2);
+                if (x < width) out[x++] = static_cast<unsigned char>((3 * nearer[i] + after + 2) >> 2);
+            }
+            return;
+        }
+
+        // the further row is the one above for even output rows and the one below for odd ones
+        int j = y / 2;
+        int other = y % 2 ? std::min(j + 1, rows - 1) : std::max(j - 1, 0);
+        const unsigned char* further = &component.plane[size_t(other) * stride];
+        if (!fancyX) {
+            for (int x = 0; x < width; ++x) {
+                int i = x * component.h / hMax;
+                out[x] = static_cast<unsigned char>((3 * nearer[i] + further[i] + 1 + y % 2) >> 2);
+            }
+            return;
+        }
+        // column sums of the vertical filter, rolled along the row as in libjpeg
+        int last = 3 * nearer[0] + further[0], sum = last;
+        for (int x = 0, i = 0; x < width; ++i) {
+            int next = i + 1 < columns ? 3 * nearer[i + 1] + further[i + 1] : sum;
+            out[x++] = static_cast<unsigned char>((3 * sum + last + 8) >> 4);
+            if (x < width) out[x++] = static_cast<unsigned char>((3 * sum + next + 7) >> 4);
+            last = sum;
+            sum = next;
+        }
+    }
+
+public:
+    JpegDecoder(const unsigned char* data, size_t size) : data(data), size(size) {}
+
+    Image decode() {
+        position = 2;
+        bool frame = false;
+        while (position + 4 <= size) {
+            if (data[position] != 0xFF) {
+                position++;
+                continue;
+            }
+            int marker = data[position + 1];
+            position += 2;
+            if (marker == 0xD9) break;
+            if (marker == 0xFF || (marker >= 0xD0 && marker <= 0xD8) || marker == 0x01) continue;
+
+            if (marker == 0xDA) {
+                if (!frame) throw std::runtime_error("JPEG scan before frame header.");
+                readScan();
+                continue;
+            }
+            size_t length = read16();
+            size_t end = position + length - 2;
+            if (length < 2 || end > size) throw std::runtime_error("Truncated JPEG segment.");
+
+            if (marker == 0xC0 || marker == 0xC1) {
+                readFrame(end);
+                frame = true;
+            } else if (marker >= 0xC2 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+                throw std::runtime_error("Only baseline JPEGs are supported (progressive or arithmetic found).");
+            } else if (marker == 0xC4) {
+                readHuffmanTables(end);
+            } else if (marker == 0xDB) {
+                readQuantTables(end);
+            } else if (marker == 0xDD) {
+                if (length < 4) throw std::runtime_error("Truncated JPEG restart interval.");
+                restartInterval = data[position] << 8 | data[position + 1];
+            }
+            position = end;
+        }
+        if (!frame) throw std::runtime_error("JPEG without a frame header.");
+
+        Image image;
+        image.width = width;
+        image.height = height;
+        image.rgb.resize(size_t(width) * height * 3);
+
+        size_t count = components.size();
+        std::vector<unsigned char> rows(size_t(width) * count);
+        for (int y = 0; y < height; ++y) {
+            for (size_t c = 0; c < count; ++c) upsampleRow(components[c], y, &rows[c * width]);
+            unsigned char* pixel = &image.rgb[size_t(y) * width * 3];
+            if (count == 1) {
+                for (int x = 0; x < width; ++x, pixel += 3) pixel[0] = pixel[1] = pixel[2] = rows[x];
+                continue;
+            }
+            for (int x = 0; x < width; ++x, pixel += 3) {
+                float luma = rows[x];
+                float cb = rows[width + x] - 128.0f, cr = rows[2 * width + x] - 128.0f;
+                float rgb[3] = {luma + 1.402f * cr, luma - 0.344136f * cb - 0.714136f * cr, luma + 1.772f * cb};
+                for (int c = 0; c < 3; ++c) {
+                    pixel[c] = static_cast<unsigned char>(std::min(255.0f, std::max(0.0f, rgb[c])) + 0.5f);
+                }
+            }
+        }
+        return image;
+    }
+};
+
+/**
+ * @brief Decodes a binary PPM (P6) held in memory.
+ */
+inline Image decodePPM(const unsigned char* data, size_t size) {
+    size_t position = 2;
+    int fields[3];
+    for (int& field : fields) {
+        while (position < size && (std::isspace(data[position]) || data[position] == '#')) {
+            if (data[position] == '#') {
+                while (position < size && data[position] != '\n') position++;
+            } else {
+                position++;
+            }
+        }
+        field = 0;
+        while (position < size && std::isdigit(data[position])) field = field * 10 + (data[position++] - '0');
+    }
+    position++;
+    Image image;
+    image.width = fields[0];
+    image.height = fields[1];
+    size_t length = size_t(image.width) * image.height * 3;
+    if (image.width <= 0 || image.height <= 0 || fields[2] <= 0 || fields[2] > 255 || position + length > size) {
+        throw std::runtime_error("Unsupported PPM file.");
+    }
+    image.rgb.assign(data + position, data + position + length);
+    return image;
+}
+
+inline std::string lowercaseExtension(const std::string& path) {
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return "";
+    std::string extension = path.substr(dot);
+    for (char& c : extension) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return extension;
+}
+
+} // namespace detail
+
+/**
+ * @brief Decodes a PNG, JPEG or PPM image held in memory, recognised by its first bytes.
+ * @throws std::runtime_error If the format is unknown or unsupported, or the data is corrupt.
+ */
+inline Image decode(const unsigned char* data, size_t size) {
+    static const unsigned char pngSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    if (size >= 8 && std::memcmp(data, pngSignature, 8) == 0) return detail::decodePNG(data, size);
+    if (size >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF) {
+        return detail::JpegDecoder(data, size).decode();
+    }
+    if (size >= 2 && data[0] == 'P' && data[1] == '6') return detail::decodePPM(data, size);
+    throw std::runtime_error("Unknown image format (expected PNG, JPEG or binary PPM).");
+}
+
+/**
+ * @brief Reads and decodes an image file.
+ * @throws std::runtime_error If the file cannot be read or decoded.
+ */
+inline Image read(const std::string& path) {
+    std::vector<unsigned char> data = detail::readFile(path);
+    try {
+        return decode(data.data(), data.size());
+    } catch (const std::runtime_error& e) {
+        throw std::runtime_error(std::string(e.what()) + " (" + path + ")");
+    }
+}
+
+/**
+ * @brief Writes RGB pixels as PNG, or as binary PPM when the path ends in ".ppm".
+ * @throws std::runtime_error If the file cannot be written.
+ */
+inline void write(const std::string& path, int width, int height, const unsigned char* rgb) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Error creating output file.");
+    }
+    if (detail::lowercaseExtension(path) == ".ppm") {
+        file << "P6\n" << width << " " << height << "\n255\n";
+        file.write(reinterpret_cast<const char*>(rgb), static_cast<std::streamsize>(width) * height * 3);
+    } else {
+        std::vector<unsigned char> png = detail::encodePNG(width, height, rgb);
+        file.write(reinterpret_cast<const char*>(png.data()), png.size());
+    }
+    if (!file) {
+        throw std::runtime_error("Error writing output file: " + path);
+    }
+}
+
+/**
+ * @brief File extensions read() understands, for collecting inputs from directories.
+ */
+inline const std::vector<std::string>& inputExtensions() {
+    static const std::vector<std::string> extensions = {".png", ".jpg", ".jpeg", ".ppm",
+                                                        ".PNG", ".JPG", ".JPEG", ".PPM"};
+    return extensions;
+}
+
+/**
+ * @brief Removes "--format png|ppm" from argv.
+ * @return The output extension to use: ".png" unless "--format ppm" was given.
+ * @throws std::invalid_argument For any other format.
+ */
+inline std::string takeFormat(int& argc, char* argv[]) {
+    std::string extension = ".png";
+    for (int i = 1; i + 1 < argc;) {
+        if (std::strcmp(argv[i], "--format") == 0) {
+            std::string format = argv[i + 1];
+            if (format != "png" && format != "ppm") {
+                throw std::invalid_argument("Unknown output format: " + format + " (use png or ppm)");
+            }
+            extension = "." + format;
+            for (int j = i; j + 2 < argc; ++j) argv[j] = argv[j + 2];
+            argc -= 2;
+        } else {
+            ++i;
+        }
+    }
+    return extension;
+}
+
+} // namespace imageio
+
+#endif
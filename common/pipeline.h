@@ -0,0 +1,173 @@
+#ifndef TGC_PIPELINE_H
+#define TGC_PIPELINE_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Building blocks for bounded multi-stage pipelines: each stage owns its worker threads and hands items to
+ * the next stage through a bounded queue, so a slow stage blocks the ones before it instead of letting work pile up
+ * in memory.
+ */
+namespace pipeline {
+
+/**
+ * @brief Blocking FIFO queue with a fixed capacity.
+ * @tparam T The type of the queued items (moved in and out).
+ */
+template <typename T>
+class BoundedQueue {
+private:
+    std::deque<T> items;
+    size_t capacity;
+    bool closed;
+    std::mutex mutex;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity == 0 ? 1 : capacity), closed(false) {}
+
+    /**
+     * @brief Adds an item, waiting while the queue is full.
+     */
+    void push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this]() { return items.size() < capacity || closed; });
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+    }
+
+    /**
+     * @brief Removes the oldest item, waiting while the queue is empty.
+     * @param item Receives the item.
+     * @return false once the queue is closed and drained.
+     */
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this]() { return !items.empty() || closed; });
+        if (items.empty()) return false;
+
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Marks the end of the stream; consumers drain what is left and then stop.
+     */
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+};
+
+/**
+ * @brief Starts a stage: workers threads pop from input, apply function and push the result to output. The output
+ * queue is closed when the last worker of the stage finishes.
+ * @param function Callable In -> Out; it may throw, in which case the item is dropped and onError is called.
+ * @param onError Callable taking the exception message.
+ * @return The worker threads, to be joined by the caller.
+ */
+template <typename In, typename Out, typename Function, typename ErrorHandler>
+std::vector<std::thread> startStage(int workers, BoundedQueue<In>& input, BoundedQueue<Out>& output,
+                                    Function function, ErrorHandler onError) {
+    auto running = std::make_shared<std::atomic<int>>(workers);
+    std::vector<std::thread> threads;
+    for (int w = 0; w < workers; ++w) {
+        threads.emplace_back([&input, &output, function, onError, running]() {
+            In item;
+            while (input.pop(item)) {
+                try {
+                    output.push(function(std::move(item)));
+                } catch (const std::exception& e) {
+                    onError(e.what());
+                }
+            }
+            if (--*running == 0) output.close();
+        });
+    }
+    return threads;
+}
+
+/**
+ * @brief Starts the last stage of a pipeline, which consumes items without producing any.
+ */
+template <typename In, typename Function, typename ErrorHandler>
+std::vector<std::thread> startSink(int workers, BoundedQueue<In>& input, Function function, ErrorHandler onError) {
+    std::vector<std::thread> threads;
+    for (int w = 0; w < workers; ++w) {
+        threads.emplace_back([&input, function, onError]() {
+            In item;
+            while (input.pop(item)) {
+                try {
+                    function(std::move(item));
+                } catch (const std::exception& e) {
+                    onError(e.what());
+                }
+            }
+        });
+    }
+    return threads;
+}
+
+/**
+ * @brief Joins every thread of the given stages.
+ */
+inline void joinAll(std::vector<std::vector<std::thread>>& stages) {
+    for (auto& stage : stages) {
+        for (std::thread& thread : stage) thread.join();
+    }
+}
+
+/**
+ * @brief Expands command-line inputs into a sorted list of files: files are kept as given and directories are
+ * replaced by the files inside them with one of the given extensions.
+ */
+inline std::vector<std::string> collectInputs(const std::vector<std::string>& arguments,
+                                              const std::vector<std::string>& extensions) {
+    std::vector<std::string> inputs;
+    for (const std::string& argument : arguments) {
+        if (std::filesystem::is_directory(argument)) {
+            std::vector<std::string> files;
+            for (const auto& entry : std::filesystem::directory_iterator(argument)) {
+                if (entry.is_regular_file() && std::find(extensions.begin(), extensions.end(),
+                                                         entry.path().extension().string()) != extensions.end()) {
+                    files.push_back(entry.path().string());
+                }
+            }
+            std::sort(files.begin(), files.end());
+            inputs.insert(inputs.end(), files.begin(), files.end());
+        } else {
+            inputs.push_back(argument);
+        }
+    }
+    return inputs;
+}
+
+inline std::vector<std::string> collectInputs(const std::vector<std::string>& arguments, const std::string& extension) {
+    return collectInputs(arguments, std::vector<std::string>{extension});
+}
+
+/**
+ * @brief Output path for an input file: outputDir/<input stem><suffix>.
+ */
+inline std::string outputPathFor(const std::string& outputDir, const std::string& input, const std::string& suffix) {
+    return (std::filesystem::path(outputDir) / (std::filesystem::path(input).stem().string() + suffix)).string();
+}
+
+} // namespace pipeline
+
+#endif
@@ -0,0 +1,322 @@
+#ifndef TGC_STATS_H
+#define TGC_STATS_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+/**
+ * @brief Optional per-phase instrumentation: wall time per named phase, named counters and peak allocated bytes,
+ * reported as one JSON object. Collection is switched on at runtime with stats::enable() (the programs' --stats
+ * flag); building with -DTGC_NO_STATS removes the instrumentation points and the allocation tracking entirely.
+ *
+ * Instrumentation points use the macros below so that they disappear in a TGC_NO_STATS build:
+ *   TGC_STATS_PHASE("sort");              // times the rest of the enclosing scope
+ *   TGC_STATS_COUNT("edges", edges.size());
+ *   TGC_STATS_ONLY(++hops);               // any statement that only exists for the stats
+ *
+ * Include this header from exactly one translation unit per program: it replaces the global operator new/delete.
+ */
+
+#ifdef TGC_NO_STATS
+
+#define TGC_STATS_PHASE(name)
+#define TGC_STATS_COUNT(name, value)
+#define TGC_STATS_ONLY(statement)
+
+namespace stats {
+
+inline bool enabled() { return false; }
+
+inline void enable() {}
+
+inline bool takeFlag(int& argc, char* argv[], const char* flag) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], flag) == 0) {
+            for (int j = i; j + 1 < argc; ++j) argv[j] = argv[j + 1];
+            argc--;
+            return true;
+        }
+    }
+    return false;
+}
+
+class Report {
+public:
+    explicit Report(const std::string& program) : program(program) {}
+    ~Report() {
+        if (requested) std::cerr << "{\"program\":\"" << program << "\",\"stats_compiled\":false}" << std::endl;
+    }
+    void request() { requested = true; }
+
+private:
+    std::string program;
+    bool requested = false;
+};
+
+} // namespace stats
+
+#else
+
+#include <atomic>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <new>
+#include <vector>
+#include "benchmark.h"
+
+#define TGC_STATS_CONCAT_(a, b) a##b
+#define TGC_STATS_CONCAT(a, b) TGC_STATS_CONCAT_(a, b)
+#define TGC_STATS_PHASE(name) ::stats::ScopedPhase TGC_STATS_CONCAT(statsPhase, __LINE__)(name)
+#define TGC_STATS_COUNT(name, value) ::stats::count(name, static_cast<long long>(value))
+#define TGC_STATS_ONLY(statement) statement
+
+namespace stats {
+
+namespace detail {
+
+inline std::atomic<bool> enabledFlag(false);
+inline std::atomic<long long> liveBytes(0);
+inline std::atomic<long long> peakBytes(0);
+
+struct Phase {
+    double seconds = 0;
+    long long calls = 0;
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::string> phaseOrder;
+    std::map<std::string, Phase> phases;
+    std::vector<std::string> counterOrder;
+    std::map<std::string, long long> counters;
+};
+
+inline Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+inline void recordAllocation(size_t size) {
+    long long live = liveBytes.fetch_add(static_cast<long long>(size), std::memory_order_relaxed)
+                     + static_cast<long long>(size);
+    long long peak = peakBytes.load(std::memory_order_relaxed);
+    while (live > peak && !peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+}
+
+inline void recordRelease(size_t size) {
+    liveBytes.fetch_sub(static_cast<long long>(size), std::memory_order_relaxed);
+}
+
+inline std::string escape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+} // namespace detail
+
+inline bool enabled() {
+    return detail::enabledFlag.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Starts collecting; only blocks allocated from this point on count towards the peak of allocated bytes.
+ */
+inline void enable() {
+    detail::peakBytes.store(detail::liveBytes.load());
+    detail::enabledFlag.store(true);
+}
+
+/**
+ * @brief Adds value to the named counter (thread-safe; meant to be called with totals, not per item).
+ */
+inline void count(const char* name, long long value) {
+    if (!enabled()) return;
+    detail::Registry& registry = detail::registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    if (registry.counters.find(name) == registry.counters.end()) registry.counterOrder.push_back(name);
+    registry.counters[name] += value;
+}
+
+/**
+ * @brief Adds the wall time from construction to destruction to the named phase (calls from several threads add
+ * up, so a phase can exceed the total run time).
+ */
+class ScopedPhase {
+private:
+    const char* name;
+    bool active;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    explicit ScopedPhase(const char* name) : name(name), active(enabled()) {
+        if (active) start = std::chrono::steady_clock::now();
+    }
+
+    ~ScopedPhase() {
+        if (!active) return;
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        detail::Registry& registry = detail::registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        if (registry.phases.find(name) == registry.phases.end()) registry.phaseOrder.push_back(name);
+        detail::Phase& phase = registry.phases[name];
+        phase.seconds += seconds;
+        phase.calls++;
+    }
+
+    ScopedPhase(const ScopedPhase&) = delete;
+    ScopedPhase& operator=(const ScopedPhase&) = delete;
+};
+
+/**
+ * @brief Writes everything collected as one line of JSON:
+ * {"program":...,"phases":{"read":{"seconds":...,"calls":...},...},"counters":{...},"peak_allocated_bytes":...,
+ * "peak_rss_kb":...}
+ */
+inline void writeJson(std::ostream& out, const std::string& program) {
+    detail::Registry& registry = detail::registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    out << "{\"program\":\"" << detail::escape(program) << "\",\"phases\":{";
+    for (size_t i = 0; i < registry.phaseOrder.size(); ++i) {
+        const detail::Phase& phase = registry.phases[registry.phaseOrder[i]];
+        out << (i > 0 ? "," : "") << "\"" << detail::escape(registry.phaseOrder[i]) << "\":{\"seconds\":"
+            << phase.seconds << ",\"calls\":" << phase.calls << "}";
+    }
+    out << "},\"counters\":{";
+    for (size_t i = 0; i < registry.counterOrder.size(); ++i) {
+        out << (i > 0 ? "," : "") << "\"" << detail::escape(registry.counterOrder[i]) << "\":"
+            << registry.counters[registry.counterOrder[i]];
+    }
+    out << "},\"peak_allocated_bytes\":" << detail::peakBytes.load() << ",\"peak_rss_kb\":" << bench::peakRssKb()
+        << "}" << std::endl;
+}
+
+/**
+ * @brief Removes every occurrence of flag from argv.
+ * @return true if the flag was present.
+ */
+inline bool takeFlag(int& argc, char* argv[], const char* flag) {
+    bool found = false;
+    for (int i = 1; i < argc;) {
+        if (std::strcmp(argv[i], flag) == 0) {
+            for (int j = i; j + 1 < argc; ++j) argv[j] = argv[j + 1];
+            argc--;
+            found = true;
+        } else {
+            ++i;
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief Prints the JSON report to stderr when it goes out of scope, if request() was called. Declared at the top
+ * of main so every return path reports.
+ */
+class Report {
+private:
+    std::string program;
+    bool requested = false;
+
+public:
+    explicit Report(const std::string& program) : program(program) {}
+
+    ~Report() {
+        if (requested) writeJson(std::cerr, program);
+    }
+
+    /**
+     * @brief Enables collection and asks for the report at the end.
+     */
+    void request() {
+        enable();
+        requested = true;
+    }
+};
+
+} // namespace stats
+
+/**
+ * Global allocation tracking: every block carries a 16-byte header with its size (keeping the alignment malloc
+ * gives), so releases can be subtracted from the live total. While collection is off the header holds 0 and the
+ * shared counters are not touched, so without --stats an allocation only adds one relaxed load of a flag that is
+ * never written. The block is released out of line so the compiler does not pair the inlined free() with the
+ * operator new it sees at the call site.
+ */
+inline constexpr size_t TGC_STATS_HEADER = 16;
+
+namespace stats {
+namespace detail {
+
+[[gnu::noinline]] inline void releaseBlock(void* pointer) noexcept {
+    char* block = static_cast<char*>(pointer) - TGC_STATS_HEADER;
+    size_t size = *reinterpret_cast<size_t*>(block);
+    if (size != 0) recordRelease(size);
+    std::free(block);
+}
+
+} // namespace detail
+} // namespace stats
+
+void* operator new(size_t size) {
+    void* block = std::malloc(size + TGC_STATS_HEADER);
+    if (block == nullptr) throw std::bad_alloc();
+    bool tracked = stats::detail::enabledFlag.load(std::memory_order_relaxed);
+    *static_cast<size_t*>(block) = tracked ? size : 0;
+    if (tracked) stats::detail::recordAllocation(size);
+    return static_cast<char*>(block) + TGC_STATS_HEADER;
+}
+
+void* operator new[](size_t size) {
+    return ::operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return ::operator new(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return ::operator new(size, std::nothrow);
+}
+
+void operator delete(void* pointer) noexcept {
+    if (pointer != nullptr) stats::detail::releaseBlock(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    ::operator delete(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    ::operator delete(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    ::operator delete(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+    ::operator delete(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+    ::operator delete(pointer);
+}
+
+#endif
+
+#endif
@@ -0,0 +1,251 @@
+#ifndef TGC_THREADPOOL_H
+#define TGC_THREADPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief One persistent work-stealing thread pool for every engine, so parallel phases share a fixed set of
+ * threads instead of each spawning their own (predictable CPU usage, no oversubscription when phases nest).
+ */
+namespace parallel {
+
+/**
+ * @brief Thread pool with one task deque per worker. A worker takes from the back of its own deque and, when it is
+ * empty, steals from the front of the others; tasks submitted from outside the pool are dealt round-robin.
+ */
+class ThreadPool {
+private:
+    struct WorkerQueue {
+        std::deque<std::function<void()>> tasks;
+        std::mutex mutex;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> threads;
+    std::atomic<size_t> pending;
+    std::atomic<size_t> nextQueue;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping;
+
+    /**
+     * @brief Index of the calling thread's queue in this pool, or -1 for threads outside it.
+     */
+    int currentWorker() const {
+        return workerIndex().first == this ? workerIndex().second : -1;
+    }
+
+    static std::pair<const ThreadPool*, int>& workerIndex() {
+        static thread_local std::pair<const ThreadPool*, int> index(nullptr, -1);
+        return index;
+    }
+
+    bool popOwn(int self, std::function<void()>& task) {
+        WorkerQueue& queue = *queues[self];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) return false;
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        return true;
+    }
+
+    bool steal(size_t victim, std::function<void()>& task) {
+        WorkerQueue& queue = *queues[victim];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) return false;
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        return true;
+    }
+
+    void workerLoop(int self) {
+        workerIndex() = std::make_pair(static_cast<const ThreadPool*>(this), self);
+        while (true) {
+            if (runOne()) continue;
+
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [this]() { return pending.load() > 0 || stopping; });
+            if (stopping && pending.load() == 0) return;
+        }
+    }
+
+public:
+    /**
+     * @param workers Number of worker threads (at least 1).
+     */
+    explicit ThreadPool(size_t workers) : pending(0), nextQueue(0), stopping(false) {
+        workers = std::max<size_t>(1, workers);
+        for (size_t w = 0; w < workers; ++w) queues.emplace_back(new WorkerQueue());
+        for (size_t w = 0; w < workers; ++w) {
+            threads.emplace_back([this, w]() { workerLoop(static_cast<int>(w)); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& thread : threads) thread.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const {
+        return threads.size();
+    }
+
+    /**
+     * @brief Queues a task: on the caller's own deque when called from a worker, round-robin otherwise.
+     */
+    void submit(std::function<void()> task) {
+        int self = currentWorker();
+        size_t target = self >= 0 ? static_cast<size_t>(self) : nextQueue++ % queues.size();
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            pending++;
+        }
+        {
+            std::lock_guard<std::mutex> lock(queues[target]->mutex);
+            queues[target]->tasks.push_back(std::move(task));
+        }
+        wake.notify_one();
+    }
+
+    /**
+     * @brief Runs one queued task on the calling thread (own deque first, then stealing).
+     * @return false if there was nothing to run.
+     */
+    bool runOne() {
+        int self = currentWorker();
+        std::function<void()> task;
+        bool found = self >= 0 && popOwn(self, task);
+        size_t start = self >= 0 ? static_cast<size_t>(self) + 1 : 0;
+        for (size_t i = 0; !found && i < queues.size(); ++i) {
+            found = steal((start + i) % queues.size(), task);
+        }
+        if (!found) return false;
+
+        pending--;
+        task();
+        return true;
+    }
+
+    /**
+     * @brief Calls function(from, to) over [begin, end) split into chunks of at most grain indices. The calling
+     * thread works on chunks too and, while waiting for the rest, runs other queued tasks, so nested calls from
+     * inside a task do not deadlock. The first exception thrown by a chunk is rethrown here.
+     * @param maxWorkers Upper bound on the threads working on this loop, the caller included (0 = no bound).
+     */
+    template <typename Function>
+    void parallelFor(size_t begin, size_t end, size_t grain, Function function, size_t maxWorkers = 0) {
+        if (begin >= end) return;
+        grain = std::max<size_t>(1, grain);
+        size_t chunks = (end - begin + grain - 1) / grain;
+        size_t helpers = std::min(chunks, size() + 1) - 1;
+        if (maxWorkers > 0) helpers = std::min(helpers, maxWorkers - 1);
+        if (helpers == 0) {
+            function(begin, end);
+            return;
+        }
+
+        struct Loop {
+            std::atomic<size_t> next;
+            std::atomic<size_t> done;
+            std::mutex errorMutex;
+            std::exception_ptr error;
+            Loop() : next(0), done(0) {}
+        };
+        std::shared_ptr<Loop> loop = std::make_shared<Loop>();
+        Function* body = &function;
+
+        auto work = [loop, body, begin, end, grain, chunks]() {
+            for (size_t chunk = loop->next++; chunk < chunks; chunk = loop->next++) {
+                size_t from = begin + chunk * grain;
+                try {
+                    (*body)(from, std::min(end, from + grain));
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(loop->errorMutex);
+                    if (!loop->error) loop->error = std::current_exception();
+                }
+                loop->done++;
+            }
+        };
+
+        for (size_t h = 0; h < helpers; ++h) submit(work);
+        work();
+        while (loop->done.load() < chunks) {
+            if (!runOne()) std::this_thread::yield();
+        }
+        if (loop->error) std::rethrow_exception(loop->error);
+    }
+
+    /**
+     * @brief Sorts [begin, end) with comparator: runs of about grain elements are sorted in parallel and then
+     * merged pairwise in parallel rounds. The split depends only on the length and grain, not on the pool size.
+     */
+    template <typename Iterator, typename Compare>
+    void parallelSort(Iterator begin, Iterator end, Compare compare, size_t grain = 1 << 16) {
+        size_t n = static_cast<size_t>(std::distance(begin, end));
+        grain = std::max<size_t>(1, grain);
+        if (n <= grain) {
+            std::sort(begin, end, compare);
+            return;
+        }
+
+        size_t runs = (n + grain - 1) / grain;
+        parallelFor(0, runs, 1, [&](size_t from, size_t to) {
+            for (size_t r = from; r < to; ++r) {
+                std::sort(begin + r * grain, begin + std::min(n, (r + 1) * grain), compare);
+            }
+        });
+
+        for (size_t width = grain; width < n; width *= 2) {
+            size_t pairs = (n + 2 * width - 1) / (2 * width);
+            parallelFor(0, pairs, 1, [&](size_t from, size_t to) {
+                for (size_t p = from; p < to; ++p) {
+                    size_t first = p * 2 * width;
+                    size_t middle = std::min(n, first + width);
+                    size_t last = std::min(n, first + 2 * width);
+                    if (middle < last) std::inplace_merge(begin + first, begin + middle, begin + last, compare);
+                }
+            });
+        }
+    }
+
+    template <typename Iterator>
+    void parallelSort(Iterator begin, Iterator end) {
+        parallelSort(begin, end, std::less<typename std::iterator_traits<Iterator>::value_type>());
+    }
+};
+
+/**
+ * @brief The pool shared by every engine in the process. Its size comes from the TGC_THREADS environment variable
+ * or, if unset, from the number of hardware threads.
+ */
+inline ThreadPool& sharedPool() {
+    static ThreadPool pool([]() {
+        const char* configured = std::getenv("TGC_THREADS");
+        if (configured != nullptr && std::atoi(configured) > 0) return static_cast<size_t>(std::atoi(configured));
+        return static_cast<size_t>(std::max(1u, std::thread::hardware_concurrency()));
+    }());
+    return pool;
+}
+
+} // namespace parallel
+
+#endif